@@ -31,37 +31,11 @@
 #include <bpf/bpf_tracing.h>
 #include <bpf/bpf_core_read.h>
 
+#include "sched_latency.h"
+
 char _license[] SEC("license") = "GPL";
 
 #define MAX_CPUS      512
-#define HIST_BUCKETS  32   /* log2 buckets: 0=<1ns .. 31=~2s */
-
-enum sched_latency_type {
-	LAT_SCHED_DELAY  = 0,  /* wakeup → running */
-	LAT_RUNQUEUE     = 1,  /* enqueue → running */
-	LAT_WAKEUP       = 2,  /* wakeup → enqueue */
-	LAT_PREEMPTION   = 3,  /* stopping(runnable) → running */
-	LAT_IDLE_WAKEUP  = 4,  /* CPU idle → CPU running real task */
-	LAT_MIGRATION    = 5,  /* runqueue lat for tasks that migrated CPUs */
-	LAT_SLICE        = 6,  /* time task ran before being switched out */
-	LAT_SLEEP        = 7,  /* time voluntarily blocked before wakeup */
-	NR_LAT_TYPES     = 8,
-};
-
-struct hist {
-	u64 bucket[HIST_BUCKETS];
-	u64 count;
-	u64 total_ns;
-	u64 min_ns;
-	u64 max_ns;
-};
-
-/* Context switch counters (per-CPU). */
-struct csw_counters {
-	u64 total;
-	u64 voluntary;
-	u64 involuntary;
-};
 
 /* Per-CPU histograms for each latency type. */
 struct {
@@ -0,0 +1,149 @@
+/*
+ * sched_latency.h - Definitions shared by sched_latency.bpf.c and the
+ * userspace tools reading its maps (sched_latency, sched_mos)
+ *
+ * Histograms are per-CPU and cumulative: userspace sums the CPUs and
+ * subtracts the previous snapshot for per-interval figures.
+ */
+
+#ifndef __SCHED_LATENCY_H
+#define __SCHED_LATENCY_H
+
+#define HIST_BUCKETS  32   /* log2 buckets: 0=<1ns .. 31=~2s */
+
+enum sched_latency_type {
+	LAT_SCHED_DELAY  = 0,  /* wakeup → running */
+	LAT_RUNQUEUE     = 1,  /* enqueue → running */
+	LAT_WAKEUP       = 2,  /* wakeup → enqueue */
+	LAT_PREEMPTION   = 3,  /* stopping(runnable) → running */
+	LAT_IDLE_WAKEUP  = 4,  /* CPU idle → CPU running real task */
+	LAT_MIGRATION    = 5,  /* runqueue lat for tasks that migrated CPUs */
+	LAT_SLICE        = 6,  /* time task ran before being switched out */
+	LAT_SLEEP        = 7,  /* time voluntarily blocked before wakeup */
+	NR_LAT_TYPES     = 8,
+};
+
+struct hist {
+	__u64 bucket[HIST_BUCKETS];
+	__u64 count;
+	__u64 total_ns;
+	__u64 min_ns;
+	__u64 max_ns;
+};
+
+/* Context switch counters (per-CPU). */
+struct csw_counters {
+	__u64 total;
+	__u64 voluntary;
+	__u64 involuntary;
+};
+
+#ifndef __bpf__
+
+#include <string.h>
+#include <bpf/bpf.h>
+
+/*
+ * Aggregate per-CPU histograms into a single combined histogram.
+ */
+static inline int
+read_hist(int map_fd, __u32 type, struct hist *out, int nr_cpus)
+{
+	struct hist per_cpu[nr_cpus];
+	int ret;
+
+	memset(out, 0, sizeof(*out));
+	ret = bpf_map_lookup_elem(map_fd, &type, per_cpu);
+	if (ret < 0)
+		return ret;
+
+	for (int cpu = 0; cpu < nr_cpus; cpu++) {
+		struct hist *h = &per_cpu[cpu];
+		for (int b = 0; b < HIST_BUCKETS; b++)
+			out->bucket[b] += h->bucket[b];
+		out->count    += h->count;
+		out->total_ns += h->total_ns;
+
+		if (h->min_ns && (!out->min_ns || h->min_ns < out->min_ns))
+			out->min_ns = h->min_ns;
+		if (h->max_ns > out->max_ns)
+			out->max_ns = h->max_ns;
+	}
+
+	return 0;
+}
+
+/*
+ * Compute delta = curr - prev across buckets and counters.
+ * Stores curr into prev for the next interval.
+ *
+ * BPF-side min/max are cumulative-since-boot and cannot be delta-subtracted,
+ * so approximate per-interval min/max from the delta bucket distribution:
+ * min ≈ lower bound of lowest nonzero delta bucket, max ≈ upper bound of
+ * highest. Coarse (log2 buckets) but honest per-interval.
+ */
+static inline void
+hist_delta(const struct hist *curr, struct hist *prev, struct hist *out)
+{
+	int lo_b = -1, hi_b = -1;
+
+	/*
+	 * Guard u64 underflow: counters are cumulative and only ever grow,
+	 * but a partial read across CPU migration could observe prev > curr.
+	 * Clamp to 0 rather than wrapping to ~2^64.
+	 */
+	out->count    = curr->count    >= prev->count    ? curr->count    - prev->count    : 0;
+	out->total_ns = curr->total_ns >= prev->total_ns ? curr->total_ns - prev->total_ns : 0;
+	for (int b = 0; b < HIST_BUCKETS; b++) {
+		__u64 d = curr->bucket[b] >= prev->bucket[b]
+			? curr->bucket[b] - prev->bucket[b]
+			: 0;
+		out->bucket[b] = d;
+		if (d) {
+			if (lo_b < 0)
+				lo_b = b;
+			hi_b = b;
+		}
+	}
+	out->min_ns = (lo_b < 0) ? 0 : ((lo_b == 0) ? 0 : (1ULL << lo_b));
+	out->max_ns = (hi_b < 0) ? 0 : (1ULL << (hi_b + 1));
+	*prev = *curr;
+}
+
+/*
+ * Estimate a percentile from a log2 histogram via linear interpolation
+ * within the containing bucket (assumes uniform distribution in bucket).
+ */
+static inline __u64
+hist_percentile(const struct hist *h, double pct)
+{
+	if (!h->count)
+		return 0;
+
+	double target = h->count * pct / 100.0;
+	__u64  cumul  = 0;
+
+	for (int b = 0; b < HIST_BUCKETS; b++) {
+		__u64 bkt = h->bucket[b];
+		if (!bkt)
+			continue;
+
+		if (cumul + bkt >= target) {
+			__u64 lo = (b == 0) ? 0 : (1ULL << b);
+			__u64 hi = 1ULL << (b + 1);
+			double frac = (target - cumul) / (double)bkt;
+			if (frac < 0)
+				frac = 0;
+			if (frac > 1)
+				frac = 1;
+			return lo + (__u64)(frac * (hi - lo));
+		}
+		cumul += bkt;
+	}
+
+	return 1ULL << HIST_BUCKETS;
+}
+
+#endif /* __bpf__ */
+
+#endif /* __SCHED_LATENCY_H */
@@ -0,0 +1,390 @@
+/*
+ * sched_mos.c - Mixture-of-schedulers supervisor
+ *
+ * Runs one sched_ext scheduler at a time and hot-switches between
+ * scx_A1349 and an EEVDF policy as the workload changes phase.  The
+ * signals come from the sched_latency probes (sched_latency.bpf.c) plus
+ * the kernel's runnable count:
+ *   - Wake rate:    sched_delay samples per second per CPU
+ *   - Slice p50:    median time a task runs before switching out
+ *   - Delay p99:    wakeup → running tail
+ *   - Runnable:     procs_running from /proc/stat
+ *
+ * Phases, from the benchmark results (scx_A1349 leads hackbench-style
+ * message passing; EEVDF leads steady compute and tail sched delay):
+ *   - comm:     wake rate ≥ WAKE_HI and slice p50 < 1ms  → scx_A1349
+ *   - compute:  wake rate < WAKE_HI / 4                  → EEVDF
+ *   - latency:  delay p99 > LAT_MAX, runnable ≤ CPUs     → EEVDF
+ *   - anything else keeps the current scheduler.
+ *
+ * Hysteresis: the band between WAKE_HI / 4 and WAKE_HI is neutral, a
+ * switch needs the same verdict CONFIRM intervals in a row, and a
+ * scheduler is kept at least DWELL seconds once started.  Only one
+ * sched_ext scheduler can be loaded, so a switch stops the old one
+ * (tasks fall back to the fair class) before starting the other.
+ *
+ * Usage: sched_mos [-a CMD] [-e CMD] [-i sec] [-n N] [-w sec] [-W rate]
+ *                  [-L ms] [-d sec] [-c]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <time.h>
+#include <errno.h>
+#include <libgen.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <bpf/libbpf.h>
+#include <bpf/bpf.h>
+
+#include "sched_latency.h"
+#include "sched_latency.bpf.skel.h"
+
+#define SLICE_SHORT_NS  1000000ULL
+#define STOP_WAIT_MS    5000
+
+enum mos_policy {
+	POL_A1349 = 0,
+	POL_EEVDF = 1,
+	NR_POLICIES,
+};
+
+enum mos_phase {
+	PHASE_NEUTRAL = 0,
+	PHASE_COMM,
+	PHASE_COMPUTE,
+	PHASE_LATENCY,
+};
+
+static const char *pol_names[NR_POLICIES] = { "scx_A1349", "eevdf" };
+static const char *phase_names[] = { "neutral", "comm", "compute", "latency" };
+
+/* Phase → policy; neutral keeps whatever runs. */
+static const int phase_policy[] = { -1, POL_A1349, POL_EEVDF, POL_EEVDF };
+
+static volatile int exit_req;
+static int  interval_s    = 1;
+static int  duration_s    = 0;
+static int  csv_mode      = 0;
+static int  confirm_n     = 3;
+static int  dwell_s       = 10;
+static long wake_hi       = 2000;       /* per CPU per second */
+static long lat_max_ms    = 10;
+
+/*
+ * Scheduler commands, run through /bin/sh.  An EEVDF command of "-" means
+ * the kernel's own fair class: switching to it just stops scx_A1349.
+ */
+static const char *pol_cmd[NR_POLICIES] = {
+	"impl/scx_A1349/build/scheds/c/scx_A1349",
+	"impl/scx_EEVDF/build/scheds/c/scx_eevdf",
+};
+
+static struct hist prev_hist[2];
+
+static const char help_fmt[] =
+"Mixture-of-schedulers supervisor for sched_ext.\n"
+"\n"
+"Classifies the workload phase from scheduler latency probes and runs\n"
+"scx_A1349 or EEVDF for it, switching with hysteresis.\n"
+"\n"
+"Usage: %s [-a CMD] [-e CMD] [-i sec] [-n N] [-w sec] [-W rate] [-L ms]\n"
+"       [-d sec] [-c] [-h]\n"
+"\n"
+"  -a CMD        scx_A1349 command line\n"
+"                (default: impl/scx_A1349/build/scheds/c/scx_A1349)\n"
+"  -e CMD        EEVDF command line, \"-\" for the kernel's own EEVDF\n"
+"                (default: impl/scx_EEVDF/build/scheds/c/scx_eevdf)\n"
+"  -i SEC        Sampling interval in seconds (default: 1)\n"
+"  -n N          Intervals a new phase must hold before a switch (default: 3)\n"
+"  -w SEC        Minimum time on a scheduler once started (default: 10)\n"
+"  -W RATE       Wake-ups per CPU per second marking the comm phase\n"
+"                (default: 2000; below RATE/4 is compute)\n"
+"  -L MS         Delay p99 above MS marks the latency phase (default: 10)\n"
+"  -d SEC        Run for SEC seconds then exit (0 = unlimited)\n"
+"  -c            CSV output mode\n"
+"  -h            Display this help and exit\n";
+
+static void
+sigint_handler(int dummy)
+{
+	exit_req = 1;
+}
+
+/* procs_running from /proc/stat; -1 if unreadable. */
+static long
+read_runnable(void)
+{
+	char line[256];
+	long nr = -1;
+	FILE *f = fopen("/proc/stat", "r");
+
+	if (!f)
+		return -1;
+	while (fgets(line, sizeof(line), f)) {
+		if (sscanf(line, "procs_running %ld", &nr) == 1)
+			break;
+	}
+	fclose(f);
+	return nr;
+}
+
+struct mos_sample {
+	double wake_rate;       /* per CPU per second */
+	__u64  slice_p50;
+	__u64  delay_p99;
+	long   runnable;
+};
+
+static int
+take_sample(int hist_fd, int nr_cpus, int nr_online, struct mos_sample *s)
+{
+	struct hist curr, dh;
+
+	if (read_hist(hist_fd, LAT_SCHED_DELAY, &curr, nr_cpus) < 0)
+		return -1;
+	hist_delta(&curr, &prev_hist[0], &dh);
+	s->wake_rate = (double)dh.count / interval_s / nr_online;
+	s->delay_p99 = hist_percentile(&dh, 99.0);
+
+	if (read_hist(hist_fd, LAT_SLICE, &curr, nr_cpus) < 0)
+		return -1;
+	hist_delta(&curr, &prev_hist[1], &dh);
+	s->slice_p50 = hist_percentile(&dh, 50.0);
+
+	s->runnable = read_runnable();
+	return 0;
+}
+
+static enum mos_phase
+classify(const struct mos_sample *s, int nr_online)
+{
+	if (s->wake_rate >= wake_hi && s->slice_p50 &&
+	    s->slice_p50 < SLICE_SHORT_NS)
+		return PHASE_COMM;
+	if (s->wake_rate < wake_hi / 4.0)
+		return PHASE_COMPUTE;
+	if (s->delay_p99 > (__u64)lat_max_ms * 1000000ULL &&
+	    s->runnable >= 0 && s->runnable <= nr_online)
+		return PHASE_LATENCY;
+	return PHASE_NEUTRAL;
+}
+
+/* Start the scheduler for `pol`; 0 when it is the kernel's own. */
+static pid_t
+sched_start(int pol)
+{
+	char   cmd[4096];
+	pid_t  pid;
+
+	if (!strcmp(pol_cmd[pol], "-"))
+		return 0;
+
+	snprintf(cmd, sizeof(cmd), "exec %s", pol_cmd[pol]);
+	pid = fork();
+	if (pid < 0) {
+		perror("fork");
+		return 0;
+	}
+	if (!pid) {
+		signal(SIGINT, SIG_DFL);
+		signal(SIGTERM, SIG_DFL);
+		execl("/bin/sh", "sh", "-c", cmd, (char *)NULL);
+		_exit(127);
+	}
+	return pid;
+}
+
+/*
+ * Stop a scheduler the way an operator would (SIGINT, which every scx
+ * agent handles by detaching), escalating to SIGKILL after STOP_WAIT_MS.
+ * The kernel unregisters the struct_ops either way.
+ */
+static void
+sched_stop(pid_t pid)
+{
+	struct timespec ts = { 0, 10 * 1000000L };
+
+	if (pid <= 0)
+		return;
+	kill(pid, SIGINT);
+	for (int waited = 0; waited < STOP_WAIT_MS; waited += 10) {
+		if (waitpid(pid, NULL, WNOHANG) == pid)
+			return;
+		nanosleep(&ts, NULL);
+	}
+	fprintf(stderr, "sched_mos: pid %d ignored SIGINT, killing\n", pid);
+	kill(pid, SIGKILL);
+	waitpid(pid, NULL, 0);
+}
+
+static void
+print_sample(const struct mos_sample *s, enum mos_phase phase, int cur,
+	     int switched)
+{
+	time_t now = time(NULL);
+	struct tm *tm = localtime(&now);
+	char ts[32];
+
+	strftime(ts, sizeof(ts), "%H:%M:%S", tm);
+
+	if (csv_mode) {
+		printf("%s,%.0f,%llu,%llu,%ld,%s,%s,%d\n", ts, s->wake_rate,
+		       (unsigned long long)s->slice_p50,
+		       (unsigned long long)s->delay_p99, s->runnable,
+		       phase_names[phase], pol_names[cur], switched);
+	} else {
+		printf("%s  wake/cpu/s=%-8.0f slice_p50=%-8.1fus "
+		       "delay_p99=%-8.1fus runnable=%-4ld phase=%-8s %s%s\n",
+		       ts, s->wake_rate, s->slice_p50 / 1000.0,
+		       s->delay_p99 / 1000.0, s->runnable,
+		       phase_names[phase], pol_names[cur],
+		       switched ? "  (switched)" : "");
+	}
+	fflush(stdout);
+}
+
+int
+main(int argc, char **argv)
+{
+	struct sched_latency *skel;
+	struct mos_sample s;
+	pid_t child;
+	int   opt, cur, want = -1, streak = 0;
+	int   elapsed = 0, since_switch = 0;
+
+	while ((opt = getopt(argc, argv, "a:e:i:n:w:W:L:d:ch")) != -1) {
+		switch (opt) {
+		case 'a':
+			pol_cmd[POL_A1349] = optarg;
+			break;
+		case 'e':
+			pol_cmd[POL_EEVDF] = optarg;
+			break;
+		case 'i':
+			interval_s = atoi(optarg);
+			break;
+		case 'n':
+			confirm_n = atoi(optarg);
+			break;
+		case 'w':
+			dwell_s = atoi(optarg);
+			break;
+		case 'W':
+			wake_hi = atol(optarg);
+			break;
+		case 'L':
+			lat_max_ms = atol(optarg);
+			break;
+		case 'd':
+			duration_s = atoi(optarg);
+			break;
+		case 'c':
+			csv_mode = 1;
+			break;
+		default:
+			fprintf(stderr, help_fmt, basename(argv[0]));
+			return opt != 'h';
+		}
+	}
+
+	if (interval_s <= 0 || confirm_n <= 0 || dwell_s < 0 ||
+	    wake_hi <= 0 || lat_max_ms <= 0) {
+		fprintf(stderr, "Error: -i, -n, -W and -L must be > 0, "
+			"-w must be >= 0.\n");
+		return 1;
+	}
+
+	signal(SIGINT, sigint_handler);
+	signal(SIGTERM, sigint_handler);
+
+	skel = sched_latency__open();
+	if (!skel) {
+		fprintf(stderr, "Failed to open BPF skeleton\n");
+		return 1;
+	}
+
+	if (sched_latency__load(skel)) {
+		fprintf(stderr, "Failed to load BPF program\n");
+		sched_latency__destroy(skel);
+		return 1;
+	}
+
+	if (sched_latency__attach(skel)) {
+		fprintf(stderr, "Failed to attach BPF programs\n");
+		sched_latency__destroy(skel);
+		return 1;
+	}
+
+	int nr_cpus   = libbpf_num_possible_cpus();
+	int nr_online = (int)sysconf(_SC_NPROCESSORS_ONLN);
+	if (nr_cpus <= 0 || nr_online <= 0) {
+		fprintf(stderr, "Failed to get CPU count\n");
+		sched_latency__destroy(skel);
+		return 1;
+	}
+
+	int hist_fd = bpf_map__fd(skel->maps.hists);
+
+	/* Prime the interval deltas. */
+	take_sample(hist_fd, nr_cpus, nr_online, &s);
+
+	cur   = POL_A1349;
+	child = sched_start(cur);
+	printf("sched_mos: started %s (%s)\n", pol_names[cur], pol_cmd[cur]);
+	if (csv_mode)
+		printf("timestamp,wake_rate,slice_p50_ns,delay_p99_ns,"
+		       "runnable,phase,policy,switched\n");
+
+	while (!exit_req) {
+		enum mos_phase phase;
+		int switched = 0;
+
+		sleep(interval_s);
+		elapsed      += interval_s;
+		since_switch += interval_s;
+
+		if (child > 0 && waitpid(child, NULL, WNOHANG) == child) {
+			fprintf(stderr, "sched_mos: %s exited, on the kernel's "
+				"scheduler until the next switch\n",
+				pol_names[cur]);
+			child = 0;
+		}
+
+		if (take_sample(hist_fd, nr_cpus, nr_online, &s) < 0)
+			continue;
+
+		phase = classify(&s, nr_online);
+		if (phase_policy[phase] < 0 || phase_policy[phase] == cur) {
+			want   = -1;
+			streak = 0;
+		} else if (phase_policy[phase] == want) {
+			streak++;
+		} else {
+			want   = phase_policy[phase];
+			streak = 1;
+		}
+
+		if (want >= 0 && streak >= confirm_n && since_switch >= dwell_s) {
+			sched_stop(child);
+			cur          = want;
+			child        = sched_start(cur);
+			want         = -1;
+			streak       = 0;
+			since_switch = 0;
+			switched     = 1;
+		}
+
+		print_sample(&s, phase, cur, switched);
+
+		if (duration_s && elapsed >= duration_s)
+			break;
+	}
+
+	sched_stop(child);
+	sched_latency__destroy(skel);
+	return 0;
+}
@@ -0,0 +1,130 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0
+ */
+
+#include "scxtest/scx_test.h"
+#include "scxtest/kern_types.h"
+#include <lib/fixmath.h>
+
+#include <math.h>
+
+/*
+ * lib/fixmath.h against libm over each function's range. Tolerances are
+ * the documented bounds plus the 2^-32 rounding of the result.
+ */
+#define FIX_EPS		(1.0 / (1ULL << 29))
+#define FIX_ULP		(1.0 / SCX_FIX_ONE)
+
+static double fix_to_double(u64 v)
+{
+	return (double)v / SCX_FIX_ONE;
+}
+
+static double sfix_to_double(s64 v)
+{
+	return (double)v / SCX_FIX_ONE;
+}
+
+static s64 sfix_from_double(double v)
+{
+	return (s64)llround(v * SCX_FIX_ONE);
+}
+
+SCX_TEST(test_fixmath_exp2)
+{
+	double x, want, got;
+
+	for (x = -32.0; x < 32.0; x += 0.0137) {
+		want = exp2(x);
+		got = fix_to_double(scx_fix_exp2(sfix_from_double(x)));
+		scx_test_assert(fabs(got - want) <= want * FIX_EPS + FIX_ULP);
+	}
+
+	scx_test_assert(scx_fix_exp2(0) == SCX_FIX_ONE);
+	scx_test_assert(scx_fix_exp2((s64)SCX_FIX(5)) == SCX_FIX(32));
+	scx_test_assert(scx_fix_exp2(-(s64)SCX_FIX(1)) == SCX_FIX_ONE / 2);
+	scx_test_assert(scx_fix_exp2((s64)SCX_FIX(32)) == SCX_FIX_MAX);
+	scx_test_assert(scx_fix_exp2(-(s64)SCX_FIX(33)) == 0);
+}
+
+SCX_TEST(test_fixmath_log2)
+{
+	double want, got;
+	u64 x;
+	int shift;
+
+	/* Every magnitude, with mantissas spread over [1, 2). */
+	for (shift = 0; shift < 64; shift++) {
+		for (x = 1; x < 4096; x += 37) {
+			u64 v = (x << 52 | 0x5a5a5a5a5a5ULL) >> shift;
+
+			if (!v)
+				continue;
+
+			want = log2(fix_to_double(v));
+			got = sfix_to_double(scx_fix_log2(v));
+			scx_test_assert(fabs(got - want) <= FIX_EPS + FIX_ULP);
+		}
+	}
+
+	scx_test_assert(scx_fix_log2(SCX_FIX_ONE) == 0);
+	scx_test_assert(scx_fix_log2(SCX_FIX(8)) == (s64)SCX_FIX(3));
+	scx_test_assert(scx_fix_log2(1) == -(s64)SCX_FIX(32));
+}
+
+SCX_TEST(test_fixmath_pow)
+{
+	double base, exp, want, got;
+	u64 b;
+
+	for (base = 0.01; base < 16.0; base *= 1.37) {
+		/* Compare against the base as rounded to Q32.32. */
+		b = sfix_from_double(base);
+
+		for (exp = -8.0; exp <= 8.0; exp += 0.25) {
+			want = pow(fix_to_double(b), exp);
+			if (want >= 4.0e9)
+				continue;
+
+			got = fix_to_double(scx_fix_pow(b, sfix_from_double(exp)));
+			scx_test_assert(fabs(got - want) <=
+					want * FIX_EPS * (2.0 + fabs(exp)) + FIX_ULP);
+		}
+	}
+
+	scx_test_assert(scx_fix_pow(0, (s64)SCX_FIX(2)) == 0);
+	scx_test_assert(scx_fix_pow(0, 0) == SCX_FIX_ONE);
+	scx_test_assert(scx_fix_pow(SCX_FIX(3), 0) == SCX_FIX_ONE);
+}
+
+/*
+ * The scheduler's use: δ^m for a discount factor δ in (0, 1), keeping
+ * log2 δ and raising it to integer and fractional contract lengths well
+ * beyond any table bound.
+ */
+SCX_TEST(test_fixmath_discount)
+{
+	double deltas[] = { 0.5, 0.9, 0.98, 0.999 };
+	double delta, m, want, got;
+	s64 l;
+	u32 i;
+
+	for (i = 0; i < sizeof(deltas) / sizeof(deltas[0]); i++) {
+		delta = deltas[i];
+		l = sfix_from_double(log2(delta));
+
+		for (m = 0.0; m <= 4096.0; m = m * 1.5 + 0.75) {
+			want = pow(delta, m);
+			got = fix_to_double(scx_fix_exp2(scx_fix_mul_exp(sfix_from_double(m), l)));
+			scx_test_assert(fabs(got - want) <= want * FIX_EPS * (1.0 + m) + FIX_ULP);
+		}
+	}
+
+	/* Far past underflow, the product saturates instead of wrapping. */
+	l = sfix_from_double(log2(0.5));
+	scx_test_assert(scx_fix_exp2(scx_fix_mul_exp((s64)SCX_FIX(1U << 30), l)) == 0);
+
+	/* Up to the scheduler's longest contract, 2^31 - 1 quanta. */
+	l = sfix_from_double(log2(0.98));
+	scx_test_assert(scx_fix_exp2(scx_fix_mul_exp((s64)SCX_FIX(0x7fffffffU), l)) == 0);
+}
@@ -0,0 +1,471 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0
+ */
+
+#include <scx/common.bpf.h>
+
+#include <lib/sdt_task.h>
+#include <lib/hmap.h>
+
+/*
+ * Arena hash map: SCX_HMAP_STRIPES linear-probing tables with inline values.
+ *
+ * Deletes leave tombstones so probe chains stay intact for lock-free
+ * readers; tombstones count towards the load and are dropped when the
+ * stripe is next rehashed. Tables come from the static allocator and are
+ * never freed, so a reader racing a resize may read a stale table but never
+ * unmapped memory; the stripe sequence count tells it to retry.
+ */
+
+static __always_inline
+u64 hmap_hash(u64 key)
+{
+	/* murmur3 fmix64 */
+	key ^= key >> 33;
+	key *= 0xff51afd7ed558ccdULL;
+	key ^= key >> 33;
+	key *= 0xc4ceb9fe1a85ec53ULL;
+	key ^= key >> 33;
+
+	return key;
+}
+
+static __always_inline
+scx_hmap_stripe_t *hmap_stripe(scx_hmap_t *hmap, u64 hash)
+{
+	/* High bits pick the stripe, low bits the slot within it. */
+	return &hmap->stripe[hash >> (64 - SCX_HMAP_STRIPE_SHIFT)];
+}
+
+/*
+ * Look @key up in @tbl. Returns its slot index or -ENOENT; *@freep gets the
+ * first EMPTY or TOMB slot along the chain, where @key would be inserted.
+ */
+static __always_inline
+s64 hmap_probe(scx_hmap_slot_t *tbl, u32 order, u64 hash, u64 key, s64 *freep)
+{
+	u64 mask = (1ULL << order) - 1;
+	s64 free = -ENOENT;
+	u64 i, idx, state;
+
+	for (i = 0; i <= mask && can_loop; i++) {
+		idx = (hash + i) & mask;
+		state = tbl[idx].state;
+
+		if (state == SCX_HMAP_EMPTY) {
+			if (free < 0)
+				free = idx;
+			break;
+		}
+
+		if (state == SCX_HMAP_TOMB) {
+			if (free < 0)
+				free = idx;
+			continue;
+		}
+
+		if (tbl[idx].key == key)
+			return idx;
+	}
+
+	if (freep)
+		*freep = free;
+
+	return -ENOENT;
+}
+
+/* Slot holding @key in either table of the stripe, NULL if absent. */
+static __always_inline
+scx_hmap_slot_t *hmap_find(scx_hmap_stripe_t *st, u64 hash, u64 key)
+{
+	scx_hmap_slot_t *tbl;
+	s64 idx;
+
+	tbl = st->cur;
+	idx = hmap_probe(tbl, st->cur_order, hash, key, NULL);
+	if (idx >= 0)
+		return &tbl[idx];
+
+	tbl = st->old;
+	if (!tbl)
+		return NULL;
+
+	idx = hmap_probe(tbl, st->old_order, hash, key, NULL);
+	if (idx >= 0)
+		return &tbl[idx];
+
+	return NULL;
+}
+
+static __always_inline
+void hmap_copy_in(scx_hmap_slot_t *slot, struct scx_hmap_val *val)
+{
+	int i;
+
+	for (i = 0; i < SCX_HMAP_VAL_WORDS; i++)
+		slot->val.w[i] = val->w[i];
+}
+
+static __always_inline
+void hmap_copy_out(struct scx_hmap_val *val, scx_hmap_slot_t *slot)
+{
+	int i;
+
+	for (i = 0; i < SCX_HMAP_VAL_WORDS; i++)
+		val->w[i] = slot->val.w[i];
+}
+
+/*
+ * Writers hold the stripe lock and keep the sequence count odd for the
+ * duration, so scx_hmap_lookup_nolock() can tell a torn read.
+ */
+static __always_inline
+int hmap_write_lock(scx_hmap_stripe_t *st)
+{
+	int ret;
+
+	ret = arena_spin_lock(&st->lock);
+	if (ret)
+		return ret;
+
+	WRITE_ONCE(st->seq, st->seq + 1);
+	smp_wmb();
+
+	return 0;
+}
+
+static __always_inline
+void hmap_write_unlock(scx_hmap_stripe_t *st)
+{
+	smp_store_release(&st->seq, st->seq + 1);
+	arena_spin_unlock(&st->lock);
+}
+
+/* Empty table of 2^@order slots, allocated on first use and recycled after. */
+static __always_inline
+scx_hmap_slot_t *hmap_table(scx_hmap_stripe_t *st, u32 order, u32 side)
+{
+	u32 ind = order - SCX_HMAP_MIN_ORDER;
+	u64 nr = 1ULL << order;
+	scx_hmap_slot_t *tbl;
+	u64 i;
+
+	if (ind >= SCX_HMAP_ORDERS)
+		return NULL;
+
+	side &= 1;
+
+	tbl = st->buf[ind][side];
+	if (!tbl) {
+		/* Fresh static memory is zeroed, i.e. all SCX_HMAP_EMPTY. */
+		tbl = (scx_hmap_slot_t *)scx_static_alloc(nr * sizeof(*tbl), 1);
+		if (!tbl)
+			return NULL;
+
+		st->buf[ind][side] = tbl;
+		return tbl;
+	}
+
+	for (i = 0; i < nr && can_loop; i++)
+		tbl[i].state = SCX_HMAP_EMPTY;
+
+	return tbl;
+}
+
+/* Move up to @budget slots of the old table into the current one. */
+static __always_inline
+void hmap_migrate(scx_hmap_stripe_t *st, u64 budget)
+{
+	scx_hmap_slot_t *old = st->old;
+	scx_hmap_slot_t *src, *dst;
+	u64 idx, end, size;
+	s64 free;
+
+	if (!old)
+		return;
+
+	size = 1ULL << st->old_order;
+	end = st->migrate + budget;
+	if (end > size)
+		end = size;
+
+	for (idx = st->migrate; idx < end && can_loop; idx++) {
+		src = &old[idx];
+		if (src->state != SCX_HMAP_FULL)
+			continue;
+
+		hmap_probe(st->cur, st->cur_order, hmap_hash(src->key), src->key, &free);
+		if (free < 0)
+			break;
+
+		dst = &st->cur[free];
+		if (dst->state == SCX_HMAP_EMPTY)
+			st->used += 1;
+
+		dst->key = src->key;
+		dst->val = src->val;
+		dst->state = SCX_HMAP_FULL;
+
+		src->state = SCX_HMAP_TOMB;
+	}
+
+	st->migrate = idx;
+	if (idx < size)
+		return;
+
+	st->old = NULL;
+	st->migrate = 0;
+}
+
+/*
+ * Start a resize: double the stripe if at least half of it is live, else
+ * rehash at the same size to drop the tombstones.
+ */
+static __always_inline
+int hmap_grow(scx_hmap_stripe_t *st)
+{
+	scx_hmap_slot_t *tbl;
+	u32 order, side;
+
+	/* Only two tables are live at a time; finish the previous move. */
+	if (st->old)
+		hmap_migrate(st, 1ULL << st->old_order);
+	if (st->old)
+		return -EAGAIN;
+
+	order = st->cur_order;
+	if (st->nr * 2 >= (1ULL << order))
+		order += 1;
+
+	if (order - SCX_HMAP_MIN_ORDER >= SCX_HMAP_ORDERS) {
+		order = st->cur_order;
+		if ((st->nr + 1) * 4 > (1ULL << order) * 3)
+			return -ENOSPC;
+	}
+
+	side = order == st->cur_order ? !st->cur_side : 0;
+
+	tbl = hmap_table(st, order, side);
+	if (!tbl)
+		return -ENOMEM;
+
+	st->old = st->cur;
+	st->old_order = st->cur_order;
+	st->migrate = 0;
+
+	st->cur = tbl;
+	st->cur_order = order;
+	st->cur_side = side;
+	st->used = 0;
+
+	return 0;
+}
+
+__weak
+u64 scx_hmap_create_internal(void)
+{
+	scx_hmap_stripe_t *st;
+	scx_hmap_slot_t *tbl;
+	scx_hmap_t *hmap;
+	int i;
+
+	hmap = (scx_hmap_t *)scx_static_alloc(sizeof(*hmap), 1);
+	if (!hmap)
+		return (u64)NULL;
+
+	for (i = 0; i < SCX_HMAP_STRIPES && can_loop; i++) {
+		st = &hmap->stripe[i];
+
+		tbl = hmap_table(st, SCX_HMAP_MIN_ORDER, 0);
+		if (!tbl) {
+			/* XXX Free when migrating from the static allocator. */
+			return (u64)NULL;
+		}
+
+		st->cur = tbl;
+		st->cur_order = SCX_HMAP_MIN_ORDER;
+	}
+
+	return (u64)hmap;
+}
+
+__weak
+int scx_hmap_destroy(scx_hmap_t __arg_arena *hmap)
+{
+	if (unlikely(!hmap))
+		return -EINVAL;
+
+	return -EOPNOTSUPP;
+}
+
+__weak
+int scx_hmap_update(scx_hmap_t __arg_arena *hmap, u64 key, struct scx_hmap_val *val, u64 flags)
+{
+	scx_hmap_stripe_t *st;
+	scx_hmap_slot_t *slot;
+	u64 hash;
+	s64 free;
+	int ret;
+
+	if (unlikely(!hmap || !val || flags > SCX_HMAP_EXIST))
+		return -EINVAL;
+
+	hash = hmap_hash(key);
+	st = hmap_stripe(hmap, hash);
+
+	ret = hmap_write_lock(st);
+	if (ret)
+		return ret;
+
+	hmap_migrate(st, SCX_HMAP_MIGRATE);
+
+	/* Existing keys are overwritten in place, even in the old table. */
+	slot = hmap_find(st, hash, key);
+	if (slot) {
+		if (flags == SCX_HMAP_NOEXIST)
+			ret = -EEXIST;
+		else
+			hmap_copy_in(slot, val);
+		goto out;
+	}
+
+	if (flags == SCX_HMAP_EXIST) {
+		ret = -ENOENT;
+		goto out;
+	}
+
+	if ((st->used + 1) * 4 > (1ULL << st->cur_order) * 3) {
+		ret = hmap_grow(st);
+		if (ret)
+			goto out;
+	}
+
+	hmap_probe(st->cur, st->cur_order, hash, key, &free);
+	if (unlikely(free < 0)) {
+		ret = -ENOSPC;
+		goto out;
+	}
+
+	slot = &st->cur[free];
+	if (slot->state == SCX_HMAP_EMPTY)
+		st->used += 1;
+
+	slot->key = key;
+	hmap_copy_in(slot, val);
+	slot->state = SCX_HMAP_FULL;
+
+	st->nr += 1;
+
+out:
+	hmap_write_unlock(st);
+
+	return ret;
+}
+
+__weak
+int scx_hmap_lookup(scx_hmap_t __arg_arena *hmap, u64 key, struct scx_hmap_val *val)
+{
+	scx_hmap_stripe_t *st;
+	scx_hmap_slot_t *slot;
+	u64 hash;
+	int ret;
+
+	if (unlikely(!hmap || !val))
+		return -EINVAL;
+
+	hash = hmap_hash(key);
+	st = hmap_stripe(hmap, hash);
+
+	ret = arena_spin_lock(&st->lock);
+	if (ret)
+		return ret;
+
+	slot = hmap_find(st, hash, key);
+	if (slot)
+		hmap_copy_out(val, slot);
+	else
+		ret = -ENOENT;
+
+	arena_spin_unlock(&st->lock);
+
+	return ret;
+}
+
+__weak
+int scx_hmap_lookup_nolock(scx_hmap_t __arg_arena *hmap, u64 key, struct scx_hmap_val *val)
+{
+	scx_hmap_stripe_t *st;
+	scx_hmap_slot_t *slot;
+	u64 hash, seq;
+	int i;
+
+	if (unlikely(!hmap || !val))
+		return -EINVAL;
+
+	hash = hmap_hash(key);
+	st = hmap_stripe(hmap, hash);
+
+	for (i = 0; i < SCX_HMAP_READ_RETRIES && can_loop; i++) {
+		seq = smp_load_acquire(&st->seq);
+		if (seq & 1)
+			continue;
+
+		slot = hmap_find(st, hash, key);
+		if (slot)
+			hmap_copy_out(val, slot);
+
+		smp_rmb();
+		if (READ_ONCE(st->seq) == seq)
+			return slot ? 0 : -ENOENT;
+	}
+
+	return scx_hmap_lookup(hmap, key, val);
+}
+
+__weak
+int scx_hmap_delete(scx_hmap_t __arg_arena *hmap, u64 key)
+{
+	scx_hmap_stripe_t *st;
+	scx_hmap_slot_t *slot;
+	u64 hash;
+	int ret;
+
+	if (unlikely(!hmap))
+		return -EINVAL;
+
+	hash = hmap_hash(key);
+	st = hmap_stripe(hmap, hash);
+
+	ret = hmap_write_lock(st);
+	if (ret)
+		return ret;
+
+	hmap_migrate(st, SCX_HMAP_MIGRATE);
+
+	slot = hmap_find(st, hash, key);
+	if (slot) {
+		slot->state = SCX_HMAP_TOMB;
+		st->nr -= 1;
+	} else {
+		ret = -ENOENT;
+	}
+
+	hmap_write_unlock(st);
+
+	return ret;
+}
+
+__weak
+u64 scx_hmap_nr(scx_hmap_t __arg_arena *hmap)
+{
+	u64 nr = 0;
+	int i;
+
+	if (unlikely(!hmap))
+		return 0;
+
+	for (i = 0; i < SCX_HMAP_STRIPES && can_loop; i++)
+		nr += READ_ONCE(hmap->stripe[i].nr);
+
+	return nr;
+}
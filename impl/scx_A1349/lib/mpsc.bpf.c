@@ -0,0 +1,195 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0
+ */
+
+#include <scx/common.bpf.h>
+
+#include <lib/sdt_task.h>
+#include <lib/mpsc.h>
+
+/*
+ * Bounded MPSC arena ring, see lib/mpsc.h for the protocol.
+ *
+ * A slot at position p is free for the producer that claims p once the
+ * consumer has moved the head past p - capacity; the capacity check against
+ * the head at claim time guarantees that, so producers never look at a
+ * slot's sequence word, only the consumer does.
+ */
+
+__weak
+u64 scx_mpsc_create_internal(u64 capacity)
+{
+	scx_mpsc_t *mpsc;
+
+	if (!capacity || capacity > SCX_MPSC_MAX_CAPACITY)
+		return (u64)NULL;
+
+	if (capacity & (capacity - 1))
+		return (u64)NULL;
+
+	mpsc = (scx_mpsc_t *)scx_static_alloc(sizeof(*mpsc), 1);
+	if (!mpsc)
+		return (u64)NULL;
+
+	/* Zeroed memory: no slot is published at any position >= 0. */
+	mpsc->slots = (scx_mpsc_slot_t *)scx_static_alloc(capacity * sizeof(*mpsc->slots), 1);
+	if (!mpsc->slots) {
+		/* XXX Free when migrating from the static allocator. */
+		return (u64)NULL;
+	}
+
+	mpsc->capacity = capacity;
+
+	return (u64)mpsc;
+}
+
+__weak
+int scx_mpsc_destroy(scx_mpsc_t __arg_arena *mpsc)
+{
+	if (unlikely(!mpsc))
+		return -EINVAL;
+
+	return -EOPNOTSUPP;
+}
+
+/* Claim @nr consecutive positions; the first one through @posp. */
+static __always_inline
+int mpsc_claim(scx_mpsc_t *mpsc, u64 nr, u64 *posp)
+{
+	u64 head, tail;
+	int i;
+
+	for (i = 0; i < SCX_MPSC_RETRIES && can_loop; i++) {
+		/*
+		 * Head first: tail only grows, so tail >= head. Read the other
+		 * way round, the consumer can pass a stale tail and tail - head
+		 * wraps into a spurious -ENOSPC.
+		 */
+		head = smp_load_acquire(&mpsc->head);
+		tail = READ_ONCE(mpsc->tail);
+
+		if (tail - head + nr > mpsc->capacity)
+			return -ENOSPC;
+
+		if (cmpxchg(&mpsc->tail, tail, tail + nr) == tail) {
+			*posp = tail;
+			return 0;
+		}
+	}
+
+	return -EAGAIN;
+}
+
+static __always_inline
+void mpsc_publish(scx_mpsc_t *mpsc, u64 pos, u64 val)
+{
+	scx_mpsc_slot_t *slot = &mpsc->slots[pos & (mpsc->capacity - 1)];
+
+	slot->val = val;
+	smp_store_release(&slot->seq, pos + 1);
+}
+
+__weak
+int scx_mpsc_push(scx_mpsc_t __arg_arena *mpsc, u64 val)
+{
+	u64 pos;
+	int ret;
+
+	if (unlikely(!mpsc))
+		return -EINVAL;
+
+	ret = mpsc_claim(mpsc, 1, &pos);
+	if (ret)
+		return ret;
+
+	mpsc_publish(mpsc, pos, val);
+
+	return 0;
+}
+
+__weak
+int scx_mpsc_push_batch(scx_mpsc_t __arg_arena *mpsc, struct scx_mpsc_batch *batch)
+{
+	u64 pos, nr;
+	int ret, i;
+
+	if (unlikely(!mpsc || !batch))
+		return -EINVAL;
+
+	nr = batch->nr;
+	if (!nr || nr > SCX_MPSC_BATCH)
+		return -EINVAL;
+
+	ret = mpsc_claim(mpsc, nr, &pos);
+	if (ret)
+		return ret;
+
+	for (i = 0; i < nr && i < SCX_MPSC_BATCH; i++)
+		mpsc_publish(mpsc, pos + i, batch->val[i]);
+
+	return 0;
+}
+
+__weak
+int scx_mpsc_pop(scx_mpsc_t __arg_arena *mpsc, u64 *val)
+{
+	scx_mpsc_slot_t *slot;
+	u64 head;
+
+	if (unlikely(!mpsc || !val))
+		return -EINVAL;
+
+	head = mpsc->head;
+	slot = &mpsc->slots[head & (mpsc->capacity - 1)];
+
+	if (smp_load_acquire(&slot->seq) != head + 1)
+		return -ENOENT;
+
+	*val = slot->val;
+	smp_store_release(&mpsc->head, head + 1);
+
+	return 0;
+}
+
+__weak
+int scx_mpsc_drain(scx_mpsc_t __arg_arena *mpsc, struct scx_mpsc_batch *batch)
+{
+	scx_mpsc_slot_t *slot;
+	u64 head;
+	int i;
+
+	if (unlikely(!mpsc || !batch))
+		return -EINVAL;
+
+	head = mpsc->head;
+
+	for (i = 0; i < SCX_MPSC_BATCH; i++) {
+		slot = &mpsc->slots[(head + i) & (mpsc->capacity - 1)];
+		if (smp_load_acquire(&slot->seq) != head + i + 1)
+			break;
+
+		batch->val[i] = slot->val;
+	}
+
+	batch->nr = i;
+
+	/* One head update frees the whole run for the producers. */
+	if (i)
+		smp_store_release(&mpsc->head, head + i);
+
+	return i;
+}
+
+__weak
+u64 scx_mpsc_nr_queued(scx_mpsc_t __arg_arena *mpsc)
+{
+	u64 head;
+
+	if (unlikely(!mpsc))
+		return 0;
+
+	/* Head before tail, as in mpsc_claim(). */
+	head = smp_load_acquire(&mpsc->head);
+
+	return READ_ONCE(mpsc->tail) - head;
+}
@@ -0,0 +1,38 @@
+#include <stdio.h>
+
+/*
+ * Runs the SCX_TEST()s of one *.test.bpf.c. SCX_TEST_LIST names a header
+ * of SCX_TEST_ENTRY(name) lines, generated from the test file by the
+ * Makefile.
+ */
+#define SCX_TEST_ENTRY(name) int name(void);
+#include SCX_TEST_LIST
+#undef SCX_TEST_ENTRY
+
+#define SCX_TEST_ENTRY(name) { #name, name },
+static const struct {
+	const char *name;
+	int (*fn)(void);
+} scx_tests[] = {
+#include SCX_TEST_LIST
+};
+#undef SCX_TEST_ENTRY
+
+int main(void)
+{
+	unsigned int i, failed = 0;
+	const unsigned int nr = sizeof(scx_tests) / sizeof(scx_tests[0]);
+
+	for (i = 0; i < nr; i++) {
+		if (scx_tests[i].fn()) {
+			fprintf(stderr, "FAIL %s\n", scx_tests[i].name);
+			failed++;
+		} else {
+			printf("ok   %s\n", scx_tests[i].name);
+		}
+	}
+
+	printf("%u/%u passed\n", nr - failed, nr);
+
+	return failed ? 1 : 0;
+}
@@ -48,6 +48,18 @@ int arena_selftest(void)
 	SELFTEST_RUN(SCX_SELFTEST_ID_TOPOLOGY,
 		     scx_selftest_topology,
 		     "scx_selftest_topology");
+	SELFTEST_RUN(SCX_SELFTEST_ID_HMAP,
+		     scx_selftest_hmap,
+		     "scx_selftest_hmap");
+	SELFTEST_RUN(SCX_SELFTEST_ID_MPSC,
+		     scx_selftest_mpsc,
+		     "scx_selftest_mpsc");
+	SELFTEST_RUN(SCX_SELFTEST_ID_TWHEEL,
+		     scx_selftest_twheel,
+		     "scx_selftest_twheel");
+	SELFTEST_RUN(SCX_SELFTEST_ID_SKETCH,
+		     scx_selftest_sketch,
+		     "scx_selftest_sketch");
 
 	bpf_printk("Selftests successful.");
 
@@ -6,8 +6,12 @@
  */
 
 #include <assert.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
 #include <stdio.h>
 #include <string.h>
+#include <time.h>
 #include <unistd.h>
 
 #include <bpf/libbpf.h>
@@ -24,7 +28,9 @@
 #include <lib/atq.h>
 #include <lib/dhq.h>
 #include <lib/arena.h>
+#include <lib/mpsc.h>
 #include <lib/sdt_task.h>
+#include <lib/sketch.h>
 
 #include "selftest.skel.h"
 
@@ -286,6 +292,387 @@ selftest(struct selftest *skel)
 	return 0;
 }
 
+static void
+selftest_hmap_bench_print(const char *name, u64 ns, u64 ops)
+{
+	printf("  %-20s %8.1f ns/op\n", name, ops ? (double)ns / ops : 0.0);
+}
+
+static int
+selftest_hmap_bench(struct selftest *skel)
+{
+	struct bpf_test_run_opts opts;
+	struct scx_hmap_bench_args args;
+	int prog_fd;
+	int ret;
+
+	args = (struct scx_hmap_bench_args) {
+		.nr_keys = SCX_HMAP_BENCH_KEYS,
+		.nr_ops = 64 * SCX_HMAP_BENCH_KEYS,
+	};
+
+	memset(&opts, 0, sizeof(opts));
+	opts = (struct bpf_test_run_opts) {
+		.sz = sizeof(opts),
+		.ctx_in = &args,
+		.ctx_size_in = sizeof(args),
+	};
+
+	prog_fd = bpf_program__fd(skel->progs.hmap_bench);
+	assert(prog_fd >= 0 && "no program found");
+
+	ret = bpf_prog_test_run_opts(prog_fd, &opts);
+	VALIDATE(ret);
+
+	if (opts.retval) {
+		fprintf(stderr, "error %d in %s\n", opts.retval, __func__);
+		return opts.retval;
+	}
+
+	printf("hmap bench (%llu keys, %llu lookups):\n",
+	       (unsigned long long)args.nr_keys,
+	       (unsigned long long)args.nr_ops);
+	selftest_hmap_bench_print("arena update", args.arena_update_ns, args.nr_keys);
+	selftest_hmap_bench_print("arena lookup", args.arena_lookup_ns, args.nr_ops);
+	selftest_hmap_bench_print("arena lookup_nolock", args.arena_nolock_ns, args.nr_ops);
+	selftest_hmap_bench_print("BPF hash update", args.map_update_ns, args.nr_keys);
+	selftest_hmap_bench_print("BPF hash lookup", args.map_lookup_ns, args.nr_ops);
+
+	return 0;
+}
+
+/* Merged top-K of sketch_user_fill: per-instance sums plus min charges. */
+static const struct scx_topk_entry sketch_user_topk[] = {
+	{ .key = 1, .count = 17, .err = 2 },
+	{ .key = 2, .count = 17, .err = 0 },
+	{ .key = 3, .count = 8, .err = 3 },
+	{ .key = 4, .count = 6, .err = 2 },
+	{ .key = 5, .count = 14, .err = 6 },
+	{ .key = 6, .count = 9, .err = 4 },
+	{ .key = 7, .count = 6, .err = 4 },
+};
+
+#define SKETCH_USER_TOPK_NR	(sizeof(sketch_user_topk) / sizeof(sketch_user_topk[0]))
+
+static int
+selftest_sketch_user_topk(const struct scx_topk_entry *out, u32 nr)
+{
+	u32 i, j;
+
+	if (nr != SKETCH_USER_TOPK_NR) {
+		fprintf(stderr, "%s: topk merged %u keys, expected %zu\n", __func__,
+			nr, SKETCH_USER_TOPK_NR);
+		return -EINVAL;
+	}
+
+	for (i = 0; i < nr; i++) {
+		if (i && out[i].count > out[i - 1].count) {
+			fprintf(stderr, "%s: topk out of order at %u\n", __func__, i);
+			return -EINVAL;
+		}
+
+		for (j = 0; j < SKETCH_USER_TOPK_NR && sketch_user_topk[j].key != out[i].key; j++)
+			;
+
+		if (j == SKETCH_USER_TOPK_NR ||
+		    out[i].count != sketch_user_topk[j].count ||
+		    out[i].err != sketch_user_topk[j].err) {
+			fprintf(stderr, "%s: topk key %llu count %llu err %llu\n", __func__,
+				(unsigned long long)out[i].key,
+				(unsigned long long)out[i].count,
+				(unsigned long long)out[i].err);
+			return -EINVAL;
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * The agent's view of the sketches: sketch_user_fill spreads keys over
+ * several instances and the *_user() helpers merge them back through the
+ * arena mapping.
+ */
+static int
+selftest_sketch_user(struct selftest *skel)
+{
+	struct scx_sketch_user_args args = {};
+	struct scx_topk_entry *out;
+	struct bpf_test_run_opts opts;
+	u64 key, est, over = 0, total = 0;
+	scx_topk_t *topk;
+	scx_cms_t *cms;
+	scx_hll_t *hll;
+	double distinct;
+	int prog_fd;
+	u32 nr;
+	int ret;
+
+	memset(&opts, 0, sizeof(opts));
+	opts = (struct bpf_test_run_opts) {
+		.sz = sizeof(opts),
+		.ctx_in = &args,
+		.ctx_size_in = sizeof(args),
+	};
+
+	prog_fd = bpf_program__fd(skel->progs.sketch_user_fill);
+	assert(prog_fd >= 0 && "no program found");
+
+	ret = bpf_prog_test_run_opts(prog_fd, &opts);
+	VALIDATE(ret);
+
+	if (opts.retval) {
+		fprintf(stderr, "error %d in %s\n", opts.retval, __func__);
+		return opts.retval;
+	}
+
+	cms = (scx_cms_t *)args.cms;
+	topk = (scx_topk_t *)args.topk;
+	hll = (scx_hll_t *)args.hll;
+
+	/* Key k was counted k + 2 times over two instances. */
+	for (key = 0; key < SCX_SKETCH_USER_CMS_KEYS; key++) {
+		est = scx_cms_estimate_user(cms, key);
+		if (est < key + 2) {
+			fprintf(stderr, "%s: cms key %llu estimate %llu below %llu\n", __func__,
+				(unsigned long long)key, (unsigned long long)est,
+				(unsigned long long)key + 2);
+			return -EINVAL;
+		}
+		over += est - (key + 2);
+		total += key + 2;
+	}
+
+	if (over * cms->width > 3 * total * SCX_SKETCH_USER_CMS_KEYS) {
+		fprintf(stderr, "%s: cms overshoot %llu on %llu\n", __func__,
+			(unsigned long long)over, (unsigned long long)total);
+		return -EINVAL;
+	}
+
+	/* The merge needs room for k entries per instance, one per CPU. */
+	out = calloc((size_t)topk->k * topk->nr_inst, sizeof(*out));
+	if (!out)
+		return -ENOMEM;
+
+	nr = scx_topk_merge_user(topk, out);
+	ret = selftest_sketch_user_topk(out, nr);
+	free(out);
+	if (ret)
+		return ret;
+
+	/* Repeats across instances do not count; ~3% error, allow 10%. */
+	total = SCX_SKETCH_USER_INST * SCX_SKETCH_USER_HLL_KEYS;
+	distinct = scx_hll_estimate_user(hll);
+	if (distinct < 0.9 * total || distinct > 1.1 * total) {
+		fprintf(stderr, "%s: hll estimate %.0f for %llu keys\n", __func__,
+			distinct, (unsigned long long)total);
+		return -EINVAL;
+	}
+
+	return 0;
+}
+
+#define MPSC_BENCH_PRODUCERS	2
+#define MPSC_BENCH_PER_PRODUCER	(1ULL << 20)
+#define MPSC_BENCH_CHUNK	4096
+
+struct mpsc_bench_thread {
+	struct selftest *skel;
+	scx_mpsc_t *mpsc;
+	int *live;		/* producers still running */
+	u64 start;
+	u64 nr;
+	u64 done;
+	u64 sum;
+	int err;
+	bool user;
+};
+
+static int
+mpsc_bench_call(struct bpf_program *prog, struct scx_mpsc_bench_args *args)
+{
+	struct bpf_test_run_opts opts;
+	int ret;
+
+	memset(&opts, 0, sizeof(opts));
+	opts = (struct bpf_test_run_opts) {
+		.sz = sizeof(opts),
+		.ctx_in = args,
+		.ctx_size_in = sizeof(*args),
+	};
+
+	ret = bpf_prog_test_run_opts(bpf_program__fd(prog), &opts);
+	if (ret)
+		return ret;
+
+	return opts.retval;
+}
+
+static void *
+mpsc_bench_producer(void *arg)
+{
+	struct mpsc_bench_thread *thr = arg;
+	struct scx_mpsc_bench_args args;
+	u64 vals[SCX_MPSC_BATCH];
+	u64 pos = 0, nr, i;
+
+	while (pos < thr->nr) {
+		if (thr->user) {
+			nr = thr->nr - pos < SCX_MPSC_BATCH ? thr->nr - pos : SCX_MPSC_BATCH;
+			for (i = 0; i < nr; i++)
+				vals[i] = thr->start + pos + i;
+
+			if (scx_mpsc_push_user(thr->mpsc, vals, nr))
+				sched_yield();
+			else
+				pos += nr;
+			continue;
+		}
+
+		args = (struct scx_mpsc_bench_args) {
+			.mpsc = (u64)thr->mpsc,
+			.start = thr->start + pos,
+			.nr = thr->nr - pos < MPSC_BENCH_CHUNK ? thr->nr - pos : MPSC_BENCH_CHUNK,
+		};
+
+		thr->err = mpsc_bench_call(thr->skel->progs.mpsc_bench_push, &args);
+		if (thr->err)
+			break;
+
+		pos += args.done;
+		if (!args.done)
+			sched_yield();
+	}
+
+	thr->done = pos;
+	__atomic_sub_fetch(thr->live, 1, __ATOMIC_RELEASE);
+
+	return NULL;
+}
+
+static void *
+mpsc_bench_consumer(void *arg)
+{
+	struct mpsc_bench_thread *thr = arg;
+	struct scx_mpsc_bench_args args;
+	bool exited;
+	u64 pos = 0;
+
+	while (pos < thr->nr) {
+		args = (struct scx_mpsc_bench_args) {
+			.mpsc = (u64)thr->mpsc,
+			.nr = thr->nr - pos,
+		};
+
+		/* Every push is visible once its producer has exited. */
+		exited = !__atomic_load_n(thr->live, __ATOMIC_ACQUIRE);
+
+		thr->err = mpsc_bench_call(thr->skel->progs.mpsc_bench_drain, &args);
+		if (thr->err)
+			break;
+
+		pos += args.done;
+		thr->sum += args.sum;
+		if (!args.done) {
+			/* Producers gave up early: the ring is empty for good. */
+			if (exited)
+				break;
+			sched_yield();
+		}
+	}
+
+	thr->done = pos;
+
+	return NULL;
+}
+
+/*
+ * MPSC_BENCH_PRODUCERS threads against one consumer, pushing from BPF or,
+ * with @user, straight into the arena mapping as the agent would. The
+ * values are 0 .. total - 1 across producers, so the drained count and sum
+ * check that nothing was lost or delivered twice.
+ */
+static int
+selftest_mpsc_bench_run(struct selftest *skel, scx_mpsc_t *mpsc, bool user)
+{
+	struct mpsc_bench_thread thr[MPSC_BENCH_PRODUCERS + 1];
+	pthread_t tids[MPSC_BENCH_PRODUCERS + 1];
+	u64 total = MPSC_BENCH_PRODUCERS * MPSC_BENCH_PER_PRODUCER;
+	struct mpsc_bench_thread *cons = &thr[MPSC_BENCH_PRODUCERS];
+	int live = MPSC_BENCH_PRODUCERS;
+	struct timespec start, end;
+	double ns;
+	int i, ret;
+
+	for (i = 0; i <= MPSC_BENCH_PRODUCERS; i++) {
+		thr[i] = (struct mpsc_bench_thread) {
+			.skel = skel,
+			.mpsc = mpsc,
+			.live = &live,
+			.start = i * MPSC_BENCH_PER_PRODUCER,
+			.nr = i < MPSC_BENCH_PRODUCERS ? MPSC_BENCH_PER_PRODUCER : total,
+			.user = user,
+		};
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	for (i = 0; i <= MPSC_BENCH_PRODUCERS; i++) {
+		ret = pthread_create(&tids[i], NULL,
+				     i < MPSC_BENCH_PRODUCERS ? mpsc_bench_producer : mpsc_bench_consumer,
+				     &thr[i]);
+		VALIDATE(ret);
+	}
+
+	for (i = 0; i <= MPSC_BENCH_PRODUCERS; i++)
+		pthread_join(tids[i], NULL);
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	for (i = 0; i <= MPSC_BENCH_PRODUCERS; i++) {
+		if (thr[i].err) {
+			fprintf(stderr, "error %d in %s thread %d\n", thr[i].err, __func__, i);
+			return thr[i].err;
+		}
+	}
+
+	if (cons->done != total || cons->sum != total * (total - 1) / 2) {
+		fprintf(stderr, "%s: drained %llu of %llu values, sum %llu, expected %llu\n",
+			__func__, (unsigned long long)cons->done, (unsigned long long)total,
+			(unsigned long long)cons->sum,
+			(unsigned long long)(total * (total - 1) / 2));
+		return -EIO;
+	}
+
+	ns = (end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec);
+	printf("  %-16s %8.2f Mvals/s\n", user ? "user producers" : "bpf producers",
+	       total * 1e3 / ns);
+
+	return 0;
+}
+
+static int
+selftest_mpsc_bench(struct selftest *skel)
+{
+	struct scx_mpsc_bench_args args = {};
+	int ret;
+
+	ret = mpsc_bench_call(skel->progs.mpsc_bench_create, &args);
+	if (ret) {
+		fprintf(stderr, "error %d in %s\n", ret, __func__);
+		return ret;
+	}
+
+	printf("mpsc bench (%d producers, %llu values each, %d slots):\n",
+	       MPSC_BENCH_PRODUCERS, (unsigned long long)MPSC_BENCH_PER_PRODUCER,
+	       SCX_MPSC_BENCH_CAPACITY);
+	ret = selftest_mpsc_bench_run(skel, (scx_mpsc_t *)args.mpsc, false);
+	if (ret)
+		return ret;
+
+	return selftest_mpsc_bench_run(skel, (scx_mpsc_t *)args.mpsc, true);
+}
+
 int bump_rlimit(void)
 {
 	int ret;
@@ -334,6 +721,17 @@ int main(int argc, char *argv[])
 	selftest_topology_init(skel);
 
 	selftest(skel);
+	ret = selftest_sketch_user(skel);
+	if (ret)
+		return 1;
+
+	ret = selftest_hmap_bench(skel);
+	if (ret)
+		return 1;
+
+	ret = selftest_mpsc_bench(skel);
+	if (ret)
+		return 1;
 
 	printf("Tests complete");
 
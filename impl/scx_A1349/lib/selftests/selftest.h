@@ -25,6 +25,10 @@ enum scx_selftest_id {
 	SCX_SELFTEST_ID_MINHEAP			= 4,
 	SCX_SELFTEST_ID_RBTREE			= 5,
 	SCX_SELFTEST_ID_TOPOLOGY		= 6,
+	SCX_SELFTEST_ID_HMAP			= 7,
+	SCX_SELFTEST_ID_MPSC			= 8,
+	SCX_SELFTEST_ID_TWHEEL			= 9,
+	SCX_SELFTEST_ID_SKETCH			= 10,
 };
 
 #define SCX_SELFTEST(func, ...)		\
@@ -52,10 +56,64 @@ int scx_selftest_atq(void);
 int scx_selftest_dhq(void);
 int scx_selftest_bitmap(void);
 int scx_selftest_btree(void);
+int scx_selftest_hmap(void);
 int scx_selftest_lvqueue(void);
 int scx_selftest_minheap(void);
+int scx_selftest_mpsc(void);
 int scx_selftest_rbtree(void);
+int scx_selftest_sketch(void);
 int scx_selftest_topology(void);
+int scx_selftest_twheel(void);
+
+/*
+ * hmap_bench: arena hash map vs BPF_MAP_TYPE_HASH. nr_keys inserts, then
+ * nr_ops lookups cycling over the keys; totals in ns come back in the
+ * remaining fields.
+ */
+#define SCX_HMAP_BENCH_KEYS	4096
+
+struct scx_hmap_bench_args {
+	u64 nr_keys;
+	u64 nr_ops;
+	u64 arena_update_ns;
+	u64 arena_lookup_ns;
+	u64 arena_nolock_ns;
+	u64 map_update_ns;
+	u64 map_lookup_ns;
+};
+
+/*
+ * mpsc_bench_*: one ring of SCX_MPSC_BENCH_CAPACITY slots shared by all
+ * threads. mpsc is the ring (an arena pointer); push sends start ..
+ * start + nr - 1, drain takes up to nr; done is how many went through and
+ * sum the total of the drained values.
+ */
+#define SCX_MPSC_BENCH_CAPACITY	4096
+
+struct scx_mpsc_bench_args {
+	u64 mpsc;
+	u64 start;
+	u64 nr;
+	u64 done;
+	u64 sum;
+};
+
+/*
+ * sketch_user_fill: a count-min, top-K and HyperLogLog sketch with one
+ * instance per CPU, at least SCX_SKETCH_USER_INST, and different keys in
+ * each of the first SCX_SKETCH_USER_INST, for the agent-side merges. The
+ * fields are arena pointers.
+ */
+#define SCX_SKETCH_USER_INST		4
+#define SCX_SKETCH_USER_TOPK		4
+#define SCX_SKETCH_USER_CMS_KEYS	64
+#define SCX_SKETCH_USER_HLL_KEYS	500
+
+struct scx_sketch_user_args {
+	u64 cms;
+	u64 topk;
+	u64 hll;
+};
 
 #ifndef __BPF__
 
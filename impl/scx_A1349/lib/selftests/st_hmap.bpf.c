@@ -0,0 +1,290 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0
+ */
+
+#include <scx/common.bpf.h>
+
+#include <lib/sdt_task.h>
+#include <lib/hmap.h>
+
+#include "selftest.h"
+
+/* Enough keys to push every stripe through several resizes. */
+#define HMAP_NR_KEYS	(2000ULL)
+
+static __always_inline
+void hmap_val_fill(struct scx_hmap_val *val, u64 key)
+{
+	val->w[0] = key * 3;
+	val->w[1] = key + 1;
+	val->w[2] = 0;
+	val->w[3] = ~key;
+}
+
+static __always_inline
+bool hmap_val_ok(struct scx_hmap_val *val, u64 key)
+{
+	return val->w[0] == key * 3 && val->w[1] == key + 1 && val->w[3] == ~key;
+}
+
+/*
+ * Every test starts and ends with an empty map.
+ */
+static
+int scx_selftest_hmap_empty(scx_hmap_t *hmap)
+{
+	struct scx_hmap_val val;
+
+	if (scx_hmap_nr(hmap))
+		return -EINVAL;
+
+	if (scx_hmap_lookup(hmap, 0, &val) != -ENOENT)
+		return 1;
+
+	if (scx_hmap_lookup_nolock(hmap, 42, &val) != -ENOENT)
+		return 2;
+
+	if (scx_hmap_delete(hmap, 42) != -ENOENT)
+		return 3;
+
+	return 0;
+}
+
+static
+int scx_selftest_hmap_flags(scx_hmap_t *hmap)
+{
+	struct scx_hmap_val val;
+	int ret;
+
+	hmap_val_fill(&val, 7);
+
+	ret = scx_hmap_update(hmap, 7, &val, SCX_HMAP_EXIST);
+	if (ret != -ENOENT)
+		return 1;
+
+	ret = scx_hmap_update(hmap, 7, &val, SCX_HMAP_NOEXIST);
+	if (ret)
+		return 2;
+
+	ret = scx_hmap_update(hmap, 7, &val, SCX_HMAP_NOEXIST);
+	if (ret != -EEXIST)
+		return 3;
+
+	hmap_val_fill(&val, 8);
+	ret = scx_hmap_update(hmap, 7, &val, SCX_HMAP_EXIST);
+	if (ret)
+		return 4;
+
+	ret = scx_hmap_lookup(hmap, 7, &val);
+	if (ret || !hmap_val_ok(&val, 8))
+		return 5;
+
+	if (scx_hmap_nr(hmap) != 1)
+		return 6;
+
+	if (scx_hmap_delete(hmap, 7))
+		return 7;
+
+	return 0;
+}
+
+/*
+ * Insert enough keys to resize every stripe, then read them back through
+ * both lookup paths, key 0 included.
+ */
+static
+int scx_selftest_hmap_grow(scx_hmap_t *hmap)
+{
+	struct scx_hmap_val val;
+	int ret;
+	u64 i;
+
+	for (i = 0; i < HMAP_NR_KEYS && can_loop; i++) {
+		hmap_val_fill(&val, i);
+		ret = scx_hmap_update(hmap, i, &val, SCX_HMAP_ANY);
+		if (ret)
+			return ret;
+	}
+
+	if (scx_hmap_nr(hmap) != HMAP_NR_KEYS)
+		return -EINVAL;
+
+	for (i = 0; i < HMAP_NR_KEYS && can_loop; i++) {
+		ret = scx_hmap_lookup(hmap, i, &val);
+		if (ret || !hmap_val_ok(&val, i))
+			return 1;
+
+		ret = scx_hmap_lookup_nolock(hmap, i, &val);
+		if (ret || !hmap_val_ok(&val, i))
+			return 2;
+	}
+
+	if (scx_hmap_lookup(hmap, HMAP_NR_KEYS, &val) != -ENOENT)
+		return 3;
+
+	return 0;
+}
+
+/*
+ * Delete the even keys left by the grow test, check that the odd ones
+ * survive the tombstones, then delete the rest.
+ */
+static
+int scx_selftest_hmap_delete(scx_hmap_t *hmap)
+{
+	struct scx_hmap_val val;
+	int ret;
+	u64 i;
+
+	for (i = 0; i < HMAP_NR_KEYS && can_loop; i += 2) {
+		if (scx_hmap_delete(hmap, i))
+			return 1;
+	}
+
+	if (scx_hmap_nr(hmap) != HMAP_NR_KEYS / 2)
+		return 2;
+
+	for (i = 0; i < HMAP_NR_KEYS && can_loop; i++) {
+		ret = scx_hmap_lookup_nolock(hmap, i, &val);
+		if (i % 2 && (ret || !hmap_val_ok(&val, i)))
+			return 3;
+		if (!(i % 2) && ret != -ENOENT)
+			return 4;
+	}
+
+	for (i = 1; i < HMAP_NR_KEYS && can_loop; i += 2) {
+		if (scx_hmap_delete(hmap, i))
+			return 5;
+	}
+
+	if (scx_hmap_nr(hmap))
+		return 6;
+
+	return 0;
+}
+
+/*
+ * Insert and delete disjoint key ranges so stripes fill with tombstones and
+ * get rehashed at the same size instead of growing without bound.
+ */
+static
+int scx_selftest_hmap_churn(scx_hmap_t *hmap)
+{
+	struct scx_hmap_val val;
+	u64 round, i, key;
+	int ret;
+
+	for (round = 0; round < 16 && can_loop; round++) {
+		for (i = 0; i < 256 && can_loop; i++) {
+			key = (round << 32) | i;
+			hmap_val_fill(&val, key);
+			ret = scx_hmap_update(hmap, key, &val, SCX_HMAP_NOEXIST);
+			if (ret)
+				return ret;
+		}
+
+		for (i = 0; i < 256 && can_loop; i++) {
+			key = (round << 32) | i;
+			ret = scx_hmap_lookup(hmap, key, &val);
+			if (ret || !hmap_val_ok(&val, key))
+				return 1;
+
+			if (scx_hmap_delete(hmap, key))
+				return 2;
+		}
+	}
+
+	if (scx_hmap_nr(hmap))
+		return 3;
+
+	return 0;
+}
+
+#define SCX_HMAP_SELFTEST(suffix) SCX_SELFTEST(scx_selftest_hmap_ ## suffix, hmap)
+
+__weak
+int scx_selftest_hmap(void)
+{
+	scx_hmap_t *hmap;
+
+	hmap = scx_hmap_create();
+	if (!hmap) {
+		bpf_printk("Could not allocate hash map");
+		return -ENOMEM;
+	}
+
+	SCX_HMAP_SELFTEST(empty);
+	SCX_HMAP_SELFTEST(flags);
+	SCX_HMAP_SELFTEST(grow);
+	SCX_HMAP_SELFTEST(delete);
+	SCX_HMAP_SELFTEST(churn);
+	SCX_HMAP_SELFTEST(empty);
+
+	return 0;
+}
+
+/*
+ * Benchmark against BPF_MAP_TYPE_HASH: the same keys and values through
+ * both, timed from inside the program so the syscall cost is left out.
+ * Driven by selftest_hmap_bench() in selftest.c.
+ */
+struct {
+	__uint(type, BPF_MAP_TYPE_HASH);
+	__uint(max_entries, SCX_HMAP_BENCH_KEYS);
+	__type(key, u64);
+	__type(value, struct scx_hmap_val);
+} hmap_bench_map SEC(".maps");
+
+SEC("syscall")
+int hmap_bench(struct scx_hmap_bench_args *args)
+{
+	struct scx_hmap_val val, *valp;
+	u64 nr_keys, nr_ops, i, key;
+	scx_hmap_t *hmap;
+	u64 start;
+
+	nr_keys = args->nr_keys;
+	if (!nr_keys || nr_keys > SCX_HMAP_BENCH_KEYS)
+		return -EINVAL;
+	nr_ops = args->nr_ops;
+
+	hmap = scx_hmap_create();
+	if (!hmap)
+		return -ENOMEM;
+
+	start = bpf_ktime_get_ns();
+	for (i = 0; i < nr_keys && can_loop; i++) {
+		hmap_val_fill(&val, i);
+		scx_hmap_update(hmap, i, &val, SCX_HMAP_ANY);
+	}
+	args->arena_update_ns = bpf_ktime_get_ns() - start;
+
+	start = bpf_ktime_get_ns();
+	for (i = 0; i < nr_ops && can_loop; i++)
+		scx_hmap_lookup(hmap, i % nr_keys, &val);
+	args->arena_lookup_ns = bpf_ktime_get_ns() - start;
+
+	start = bpf_ktime_get_ns();
+	for (i = 0; i < nr_ops && can_loop; i++)
+		scx_hmap_lookup_nolock(hmap, i % nr_keys, &val);
+	args->arena_nolock_ns = bpf_ktime_get_ns() - start;
+
+	start = bpf_ktime_get_ns();
+	for (i = 0; i < nr_keys && can_loop; i++) {
+		key = i;
+		hmap_val_fill(&val, i);
+		bpf_map_update_elem(&hmap_bench_map, &key, &val, BPF_ANY);
+	}
+	args->map_update_ns = bpf_ktime_get_ns() - start;
+
+	start = bpf_ktime_get_ns();
+	for (i = 0; i < nr_ops && can_loop; i++) {
+		key = i % nr_keys;
+		valp = bpf_map_lookup_elem(&hmap_bench_map, &key);
+		if (valp)
+			val.w[0] = valp->w[0];
+	}
+	args->map_lookup_ns = bpf_ktime_get_ns() - start;
+
+	return 0;
+}
@@ -0,0 +1,214 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0
+ */
+
+#include <scx/common.bpf.h>
+
+#include <lib/sdt_task.h>
+#include <lib/mpsc.h>
+
+#include "selftest.h"
+
+#define MPSC_CAPACITY	(64ULL)
+
+/*
+ * NOTE: These selftests are single-threaded; the concurrent paths are
+ * exercised by selftest_mpsc_bench() in selftest.c. Every test starts and
+ * ends with an empty ring.
+ */
+
+static
+int scx_selftest_mpsc_empty(scx_mpsc_t *mpsc)
+{
+	struct scx_mpsc_batch batch;
+	u64 val;
+
+	if (scx_mpsc_nr_queued(mpsc))
+		return -EINVAL;
+
+	if (scx_mpsc_pop(mpsc, &val) != -ENOENT)
+		return 1;
+
+	if (scx_mpsc_drain(mpsc, &batch) || batch.nr)
+		return 2;
+
+	return 0;
+}
+
+/* Fill to capacity, overflow once, then read back in order. */
+static
+int scx_selftest_mpsc_fifo(scx_mpsc_t *mpsc)
+{
+	u64 i, val;
+	int ret;
+
+	for (i = 0; i < MPSC_CAPACITY && can_loop; i++) {
+		ret = scx_mpsc_push(mpsc, i);
+		if (ret)
+			return ret;
+	}
+
+	if (scx_mpsc_push(mpsc, MPSC_CAPACITY) != -ENOSPC)
+		return 1;
+
+	if (scx_mpsc_nr_queued(mpsc) != MPSC_CAPACITY)
+		return 2;
+
+	for (i = 0; i < MPSC_CAPACITY && can_loop; i++) {
+		ret = scx_mpsc_pop(mpsc, &val);
+		if (ret)
+			return 3;
+
+		if (val != i)
+			return 4;
+	}
+
+	return 0;
+}
+
+/*
+ * Push and drain full batches for several laps so claims straddle the end
+ * of the slot array, then check the all-or-nothing batch limits.
+ */
+static
+int scx_selftest_mpsc_batch(scx_mpsc_t *mpsc)
+{
+	struct scx_mpsc_batch batch;
+	u64 next = 0, expect = 0;
+	int ret, round, i;
+
+	for (round = 0; round < 4 * MPSC_CAPACITY / 3 && can_loop; round++) {
+		batch.nr = 3;
+		for (i = 0; i < 3; i++)
+			batch.val[i] = next++;
+
+		ret = scx_mpsc_push_batch(mpsc, &batch);
+		if (ret)
+			return ret;
+
+		if (scx_mpsc_drain(mpsc, &batch) != 3)
+			return 1;
+
+		for (i = 0; i < 3; i++) {
+			if (batch.val[i] != expect++)
+				return 2;
+		}
+	}
+
+	batch.nr = 0;
+	if (scx_mpsc_push_batch(mpsc, &batch) != -EINVAL)
+		return 3;
+
+	batch.nr = SCX_MPSC_BATCH + 1;
+	if (scx_mpsc_push_batch(mpsc, &batch) != -EINVAL)
+		return 4;
+
+	/* A batch that does not fit whole is refused whole. */
+	for (i = 0; i < MPSC_CAPACITY - 1 && can_loop; i++) {
+		if (scx_mpsc_push(mpsc, i))
+			return 5;
+	}
+
+	batch.nr = 2;
+	if (scx_mpsc_push_batch(mpsc, &batch) != -ENOSPC)
+		return 6;
+
+	if (scx_mpsc_nr_queued(mpsc) != MPSC_CAPACITY - 1)
+		return 7;
+
+	for (i = 0; i < MPSC_CAPACITY && can_loop; i++) {
+		if (!scx_mpsc_drain(mpsc, &batch))
+			break;
+	}
+
+	return 0;
+}
+
+#define SCX_MPSC_SELFTEST(suffix) SCX_SELFTEST(scx_selftest_mpsc_ ## suffix, mpsc)
+
+__weak
+int scx_selftest_mpsc(void)
+{
+	scx_mpsc_t *mpsc;
+
+	if (scx_mpsc_create(MPSC_CAPACITY + 1))
+		return -EINVAL;
+
+	mpsc = scx_mpsc_create(MPSC_CAPACITY);
+	if (!mpsc) {
+		bpf_printk("Could not allocate MPSC ring");
+		return -ENOMEM;
+	}
+
+	SCX_MPSC_SELFTEST(empty);
+	SCX_MPSC_SELFTEST(fifo);
+	SCX_MPSC_SELFTEST(empty);
+	SCX_MPSC_SELFTEST(batch);
+	SCX_MPSC_SELFTEST(empty);
+
+	return 0;
+}
+
+/*
+ * Multi-threaded benchmark, driven by selftest_mpsc_bench() in selftest.c:
+ * producer threads run mpsc_bench_push (or push from userspace through the
+ * arena mapping) while one consumer thread runs mpsc_bench_drain.
+ */
+SEC("syscall")
+int mpsc_bench_create(struct scx_mpsc_bench_args *args)
+{
+	args->mpsc = (u64)scx_mpsc_create(SCX_MPSC_BENCH_CAPACITY);
+
+	return args->mpsc ? 0 : -ENOMEM;
+}
+
+/* Push start .. start + nr - 1 in batches; stop early when full. */
+SEC("syscall")
+int mpsc_bench_push(struct scx_mpsc_bench_args *args)
+{
+	scx_mpsc_t *mpsc = (scx_mpsc_t *)args->mpsc;
+	struct scx_mpsc_batch batch;
+	u64 i = 0, nr = args->nr;
+	int j;
+
+	while (i < nr && can_loop) {
+		batch.nr = nr - i < SCX_MPSC_BATCH ? nr - i : SCX_MPSC_BATCH;
+		for (j = 0; j < SCX_MPSC_BATCH; j++)
+			batch.val[j] = args->start + i + j;
+
+		if (scx_mpsc_push_batch(mpsc, &batch))
+			break;
+
+		i += batch.nr;
+	}
+
+	args->done = i;
+
+	return 0;
+}
+
+/* Drain up to nr values; their sum lets userspace check for loss. */
+SEC("syscall")
+int mpsc_bench_drain(struct scx_mpsc_bench_args *args)
+{
+	scx_mpsc_t *mpsc = (scx_mpsc_t *)args->mpsc;
+	struct scx_mpsc_batch batch;
+	u64 done = 0, sum = 0;
+	int got, j;
+
+	while (done < args->nr && can_loop) {
+		got = scx_mpsc_drain(mpsc, &batch);
+		if (got <= 0)
+			break;
+
+		for (j = 0; j < got && j < SCX_MPSC_BATCH; j++)
+			sum += batch.val[j];
+
+		done += got;
+	}
+
+	args->done = done;
+	args->sum = sum;
+
+	return 0;
+}
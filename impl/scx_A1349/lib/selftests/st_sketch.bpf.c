@@ -0,0 +1,306 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0
+ */
+
+#include <scx/common.bpf.h>
+
+#include <lib/sdt_task.h>
+#include <lib/sketch.h>
+
+#include "selftest.h"
+
+/*
+ * Updates from a test all land on the running CPU's instance, so the
+ * merge tests write SKETCH_NR_INST instances directly, as their CPUs
+ * would. Sketches need one instance per CPU, so they get at least that.
+ */
+#define SKETCH_NR_INST	(4)
+#define CMS_WIDTH	(256)
+#define CMS_NR_KEYS	(64ULL)
+#define TOPK_K		(4)
+
+extern const volatile u32 nr_cpu_ids;
+
+static
+u32 sketch_nr_inst(u32 min)
+{
+	return nr_cpu_ids > min ? nr_cpu_ids : min;
+}
+
+/* Add @n to every counter of @key in instance @inst. */
+static
+void sketch_cms_put(scx_cms_t *cms, u32 inst, u64 key, u64 n)
+{
+	u64 hash = scx_sketch_hash(key);
+	u32 row;
+
+	for (row = 0; row < SCX_CMS_DEPTH && can_loop; row++)
+		cms->cnt[((u64)inst * SCX_CMS_DEPTH + row) * cms->width +
+			 scx_cms_col(hash, row, cms->width)] += n;
+}
+
+static
+void sketch_topk_put(scx_topk_t *topk, u32 inst, u32 slot, u64 key, u64 count, u64 err)
+{
+	struct scx_topk_entry __arena *e = &topk->ent[(u64)inst * topk->k + slot];
+
+	e->key = key;
+	e->count = count;
+	e->err = err;
+}
+
+static
+void sketch_hll_put(scx_hll_t *hll, u32 inst, u64 key)
+{
+	u8 __arena *reg;
+	u32 idx;
+	u8 rank;
+
+	scx_hll_pos(key, &idx, &rank);
+
+	reg = &hll->reg[(u64)inst * SCX_HLL_REGS + idx];
+	if (*reg < rank)
+		*reg = rank;
+}
+
+/*
+ * Key i counted i + 1 times: no estimate falls below its count, and with
+ * 64 keys over 256 columns the overshoot stays well under the ~e/width
+ * bound on the total. Fewer instances than CPUs are refused.
+ */
+static
+int scx_selftest_sketch_cms(void)
+{
+	u64 i, est, over = 0, total = 0;
+	scx_cms_t *cms;
+	int ret;
+
+	if (scx_cms_create(CMS_WIDTH + 1, sketch_nr_inst(SKETCH_NR_INST)))
+		return 1;
+
+	if (scx_cms_create(CMS_WIDTH, nr_cpu_ids - 1))
+		return 5;
+
+	cms = scx_cms_create(CMS_WIDTH, sketch_nr_inst(SKETCH_NR_INST));
+	if (!cms)
+		return -ENOMEM;
+
+	for (i = 0; i < CMS_NR_KEYS && can_loop; i++) {
+		ret = scx_cms_add(cms, i, i + 1);
+		if (ret)
+			return ret;
+		total += i + 1;
+	}
+
+	for (i = 0; i < CMS_NR_KEYS && can_loop; i++) {
+		est = scx_cms_estimate(cms, i);
+		if (est < i + 1)
+			return 3;
+		over += est - (i + 1);
+	}
+
+	if (over * CMS_WIDTH > 3 * total * CMS_NR_KEYS)
+		return 4;
+
+	return 0;
+}
+
+/*
+ * Four heavy keys among 200 one-off keys through an 8-entry summary: the
+ * heavy ones are never evicted and their counts are upper bounds.
+ */
+static
+int scx_selftest_sketch_topk(void)
+{
+	scx_topk_t *topk;
+	u64 i, key;
+	int ret;
+
+	topk = scx_topk_create(8, sketch_nr_inst(SKETCH_NR_INST));
+	if (!topk)
+		return -ENOMEM;
+
+	if (scx_topk_add(topk, 1, 0) != -EINVAL)
+		return 1;
+
+	for (i = 0; i < 400 && can_loop; i++) {
+		/* Every other update goes to one of the heavy keys 1 .. 4. */
+		key = i % 2 ? 1 + (i / 2) % 4 : 1000 + i;
+
+		ret = scx_topk_add(topk, key, 1);
+		if (ret)
+			return ret;
+	}
+
+	for (key = 1; key <= 4 && can_loop; key++) {
+		if (scx_topk_count(topk, key) < 50)
+			return 2;
+	}
+
+	return 0;
+}
+
+/*
+ * 1000 distinct keys fill about m (1 - e^(-1000/m)) registers; adding them
+ * again changes none.
+ */
+static
+int scx_selftest_sketch_hll(void)
+{
+	u64 i, nonzero = 0, sum = 0, sum2 = 0;
+	scx_hll_t *hll;
+	u8 __arena *reg;
+	u32 cpu;
+	int ret;
+
+	hll = scx_hll_create(sketch_nr_inst(SKETCH_NR_INST));
+	if (!hll)
+		return -ENOMEM;
+
+	for (i = 0; i < 1000 && can_loop; i++) {
+		ret = scx_hll_add(hll, i);
+		if (ret)
+			return ret;
+	}
+
+	cpu = bpf_get_smp_processor_id() % hll->nr_inst;
+	reg = &hll->reg[(u64)cpu * SCX_HLL_REGS];
+
+	for (i = 0; i < SCX_HLL_REGS && can_loop; i++) {
+		nonzero += !!reg[i];
+		sum += reg[i];
+	}
+
+	if (nonzero < 550 || nonzero > 720)
+		return 1;
+
+	for (i = 0; i < 1000 && can_loop; i++)
+		scx_hll_add(hll, i);
+
+	for (i = 0; i < SCX_HLL_REGS && can_loop; i++)
+		sum2 += reg[i];
+
+	if (sum != sum2)
+		return 2;
+
+	return 0;
+}
+
+/* One key spread over every instance: the estimate is the sum. */
+static
+int scx_selftest_sketch_cms_merge(void)
+{
+	scx_cms_t *cms;
+	u32 inst;
+
+	cms = scx_cms_create(CMS_WIDTH, sketch_nr_inst(SKETCH_NR_INST));
+	if (!cms)
+		return -ENOMEM;
+
+	for (inst = 0; inst < SKETCH_NR_INST && can_loop; inst++)
+		sketch_cms_put(cms, inst, 7, inst + 1);
+
+	if (scx_cms_estimate(cms, 7) != SKETCH_NR_INST * (SKETCH_NR_INST + 1) / 2)
+		return 1;
+
+	/* Nothing else is counted, so no other key shares every counter. */
+	if (scx_cms_estimate(cms, 8))
+		return 2;
+
+	return 0;
+}
+
+/* A key's count is the sum of its entries, wherever they sit. */
+static
+int scx_selftest_sketch_topk_merge(void)
+{
+	scx_topk_t *topk;
+
+	topk = scx_topk_create(TOPK_K, sketch_nr_inst(SKETCH_NR_INST));
+	if (!topk)
+		return -ENOMEM;
+
+	sketch_topk_put(topk, 0, 2, 7, 5, 0);
+	sketch_topk_put(topk, 3, 0, 7, 3, 1);
+	sketch_topk_put(topk, 1, 3, 9, 2, 0);
+
+	if (scx_topk_count(topk, 7) != 8)
+		return 1;
+
+	if (scx_topk_count(topk, 9) != 2)
+		return 2;
+
+	if (scx_topk_count(topk, 11))
+		return 3;
+
+	return 0;
+}
+
+__weak
+int scx_selftest_sketch(void)
+{
+	SCX_SELFTEST(scx_selftest_sketch_cms);
+	SCX_SELFTEST(scx_selftest_sketch_topk);
+	SCX_SELFTEST(scx_selftest_sketch_hll);
+	SCX_SELFTEST(scx_selftest_sketch_cms_merge);
+	SCX_SELFTEST(scx_selftest_sketch_topk_merge);
+
+	return 0;
+}
+
+/*
+ * Sketches for selftest_sketch_user() in selftest.c, which merges them
+ * through the arena mapping. Each instance gets different keys:
+ *
+ *   cms     key k: k + 1 in instance k % nr and 1 in the next one
+ *   topk    the table in selftest_sketch_user(); instance 1 is not full
+ *   hll     instance i holds SCX_SKETCH_USER_HLL_KEYS keys of its own,
+ *           and the next instance repeats the first fifth of them
+ */
+SEC("syscall")
+int sketch_user_fill(struct scx_sketch_user_args *args)
+{
+	scx_topk_t *topk;
+	scx_cms_t *cms;
+	u32 inst, nr_inst;
+	scx_hll_t *hll;
+	u64 i;
+
+	/* Instances past the first SCX_SKETCH_USER_INST stay empty. */
+	nr_inst = sketch_nr_inst(SCX_SKETCH_USER_INST);
+	cms = scx_cms_create(CMS_WIDTH, nr_inst);
+	topk = scx_topk_create(SCX_SKETCH_USER_TOPK, nr_inst);
+	hll = scx_hll_create(nr_inst);
+	if (!cms || !topk || !hll)
+		return -ENOMEM;
+
+	for (i = 0; i < SCX_SKETCH_USER_CMS_KEYS && can_loop; i++) {
+		inst = i % SCX_SKETCH_USER_INST;
+		sketch_cms_put(cms, inst, i, i + 1);
+		sketch_cms_put(cms, (inst + 1) % SCX_SKETCH_USER_INST, i, 1);
+	}
+
+	sketch_topk_put(topk, 0, 0, 1, 10, 0);
+	sketch_topk_put(topk, 0, 1, 2, 8, 0);
+	sketch_topk_put(topk, 0, 2, 3, 6, 1);
+	sketch_topk_put(topk, 0, 3, 4, 4, 0);
+	sketch_topk_put(topk, 1, 0, 1, 5, 0);
+	sketch_topk_put(topk, 1, 2, 5, 3, 0);
+	sketch_topk_put(topk, 2, 0, 2, 9, 0);
+	sketch_topk_put(topk, 2, 1, 5, 7, 2);
+	sketch_topk_put(topk, 2, 2, 6, 5, 0);
+	sketch_topk_put(topk, 2, 3, 7, 2, 0);
+
+	for (i = 0; i < SCX_SKETCH_USER_INST * SCX_SKETCH_USER_HLL_KEYS && can_loop; i++) {
+		inst = i / SCX_SKETCH_USER_HLL_KEYS;
+		sketch_hll_put(hll, inst, i);
+		if (i % SCX_SKETCH_USER_HLL_KEYS < SCX_SKETCH_USER_HLL_KEYS / 5)
+			sketch_hll_put(hll, (inst + 1) % SCX_SKETCH_USER_INST, i);
+	}
+
+	args->cms = (u64)cms;
+	args->topk = (u64)topk;
+	args->hll = (u64)hll;
+
+	return 0;
+}
@@ -0,0 +1,249 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0
+ */
+
+#include <scx/common.bpf.h>
+
+#include <lib/sdt_task.h>
+#include <lib/twheel.h>
+
+#include "selftest.h"
+
+#define TW_TICK_NS	(1000ULL)
+#define TW_NR_TIMERS	(512)
+
+/* Count the timers handed back by one advance, checking their order. */
+static
+int scx_selftest_twheel_collect(scx_twheel_t *tw, u64 now_ns, u64 *nrp)
+{
+	scx_tw_timer_t *timer;
+	u64 prev = 0, nr = 0;
+
+	timer = (scx_tw_timer_t *)scx_tw_advance(tw, now_ns);
+	while (timer && can_loop) {
+		if (timer->state != SCX_TW_IDLE)
+			return 1;
+
+		/* Never early, never out of order. */
+		if (timer->expires * TW_TICK_NS > now_ns)
+			return 2;
+
+		if (timer->expires < prev)
+			return 3;
+
+		prev = timer->expires;
+		nr += 1;
+		timer = timer->link;
+	}
+
+	*nrp = nr;
+
+	return 0;
+}
+
+/*
+ * Deadlines on every level, and one past the top, each fire on the tick
+ * they round up to and not before.
+ */
+static
+int scx_selftest_twheel_levels(scx_twheel_t *tw, scx_tw_timer_t *timers)
+{
+	u64 deadlines[] = {
+		1500,				/* level 0 */
+		(64 + 3) * TW_TICK_NS,		/* level 1 */
+		(4096 + 70) * TW_TICK_NS,	/* level 2 */
+		(262144 + 5) * TW_TICK_NS,	/* level 3 */
+		(SCX_TW_MAX_TICKS + 100) * TW_TICK_NS,
+	};
+	const int nr = sizeof(deadlines) / sizeof(deadlines[0]);
+	u64 base = tw->now * TW_TICK_NS;
+	u64 expires, got;
+	int ret, i;
+
+	for (i = 0; i < nr && can_loop; i++) {
+		ret = scx_tw_arm(tw, &timers[i], base + deadlines[i]);
+		if (ret)
+			return ret;
+	}
+
+	for (i = 0; i < nr && can_loop; i++) {
+		expires = base + deadlines[i];
+		expires = (expires + TW_TICK_NS - 1) / TW_TICK_NS * TW_TICK_NS;
+
+		ret = scx_selftest_twheel_collect(tw, expires - TW_TICK_NS, &got);
+		if (ret)
+			return ret;
+		if (got)
+			return 10 + i;
+
+		ret = scx_selftest_twheel_collect(tw, expires, &got);
+		if (ret)
+			return ret;
+		if (got != 1)
+			return 20 + i;
+	}
+
+	if (tw->nr_armed)
+		return 30;
+
+	return 0;
+}
+
+static
+int scx_selftest_twheel_cancel(scx_twheel_t *tw, scx_tw_timer_t *timers)
+{
+	u64 base = tw->now * TW_TICK_NS;
+	u64 got;
+	int ret;
+
+	if (scx_tw_cancel(tw, &timers[0]) != -ENOENT)
+		return 1;
+
+	ret = scx_tw_arm(tw, &timers[0], base + 100 * TW_TICK_NS);
+	if (ret)
+		return ret;
+
+	/* Re-arming moves the timer; it fires once, at the new deadline. */
+	ret = scx_tw_arm(tw, &timers[0], base + 50 * TW_TICK_NS);
+	if (ret)
+		return ret;
+
+	ret = scx_tw_arm(tw, &timers[1], base + 70 * TW_TICK_NS);
+	if (ret)
+		return ret;
+
+	if (scx_tw_cancel(tw, &timers[1]))
+		return 2;
+
+	if (scx_tw_cancel(tw, &timers[1]) != -ENOENT)
+		return 3;
+
+	ret = scx_selftest_twheel_collect(tw, base + 50 * TW_TICK_NS, &got);
+	if (ret)
+		return ret;
+	if (got != 1)
+		return 4;
+
+	ret = scx_selftest_twheel_collect(tw, base + 200 * TW_TICK_NS, &got);
+	if (ret)
+		return ret;
+	if (got)
+		return 5;
+
+	/* Already past: fires on the next tick. */
+	ret = scx_tw_arm(tw, &timers[0], 0);
+	if (ret)
+		return ret;
+
+	ret = scx_selftest_twheel_collect(tw, base + 201 * TW_TICK_NS, &got);
+	if (ret)
+		return ret;
+	if (got != 1)
+		return 6;
+
+	return 0;
+}
+
+/* Re-arming each timer while walking the chain must not break the walk. */
+static
+int scx_selftest_twheel_rearm(scx_twheel_t *tw, scx_tw_timer_t *timers)
+{
+	u64 base = tw->now * TW_TICK_NS;
+	scx_tw_timer_t *timer;
+	u64 got = 0;
+	int ret, i;
+
+	for (i = 0; i < 3 && can_loop; i++) {
+		ret = scx_tw_arm(tw, &timers[i], base + 10 * TW_TICK_NS);
+		if (ret)
+			return ret;
+	}
+
+	timer = (scx_tw_timer_t *)scx_tw_advance(tw, base + 10 * TW_TICK_NS);
+	while (timer && can_loop) {
+		ret = scx_tw_arm(tw, timer, base + 20 * TW_TICK_NS);
+		if (ret)
+			return ret;
+
+		got += 1;
+		timer = timer->link;
+	}
+
+	if (got != 3)
+		return 1;
+
+	ret = scx_selftest_twheel_collect(tw, base + 20 * TW_TICK_NS, &got);
+	if (ret)
+		return ret;
+	if (got != 3)
+		return 2;
+
+	return 0;
+}
+
+/*
+ * Spread TW_NR_TIMERS over the first three levels and advance in uneven
+ * steps; every timer comes back exactly once, in deadline order per batch.
+ */
+static
+int scx_selftest_twheel_many(scx_twheel_t *tw, scx_tw_timer_t *timers)
+{
+	u64 base = tw->now * TW_TICK_NS;
+	u64 now, got, total = 0;
+	int ret, i;
+
+	for (i = 0; i < TW_NR_TIMERS && can_loop; i++) {
+		ret = scx_tw_arm(tw, &timers[i], base + ((i * 7919) % 20000 + 1) * TW_TICK_NS);
+		if (ret)
+			return ret;
+	}
+
+	if (tw->nr_armed != TW_NR_TIMERS)
+		return 1;
+
+	for (now = base; now <= base + 20001 * TW_TICK_NS && can_loop; now += 333 * TW_TICK_NS) {
+		ret = scx_selftest_twheel_collect(tw, now, &got);
+		if (ret)
+			return ret;
+		total += got;
+	}
+
+	ret = scx_selftest_twheel_collect(tw, base + 20001 * TW_TICK_NS, &got);
+	if (ret)
+		return ret;
+	total += got;
+
+	if (total != TW_NR_TIMERS || tw->nr_armed)
+		return 2;
+
+	return 0;
+}
+
+#define SCX_TWHEEL_SELFTEST(suffix) SCX_SELFTEST(scx_selftest_twheel_ ## suffix, tw, timers)
+
+__weak
+int scx_selftest_twheel(void)
+{
+	scx_tw_timer_t *timers;
+	scx_twheel_t *tw;
+
+	if (scx_tw_create(0, 0))
+		return -EINVAL;
+
+	tw = scx_tw_create(TW_TICK_NS, 12345 * TW_TICK_NS);
+	if (!tw) {
+		bpf_printk("Could not allocate timer wheel");
+		return -ENOMEM;
+	}
+
+	timers = (scx_tw_timer_t *)scx_static_alloc(TW_NR_TIMERS * sizeof(*timers), 1);
+	if (!timers)
+		return -ENOMEM;
+
+	SCX_TWHEEL_SELFTEST(levels);
+	SCX_TWHEEL_SELFTEST(cancel);
+	SCX_TWHEEL_SELFTEST(rearm);
+	SCX_TWHEEL_SELFTEST(many);
+
+	return 0;
+}
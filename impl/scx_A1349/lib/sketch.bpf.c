@@ -0,0 +1,260 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0
+ */
+
+#include <scx/common.bpf.h>
+
+#include <lib/sdt_task.h>
+#include <lib/sketch.h>
+
+/*
+ * Streaming sketches, see lib/sketch.h. Instances are written only by
+ * their own CPU, so updates are plain loads and stores.
+ */
+
+extern const volatile u32 nr_cpu_ids;
+
+/* One instance per CPU, or CPUs would race on a shared one. */
+static __always_inline
+bool sketch_nr_inst_ok(u32 nr_inst)
+{
+	return nr_inst && nr_inst >= nr_cpu_ids;
+}
+
+static __always_inline
+u32 sketch_inst(u32 nr_inst)
+{
+	/* Always the CPU itself; the modulo only bounds the index. */
+	return bpf_get_smp_processor_id() % nr_inst;
+}
+
+__weak
+u64 scx_cms_create_internal(u32 width, u32 nr_inst)
+{
+	scx_cms_t *cms;
+	u64 bytes;
+
+	if (!width || width > SCX_CMS_MAX_WIDTH || (width & (width - 1)))
+		return (u64)NULL;
+
+	if (!sketch_nr_inst_ok(nr_inst))
+		return (u64)NULL;
+
+	cms = (scx_cms_t *)scx_static_alloc(sizeof(*cms), 1);
+	if (!cms)
+		return (u64)NULL;
+
+	bytes = (u64)nr_inst * SCX_CMS_DEPTH * width * sizeof(*cms->cnt);
+	cms->cnt = (u64 __arena *)scx_static_alloc(bytes, 1);
+	if (!cms->cnt) {
+		/* XXX Free when migrating from the static allocator. */
+		return (u64)NULL;
+	}
+
+	cms->width = width;
+	cms->nr_inst = nr_inst;
+
+	return (u64)cms;
+}
+
+/*
+ * Conservative update: raise each of the key's counters only as far as
+ * the new estimate, min + @inc, instead of adding @inc to all of them.
+ * Counters shared with other keys grow less and estimates stay tighter.
+ */
+__weak
+int scx_cms_add(scx_cms_t __arg_arena *cms, u64 key, u64 inc)
+{
+	u64 col[SCX_CMS_DEPTH];
+	u64 hash, base, est, val;
+	u64 __arena *cnt;
+	int row;
+
+	if (unlikely(!cms))
+		return -EINVAL;
+
+	hash = scx_sketch_hash(key);
+	base = (u64)sketch_inst(cms->nr_inst) * SCX_CMS_DEPTH * cms->width;
+	cnt = cms->cnt;
+
+	est = ~0ULL;
+	for (row = 0; row < SCX_CMS_DEPTH; row++) {
+		col[row] = base + row * cms->width + scx_cms_col(hash, row, cms->width);
+
+		val = cnt[col[row]];
+		if (val < est)
+			est = val;
+	}
+
+	est += inc;
+
+	for (row = 0; row < SCX_CMS_DEPTH; row++) {
+		if (cnt[col[row]] < est)
+			cnt[col[row]] = est;
+	}
+
+	return 0;
+}
+
+__weak
+u64 scx_cms_estimate(scx_cms_t __arg_arena *cms, u64 key)
+{
+	u64 hash, col, stride, sum, est = ~0ULL;
+	u32 inst;
+	int row;
+
+	if (unlikely(!cms))
+		return 0;
+
+	hash = scx_sketch_hash(key);
+	stride = SCX_CMS_DEPTH * cms->width;
+
+	for (row = 0; row < SCX_CMS_DEPTH; row++) {
+		col = row * cms->width + scx_cms_col(hash, row, cms->width);
+
+		sum = 0;
+		for (inst = 0; inst < cms->nr_inst && can_loop; inst++)
+			sum += cms->cnt[inst * stride + col];
+
+		if (sum < est)
+			est = sum;
+	}
+
+	return est;
+}
+
+__weak
+u64 scx_topk_create_internal(u32 k, u32 nr_inst)
+{
+	scx_topk_t *topk;
+	u64 bytes;
+
+	if (!k || k > SCX_TOPK_MAX || !sketch_nr_inst_ok(nr_inst))
+		return (u64)NULL;
+
+	topk = (scx_topk_t *)scx_static_alloc(sizeof(*topk), 1);
+	if (!topk)
+		return (u64)NULL;
+
+	bytes = (u64)nr_inst * k * sizeof(*topk->ent);
+	topk->ent = (struct scx_topk_entry __arena *)scx_static_alloc(bytes, 1);
+	if (!topk->ent) {
+		/* XXX Free when migrating from the static allocator. */
+		return (u64)NULL;
+	}
+
+	topk->k = k;
+	topk->nr_inst = nr_inst;
+
+	return (u64)topk;
+}
+
+/*
+ * Space-saving: a tracked key is counted exactly; an untracked one takes
+ * over the entry with the smallest count and inherits that count as its
+ * error, so a key with more than total / k occurrences is never evicted.
+ */
+__weak
+int scx_topk_add(scx_topk_t __arg_arena *topk, u64 key, u64 inc)
+{
+	struct scx_topk_entry __arena *ent, *e;
+	u64 min = ~0ULL;
+	s32 victim = -1;
+	u32 i;
+
+	if (unlikely(!topk || !inc))
+		return -EINVAL;
+
+	ent = &topk->ent[(u64)sketch_inst(topk->nr_inst) * topk->k];
+
+	for (i = 0; i < topk->k && i < SCX_TOPK_MAX && can_loop; i++) {
+		e = &ent[i];
+
+		if (e->count && e->key == key) {
+			e->count += inc;
+			return 0;
+		}
+
+		/* A free entry beats any victim. */
+		if (e->count < min) {
+			min = e->count;
+			victim = i;
+		}
+	}
+
+	if (victim < 0)
+		return -EINVAL;
+
+	e = &ent[victim];
+	e->key = key;
+	e->err = min;
+	e->count = min + inc;
+
+	return 0;
+}
+
+__weak
+u64 scx_topk_count(scx_topk_t __arg_arena *topk, u64 key)
+{
+	struct scx_topk_entry __arena *ent;
+	u64 sum = 0;
+	u32 inst, i;
+
+	if (unlikely(!topk))
+		return 0;
+
+	for (inst = 0; inst < topk->nr_inst && can_loop; inst++) {
+		ent = &topk->ent[(u64)inst * topk->k];
+
+		for (i = 0; i < topk->k && i < SCX_TOPK_MAX && can_loop; i++) {
+			if (ent[i].count && ent[i].key == key) {
+				sum += ent[i].count;
+				break;
+			}
+		}
+	}
+
+	return sum;
+}
+
+__weak
+u64 scx_hll_create_internal(u32 nr_inst)
+{
+	scx_hll_t *hll;
+
+	if (!sketch_nr_inst_ok(nr_inst))
+		return (u64)NULL;
+
+	hll = (scx_hll_t *)scx_static_alloc(sizeof(*hll), 1);
+	if (!hll)
+		return (u64)NULL;
+
+	hll->reg = (u8 __arena *)scx_static_alloc((u64)nr_inst * SCX_HLL_REGS, 1);
+	if (!hll->reg) {
+		/* XXX Free when migrating from the static allocator. */
+		return (u64)NULL;
+	}
+
+	hll->nr_inst = nr_inst;
+
+	return (u64)hll;
+}
+
+__weak
+int scx_hll_add(scx_hll_t __arg_arena *hll, u64 key)
+{
+	u8 __arena *reg;
+	u32 idx;
+	u8 rank;
+
+	if (unlikely(!hll))
+		return -EINVAL;
+
+	scx_hll_pos(key, &idx, &rank);
+
+	reg = &hll->reg[(u64)sketch_inst(hll->nr_inst) * SCX_HLL_REGS + (idx & (SCX_HLL_REGS - 1))];
+	if (*reg < rank)
+		*reg = rank;
+
+	return 0;
+}
@@ -0,0 +1,256 @@
+/*
+ * SPDX-License-Identifier: GPL-2.0
+ */
+
+#include <scx/common.bpf.h>
+
+#include <lib/sdt_task.h>
+#include <lib/twheel.h>
+
+/*
+ * Hierarchical timer wheel, see lib/twheel.h.
+ *
+ * A timer on level l sits in slot (expires >> 6l) & 63. Level l > 0 slot s
+ * is cascaded when the tick first reaches a multiple of 64^l whose level-l
+ * index is s, which is never after the deadlines it holds; level 0 slot
+ * tick & 63 then holds exactly the timers due at that tick.
+ */
+
+static __always_inline
+u32 tw_shift(u32 level)
+{
+	return SCX_TW_SLOT_SHIFT * level;
+}
+
+/* File an unlinked @timer relative to tw->now; expires > tw->now. */
+static __always_inline
+void tw_insert(scx_twheel_t *tw, scx_tw_timer_t *timer)
+{
+	u64 when = timer->expires;
+	u64 delta = when - tw->now;
+	scx_tw_timer_t *head;
+	u32 level, slot;
+
+	/* Too far out for the top level: park at its edge, re-file later. */
+	if (delta > SCX_TW_MAX_TICKS) {
+		delta = SCX_TW_MAX_TICKS;
+		when = tw->now + SCX_TW_MAX_TICKS;
+	}
+
+	for (level = 0; level < SCX_TW_LEVELS - 1; level++) {
+		if (delta < (1ULL << tw_shift(level + 1)))
+			break;
+	}
+
+	slot = (when >> tw_shift(level)) & (SCX_TW_SLOTS - 1);
+
+	head = tw->slots[level][slot];
+	timer->prev = NULL;
+	timer->next = head;
+	if (head)
+		head->prev = timer;
+
+	tw->slots[level][slot] = timer;
+	tw->occupied[level] |= 1ULL << slot;
+
+	timer->level = level;
+	timer->slot = slot;
+}
+
+static __always_inline
+void tw_unlink(scx_twheel_t *tw, scx_tw_timer_t *timer)
+{
+	u32 level = timer->level & (SCX_TW_LEVELS - 1);
+	u32 slot = timer->slot & (SCX_TW_SLOTS - 1);
+
+	if (timer->prev)
+		timer->prev->next = timer->next;
+	else
+		tw->slots[level][slot] = timer->next;
+
+	if (timer->next)
+		timer->next->prev = timer->prev;
+
+	if (!tw->slots[level][slot])
+		tw->occupied[level] &= ~(1ULL << slot);
+
+	timer->next = NULL;
+	timer->prev = NULL;
+}
+
+/* Re-file every timer of a level > 0 slot against the current tick. */
+static __always_inline
+void tw_cascade(scx_twheel_t *tw, u32 level, u32 slot)
+{
+	scx_tw_timer_t *timer, *next;
+
+	level &= SCX_TW_LEVELS - 1;
+	slot &= SCX_TW_SLOTS - 1;
+
+	timer = tw->slots[level][slot];
+	tw->slots[level][slot] = NULL;
+	tw->occupied[level] &= ~(1ULL << slot);
+
+	while (timer && can_loop) {
+		next = timer->next;
+		tw_insert(tw, timer);
+		timer = next;
+	}
+}
+
+__weak
+u64 scx_tw_create_internal(u64 tick_ns, u64 now_ns)
+{
+	scx_twheel_t *tw;
+
+	if (!tick_ns)
+		return (u64)NULL;
+
+	/* Zeroed: every slot empty. */
+	tw = (scx_twheel_t *)scx_static_alloc(sizeof(*tw), 1);
+	if (!tw)
+		return (u64)NULL;
+
+	tw->tick_ns = tick_ns;
+	tw->now = now_ns / tick_ns;
+
+	return (u64)tw;
+}
+
+__weak
+int scx_tw_destroy(scx_twheel_t __arg_arena *tw)
+{
+	if (unlikely(!tw))
+		return -EINVAL;
+
+	return -EOPNOTSUPP;
+}
+
+__weak
+int scx_tw_arm(scx_twheel_t __arg_arena *tw, scx_tw_timer_t __arg_arena *timer, u64 expires_ns)
+{
+	u64 expires;
+	int ret;
+
+	if (unlikely(!tw || !timer))
+		return -EINVAL;
+
+	expires = (expires_ns + tw->tick_ns - 1) / tw->tick_ns;
+
+	ret = arena_spin_lock(&tw->lock);
+	if (ret)
+		return ret;
+
+	if (timer->state == SCX_TW_ARMED)
+		tw_unlink(tw, timer);
+	else
+		tw->nr_armed += 1;
+
+	if (expires <= tw->now)
+		expires = tw->now + 1;
+
+	timer->expires = expires;
+	timer->state = SCX_TW_ARMED;
+	tw_insert(tw, timer);
+
+	arena_spin_unlock(&tw->lock);
+
+	return 0;
+}
+
+__weak
+int scx_tw_cancel(scx_twheel_t __arg_arena *tw, scx_tw_timer_t __arg_arena *timer)
+{
+	int ret;
+
+	if (unlikely(!tw || !timer))
+		return -EINVAL;
+
+	ret = arena_spin_lock(&tw->lock);
+	if (ret)
+		return ret;
+
+	if (timer->state == SCX_TW_ARMED) {
+		tw_unlink(tw, timer);
+		timer->state = SCX_TW_IDLE;
+		tw->nr_armed -= 1;
+	} else {
+		ret = -ENOENT;
+	}
+
+	arena_spin_unlock(&tw->lock);
+
+	return ret;
+}
+
+__weak
+u64 scx_tw_advance(scx_twheel_t __arg_arena *tw, u64 now_ns)
+{
+	scx_tw_timer_t *head = NULL, *tail = NULL;
+	scx_tw_timer_t *timer, *next;
+	u64 target, tick, boundary;
+	u32 level, slot;
+
+	if (unlikely(!tw))
+		return (u64)NULL;
+
+	target = now_ns / tw->tick_ns;
+
+	if (arena_spin_lock(&tw->lock))
+		return (u64)NULL;
+
+	while (tw->now < target && can_loop) {
+		if (!tw->nr_armed) {
+			tw->now = target;
+			break;
+		}
+
+		/* Nothing on level 0: jump to the tick before the next cascade. */
+		if (!tw->occupied[0]) {
+			boundary = (tw->now | (SCX_TW_SLOTS - 1)) + 1;
+			if (boundary > target) {
+				tw->now = target;
+				break;
+			}
+			tw->now = boundary - 1;
+		}
+
+		tick = tw->now + 1;
+		tw->now = tick;
+
+		for (level = 1; level < SCX_TW_LEVELS; level++) {
+			if (tick & ((1ULL << tw_shift(level)) - 1))
+				break;
+
+			tw_cascade(tw, level, tick >> tw_shift(level));
+		}
+
+		slot = tick & (SCX_TW_SLOTS - 1);
+		timer = tw->slots[0][slot];
+		tw->slots[0][slot] = NULL;
+		tw->occupied[0] &= ~(1ULL << slot);
+
+		while (timer && can_loop) {
+			next = timer->next;
+
+			timer->state = SCX_TW_IDLE;
+			timer->prev = NULL;
+			timer->next = NULL;
+			timer->link = NULL;
+			tw->nr_armed -= 1;
+
+			/* Not ->next: an arm racing the caller's walk rewrites that. */
+			if (tail)
+				tail->link = timer;
+			else
+				head = timer;
+			tail = timer;
+
+			timer = next;
+		}
+	}
+
+	arena_spin_unlock(&tw->lock);
+
+	return (u64)head;
+}
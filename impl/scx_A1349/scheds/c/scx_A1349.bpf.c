@@ -12,9 +12,9 @@
  *   p_{i*} = φ_κ(θ_j) + (δ^{m_κ(l_j)} − δ^{m_κ(l_{i*})}) · \bar W_κ
  *
  * where:
- *   φ_κ(θ_i)  effective value of task i on cluster κ ∈ {P, E}
- *               φ_P = v_i − c_P · l_i
- *               φ_E = v_i − c_E · ⌈l_i · σ⌉
+ *   φ_κ(θ_i)  effective value of task i on capacity class κ ∈ [0, K)
+ *               φ_κ = v_i · η_κ/η_0 − c_κ · l_i
+ *             (K = 2 is the classic P/E pair: class 0 = P, class 1 = E)
  *   j           runner-up task in the same cluster queue
  *   m_κ(l)      contract length in quanta on cluster κ
  *   δ           discount factor (model §2.4, MDP Bellman)
@@ -27,17 +27,20 @@
  */
 
 #include <scx/common.bpf.h>
+#include <scx/task_local_data.bpf.h>
+#include <lib/fixmath.h>
+#include <lib/pmu.h>
+
+#include "scx_A1349.h"
 
 char _license[] SEC("license") = "GPL";
 
 /* ── tuneables ───────────────────────────────────────────────────────────── */
 
 #define CAPACITY_SCALE      1024u
-#define P_CAP_PCT           90u
 
-/* Default per-quantum costs c_P, c_E.  Userspace overrides via global_data. */
+/* Default per-quantum cost c_0.  Userspace sets every c_κ via global_data. */
 #define C_P_DEF             512u
-#define C_E_DEF             256u
 
 /*
  * φ value-term scale shift.  Without it, for default-nice tasks
@@ -65,9 +68,10 @@ char _license[] SEC("license") = "GPL";
 #define REPLENISH_IDLE_CAP  1000000000ULL
 
 /*
- * Cluster-conditioned slice grants (same dual-slice rationale as s4).
- *   SLICE_P  short, latency-first.
- *   SLICE_E  1.5× larger, amortises preempt overhead on slower cores.
+ * Class-conditioned slice grants (same dual-slice rationale as s4).
+ *   SLICE_P  class 0: short, latency-first.
+ *   SLICE_E  class K−1: 1.5× larger, amortises preempt overhead on slower
+ *            cores.  Classes in between interpolate linearly by index.
  *
  * Reduced from the original 20 ms to 10 ms.  Hackbench-style
  * producer-consumer pairs round-trip in ~0.2 ms; a 20 ms slice held
@@ -79,6 +83,20 @@ char _license[] SEC("license") = "GPL";
 #define AUCTION_SLICE_P     20000000ULL
 #define AUCTION_SLICE_E     ((3ULL * AUCTION_SLICE_P) / 2)
 
+/*
+ * SCHED_BATCH (and the BATCH hint): throughput work that never needs to
+ * react quickly.  Granted twice the E slice so a batch job amortises its
+ * cache refill, and priced as a contract of at least BATCH_MIN_LEN_NS so
+ * its φ sits below interactive work and its δ^m externality reflects the
+ * core time it actually ties up.
+ */
+#define AUCTION_SLICE_BATCH (2ULL * AUCTION_SLICE_E)
+#define BATCH_MIN_LEN_NS    (4ULL * AUCTION_SLICE_P)
+
+/* uapi/linux/sched.h — policy numbers are #defines, not BTF. */
+#define SCHED_BATCH         3
+#define SCHED_IDLE          5
+
 /*
  * φ encoding for the kernel DSQ (which sorts by ascending u64 vtime).
  *
@@ -91,25 +109,28 @@ char _license[] SEC("license") = "GPL";
 #define PHI_BIAS            (1ULL << 62)
 
 /*
- * Contract length cap (theory §2.4: L upper-bounds l_i).  Indexes the δ^m
- * lookup table populated by userspace.  m ∈ [0, MAX_CONTRACT_LENGTH−1].
- * 32 P-quanta ≈ 640 ms — long enough that δ^m essentially floors.
+ * Fixed-point scale for δ^m and \bar W_κ.  delta_pow(m) = round(δ^m · DELTA_SCALE).
  */
-#define MAX_CONTRACT_LENGTH 32u
+#define DELTA_SHIFT         20
+#define DELTA_SCALE         (1ULL << DELTA_SHIFT)
 
 /*
- * Fixed-point scale for δ^m and \bar W_κ.  δ^m_table[m] = round(δ^m · DELTA_SCALE).
+ * Longest contract length.  delta_pow() takes m to Q32.32 in an s64, so m
+ * stays below 2^31; δ^m has rounded to 0 long before unless 1 − δ < 1e-8.
  */
-#define DELTA_SHIFT         20
-#define DELTA_SCALE         (1ULL << DELTA_SHIFT)
+#define CONTRACT_M_MAX      0x7fffffffU
 
 /* \bar W_κ EWMA: \bar W ← ((W_REALISED_EWMA_DEN − 1) · \bar W + W_realised) / DEN. */
 #define W_BAR_EWMA_DEN      16u
 
 /* DSQ identifiers. */
-#define AUCTION_DSQ_P       1ULL
-#define AUCTION_DSQ_E       2ULL
 #define AUCTION_DSQ_STARVED 3ULL
+/*
+ * SCHED_IDLE tasks.  FIFO, consumed only after every auction queue and
+ * STARVED came up empty, and preempted by any other arrival (see
+ * kick_idle_class_runner()).
+ */
+#define AUCTION_DSQ_IDLE    4ULL
 /*
  * Per-CPU sticky DSQs (cache-warm hold for long-running preempted tasks).
  * Indexed AUCTION_DSQ_PERCPU_BASE + cpu.  A task with len_est_ns ≥ SLICE_P
@@ -120,34 +141,218 @@ char _license[] SEC("license") = "GPL";
  * and PassMark MEM/MEM_LAT regress sharply.
  */
 #define AUCTION_DSQ_PERCPU_BASE 100ULL
-#define AUCTION_NCPU_MAX        64
+
+/*
+ * One φ-ordered auction DSQ per capacity class, AUCTION_DSQ_CLASS_BASE + κ.
+ * All NR_CLASSES_MAX are created up front so a hotplug that changes K
+ * never needs a DSQ that does not exist.
+ */
+#define AUCTION_DSQ_CLASS_BASE  10ULL
+#define CLASS_MASK              (NR_CLASSES_MAX - 1)
+
+/*
+ * Cache-hotness migration cost (mig_cost_ns).  A task that has just run
+ * for a full P-slice is charged MIG_COST_NS for leaving its CPU — roughly
+ * the refill time of an L2-sized working set — scaled down for shorter
+ * runs (smaller footprint) and decaying linearly to zero over
+ * MIG_HOT_WINDOW_NS of absence, by which time whatever ran there since
+ * has evicted it.  A move is taken only when the wait it avoids exceeds
+ * this cost.  MIG_STEAL_SCAN bounds how far past a hot head the phase-2
+ * steal looks for a cold task.
+ */
+#define MIG_COST_NS          (AUCTION_SLICE_P / 4)
+#define MIG_HOT_WINDOW_NS    AUCTION_SLICE_P
+#define MIG_STEAL_SCAN       4u
+/* Sticky-hold threshold: a near-full-slice footprint, stopped just now. */
+#define MIG_STICKY_NS        (MIG_COST_NS - MIG_COST_NS / 8)
+
+/*
+ * Consolidation (packing).  While the agent publishes a pack set
+ * (auction_ctx.pack_nr, cpu_pack), wake-ups and work-conservation kicks
+ * stay inside it and the other CPUs are left to reach deep idle.  An EWMA
+ * of enqueue→run delay above PACK_DELAY_NS suspends packing for
+ * PACK_BACKOFF_NS — long enough for the agent's next utilisation sample
+ * to widen or drop the set, short enough that a transient burst does not
+ * leave the box spreading for good.
+ */
+#define PACK_DELAY_NS        (AUCTION_SLICE_P / 10)
+#define PACK_BACKOFF_NS      500000000ULL
+
+/*
+ * Fork / exec balancing.  A parent that forks SPAWN_BURST_MIN children
+ * within SPAWN_BURST_NS is running a parallel job (make -j, a test
+ * runner): its children are spread onto the LLC with the most idle CPUs
+ * instead of stacking next to the parent.  A lone fork — a shell helper,
+ * a $(cmd) — stays local where the parent's data is warm.  Burst children
+ * get a second look at exec, where their cache footprint is gone anyway.
+ */
+#define SPAWN_BURST_NS       (AUCTION_SLICE_P / 2)
+#define SPAWN_BURST_MIN      2u
+
+/*
+ * Thundering herd.  HERD_MIN or more plain (non-sync, non-fork) wake-ups
+ * issued from one CPU, each within HERD_GAP_NS of the last — a futex
+ * broadcast, an epoll fan-out — form a burst.  At onset the CPU snapshots
+ * the idle mask once; every further wake-up of the burst takes the next
+ * CPU off that snapshot instead of rescanning, so the herd spreads over
+ * distinct idle CPUs, each is kicked at most once, and once the snapshot
+ * is spent the rest queue without kicking anyone.
+ */
+#define HERD_GAP_NS          50000ULL
+#define HERD_MIN             4u
+
+/* auction_task_ctx.spawn */
+enum spawn_flags {
+	SPAWN_SPREAD    = 1u << 0,  /* burst child, until exec or sleep  */
+	SPAWN_EXEC      = 1u << 1,  /* exec'd, rebalance at next enqueue */
+};
 
 /* Maximum auction retries per dispatch tick (top, runner, …). */
 #define DISPATCH_AUCTION_TRIES 3
 
-/* ── maps ────────────────────────────────────────────────────────────────── */
+/*
+ * Central-dispatcher mode (agent -C CPU).  One CPU clears every class's
+ * auction at once over all free CPUs and fills their local DSQs with
+ * SCX_DSQ_LOCAL_ON; the rest only run what they are handed.  Rounds run
+ * when a consumer runs dry or work arrives, and every CENTRAL_PERIOD_NS
+ * as a backstop for kicks lost while the central CPU was busy.
+ */
+#define CENTRAL_PERIOD_NS      (AUCTION_SLICE_P / 20)
+
+/*
+ * Hybrid intra-class order (A1349_ORDER_HYBRID): a default-weight task's
+ * φ of 2 · 100 is worth 2 ms of deadline; a slice is the most φ can move
+ * a task either way.
+ */
+#define ORDER_PHI_NS           10000ULL
+#define ORDER_PHI_SPAN_NS      AUCTION_SLICE_P
+
+/*
+ * Losers scanned for the price under the deadline orders, where the queue
+ * position after the head says nothing about φ.
+ */
+#define ORDER_PRICE_SCAN       8
+
+/*
+ * Gang co-scheduling (scx_A1349.h).  One φ-ordered DSQ per configured gang,
+ * AUCTION_DSQ_GANG_BASE + slot.  A launch places up to GANG_MAX_LAUNCH
+ * members at once: one on the dispatching CPU, the rest on idle CPUs of the
+ * same class via SCX_DSQ_LOCAL_ON + kick.  A partial gang is held back at
+ * most GANG_WAIT_NS (a quarter P-slice) so a member blocked outside the
+ * scheduler cannot strand the others; gang_timer wakes a CPU at that
+ * deadline.
+ */
+#define AUCTION_DSQ_GANG_BASE  200ULL
+#define GANG_MAX_LAUNCH        8u
+#define GANG_WAIT_NS           (AUCTION_SLICE_P / 4)
 
 /*
- * Userspace-owned configuration (RO from BPF).  Refreshed periodically on
- * topology change.  No estimator state lives here.
+ * Application hints (scx_A1349.h, delivered through task local data).
+ *   LAT_CRIT    v_i ← w_i << HINT_VALUE_SHIFT  (φ_P of a fresh task doubles)
+ *   BATCH       v_i ← w_i >> HINT_VALUE_SHIFT
+ *   NO_PREEMPT  one HINT_SLICE_EXT_NS extension per run, taken in tick when
+ *               the slice runs dry; a 10 % stretch of the P quantum is enough
+ *               to clear a typical userspace critical section without
+ *               letting a task camp on the core.
  */
-struct auction_ctx {
-	u32 max_capacity;          /* η_P (max cpu_capacity)  */
-	u32 min_capacity;          /* η_E (min cpu_capacity)  */
-	u32 cost_p;                /* c_P                     */
-	u32 cost_e;                /* c_E                     */
-	u32 p_core_count;          /* K_P                     */
-	u32 e_core_count;          /* K_E                     */
+#define HINT_VALUE_SHIFT    1u
+#define HINT_SLICE_EXT_NS   (AUCTION_SLICE_P / 10)
+
+/*
+ * Futex lock-holder boosting.  A waiter that returns from FUTEX_WAIT (or
+ * from futex_waitv(), for the word that woke it) while at least
+ * FUTEX_BOOST_MIN_WAITERS others are still parked on the same word has,
+ * for a mutex, just become the holder they queue behind; a
+ * FUTEX_LOCK_PI waiter names the holder outright in the futex value.
+ * Either way the holder is treated as LAT_CRIT | NO_PREEMPT for
+ * FUTEX_BOOST_NS.  FUTEX_BOOST_COOLDOWN_NS after a boost ends it cannot be
+ * renewed, so a task hammering one hot lock gets at most 1/(1+4) of its
+ * time boosted and still pays the VCG price for every quantum.
+ */
+#define FUTEX_BOOST_MIN_WAITERS 2u
+#define FUTEX_BOOST_NS          AUCTION_SLICE_P
+#define FUTEX_BOOST_COOLDOWN_NS (4 * FUTEX_BOOST_NS)
+#define FUTEX_WAITERS_MAX       4096u
+/* futex_waitv() words counted per call; later ones go untraced. */
+#define FUTEX_WAITV_SCAN        8u
+
+/*
+ * Memory-bandwidth-aware placement (agent -m RATE).  lib/pmu.bpf.c counts
+ * LLC misses per task; a task whose EWMA miss rate reaches membw_thresh
+ * (misses per ms of run time) is memory-bound.  llc_mem[] sums the rates
+ * of the tasks running on each LLC right now.  Two streams behind one LLC
+ * slow each other far more than two compute-bound tasks do, so a
+ * memory-bound wake-up goes to an idle CPU on an LLC carrying at least
+ * half a stream less, and a CPU whose LLC already carries a full stream
+ * leaves memory-bound tasks alone when it steals.  The rate is resampled
+ * once MEMBW_SAMPLE_NS of run time has accrued; the PMU aggregate lags
+ * the run by at most a tick, well inside that window.
+ */
+#define MEMBW_SAMPLE_NS      1000000ULL
+
+/* uapi/linux/futex.h — not exported through BTF. */
+#define FUTEX_WAIT              0
+#define FUTEX_LOCK_PI           6
+#define FUTEX_WAIT_BITSET       9
+#define FUTEX_WAIT_REQUEUE_PI   11
+#define FUTEX_LOCK_PI2          13
+#define FUTEX_PRIVATE_FLAG      128
+#define FUTEX_CLOCK_REALTIME    256
+#define FUTEX_CMD_MASK          (~(FUTEX_PRIVATE_FLAG | FUTEX_CLOCK_REALTIME))
+#define FUTEX_TID_MASK          0x3fffffffu
+
+/* struct futex_waitv, renamed so it cannot clash with vmlinux.h. */
+struct a1349_futex_waitv {
+	u64 val;
+	u64 uaddr;
+	u32 flags;
+	u32 __reserved;
 };
 
+/* ── load-time options (rodata, set by userspace before load) ───────────── */
+
+const volatile bool tld_hints_enabled = false;
+const volatile u32  nr_gangs          = 0;
+const volatile bool futex_boost_enabled = false;
+const volatile bool pack_enabled      = false;
+const volatile bool rules_enabled     = false;
+const volatile u32  membw_thresh      = 0;
+const volatile s32  central_cpu       = -1;
+
 /*
+ * Every CPU has the same capacity (agent, before load): one class, no
+ * favoured cores.  Branches guarded by !homogeneous are dead code to the
+ * verifier and JIT, so a server fleet does not pay for hybrid support.
+ */
+const volatile bool homogeneous       = false;
+const volatile u32  order_mode        = A1349_ORDER_PHI;
+
+/*
+ * log2 δ in Q32.32 (lib/fixmath.h), from -d.  δ^m = 2^(m · log2 δ) for any
+ * contract length m, no table.  Default δ = 0.98.
+ */
+const volatile s64  delta_log2        = -125182601;
+
+/* ── maps ────────────────────────────────────────────────────────────────── */
+
+/*
+ * Userspace-owned configuration (struct auction_ctx, scx_A1349.h) lives in
+ * global_data.  Refreshed periodically on topology change.  No estimator
+ * state lives there.
+ *
  * BPF-owned runtime estimator state.  Userspace must NOT update.
- *   w_bar_p, w_bar_e — EWMA of realised φ_κ per cluster.  Approximates the
- *                      Bellman expectation \bar W_κ of theory §2.4.
+ *   w_bar[κ]               EWMA of realised φ_κ per class.  Approximates
+ *                          the Bellman expectation \bar W_κ of theory §2.4.
+ *   wait_ewma_ns           EWMA of enqueue→run delay (packing only)
+ *   pack_backoff_until_ns  packing suspended until then
+ *   nr_inf                 CPUs whose runner holds SCX_SLICE_INF
  */
 struct auction_runtime {
-	u64 w_bar_p;
-	u64 w_bar_e;
+	u64 w_bar[NR_CLASSES_MAX];
+	u64 vtime_now[NR_CLASSES_MAX];
+	u64 wait_ewma_ns;
+	u64 pack_backoff_until_ns;
+	u64 nr_inf;
 };
 
 struct {
@@ -164,30 +369,76 @@ struct {
 	__uint(value_size, sizeof(struct auction_runtime));
 } runtime_data SEC(".maps");
 
-/*
- * Precomputed discount table.  delta_table[m] = round(δ^m · DELTA_SCALE).
- * Populated by userspace before attach; BPF treats it as RO.
- */
 struct {
 	__uint(type, BPF_MAP_TYPE_ARRAY);
-	__uint(max_entries, MAX_CONTRACT_LENGTH);
+	__uint(max_entries, 512);
 	__uint(key_size, sizeof(u32));
-	__uint(value_size, sizeof(u64));
-} delta_table SEC(".maps");
+	__uint(value_size, sizeof(u32));
+} cpu_capacity SEC(".maps");
 
+/* Capacity class of each CPU (0 = strongest).  Populated by userspace. */
 struct {
 	__uint(type, BPF_MAP_TYPE_ARRAY);
 	__uint(max_entries, 512);
 	__uint(key_size, sizeof(u32));
-	__uint(value_size, sizeof(u32));
-} cpu_capacity SEC(".maps");
+	__uint(value_size, sizeof(u8));
+} cpu_class SEC(".maps");
 
+/* 1 while the CPU runs a SCHED_IDLE task.  BPF-owned. */
 struct {
 	__uint(type, BPF_MAP_TYPE_ARRAY);
-	__uint(max_entries, 512);
+	__uint(max_entries, AUCTION_NCPU_MAX);
+	__uint(key_size, sizeof(u32));
+	__uint(value_size, sizeof(u8));
+} cpu_runs_idle_class SEC(".maps");
+
+/* LLC index of each CPU (< LLC_MAX).  Populated by userspace. */
+struct {
+	__uint(type, BPF_MAP_TYPE_ARRAY);
+	__uint(max_entries, AUCTION_NCPU_MAX);
+	__uint(key_size, sizeof(u32));
+	__uint(value_size, sizeof(u8));
+} cpu_llc SEC(".maps");
+
+/* Σ membw rate of the tasks running on each LLC.  BPF-owned. */
+struct {
+	__uint(type, BPF_MAP_TYPE_ARRAY);
+	__uint(max_entries, LLC_MAX);
+	__type(key, u32);
+	__type(value, u64);
+} llc_mem SEC(".maps");
+
+/* 1 for CPUs in the consolidation pack set.  Populated by userspace. */
+struct {
+	__uint(type, BPF_MAP_TYPE_ARRAY);
+	__uint(max_entries, AUCTION_NCPU_MAX);
 	__uint(key_size, sizeof(u32));
 	__uint(value_size, sizeof(u8));
-} cpu_is_p SEC(".maps");
+} cpu_pack SEC(".maps");
+
+/*
+ * Preferred-core state, BPF-owned.
+ *   phi       φ of the task running on the CPU (valid while busy)
+ *   busy      1 while the CPU runs an auction task (not SCHED_IDLE)
+ *   pull_to   faster CPU + 1 the running task should move up to at its
+ *             next re-enqueue; 0 ⇒ none
+ *   inf       1 while the running task holds SCX_SLICE_INF
+ *   pid       pid of the task last started here; pull_to is for it alone
+ */
+struct cpu_run {
+	s64 phi;
+	u32 busy;
+	u32 pull_to;
+	u32 inf;
+	u32 pid;
+};
+
+struct {
+	__uint(type, BPF_MAP_TYPE_ARRAY);
+	__uint(max_entries, AUCTION_NCPU_MAX);
+	__type(key, u32);
+	__type(value, struct cpu_run);
+} cpu_run SEC(".maps");
 
 /*
  * Per-task auction state.
@@ -195,27 +446,70 @@ struct {
  *   budget         remaining B_i^t (theory §2.4)
  *   budget_max     B_i (w_i · BUDGET_MUL)
  *   last_stop_ns   bpf_ktime at last stopping; basis for idle-time replenish
+ *   last_ran_ns    bpf_ktime at the end of the last run (sleep or preempt);
+ *                  age basis for the cache-hotness estimate
+ *   enq_ns         bpf_ktime the task last became runnable (packing only)
+ *   rule           operator rule matched at the last wake-up; .cls =
+ *                  A1349_RULE_CLASS_NONE when nothing matched
  *   len_est_ns     EWMA of consumed_ns per activation — proxy for l_i
  *   phi_enq        φ_κ chosen at enqueue, retained for the stopping-time
  *                  \bar W update
  *   m_enq          contract length m_κ(l_i) used in the VCG payment
- *   on_p_type      1 if last enqueued onto AUCTION_DSQ_P, 0 otherwise
- *   long_slice     1 if granted AUCTION_SLICE_E at insert
+ *   cls            capacity class κ of the last enqueue
+ *   slice_ns       slice granted at insert
  *   weight_cached  stale-safe copy of p->scx.weight
  *   wake_prev_cpu  prev_cpu captured in select_cpu (cache-warm hint)
+ *   hints          A1349_HINT_* word sampled at the last enqueue
+ *   slice_ext_ns   slice extension granted during the current run
+ *   futex_uaddr    futex word the task is parked on (0 ⇒ not waiting),
+ *                  or its futex_waitv() vector when futex_nr is set
+ *   futex_nr       words of that vector counted in futex_waiters
+ *   boost_until_ns lock-holder boost deadline; renewable only after
+ *                  FUTEX_BOOST_COOLDOWN_NS past it
+ *   spawn_win_ns   start of the current fork-burst window (as a parent)
+ *   spawn_nr       forks inside that window, saturating
+ *   spawn          SPAWN_* (as a child)
+ *   mem_rate       EWMA of LLC misses per ms of run time (membw only)
+ *   mem_run_ns     run time since the last miss sample
+ *   mem_charged    rate added to llc_mem[mem_llc] while running; 0 ⇒ none
+ *   inf_since_ns   start of a run granted SCX_SLICE_INF; 0 ⇒ finite slice
+ *   vtime          virtual runtime v_i against its class's V(t) (deadline
+ *                  ordering only)
+ *   starved_since_ns  entry into STARVED; 0 ⇒ not there
+ *   starved_ns     total time spent waiting in STARVED
+ *   sticky         queued on its CPU's sticky DSQ
  */
 struct auction_task_ctx {
 	u64 budget;
 	u64 budget_max;
 	u64 last_stop_ns;
+	u64 last_ran_ns;
+	u64 enq_ns;
 	u64 len_est_ns;
+	u64 futex_uaddr;
+	u64 boost_until_ns;
+	u64 spawn_win_ns;
+	u64 mem_run_ns;
+	u64 inf_since_ns;
+	u64 vtime;
+	u64 starved_since_ns;
+	u64 starved_ns;
 	s64 phi_enq;
 	u32 m_enq;
 	u32 weight_cached;
 	s32 wake_prev_cpu;
-	u8  on_p_type;
-	u8  long_slice;
-	u8  _pad[2];
+	u32 hints;
+	u32 slice_ext_ns;
+	u32 slice_ns;
+	u32 mem_rate;
+	u32 mem_charged;
+	struct a1349_rule rule;
+	u8  cls;
+	u8  spawn;
+	u8  spawn_nr;
+	u8  mem_llc;
+	u8  sticky;
+	u8  futex_nr;
 };
 
 struct {
@@ -225,6 +519,124 @@ struct {
 	__type(value, struct auction_task_ctx);
 } task_ctx_map SEC(".maps");
 
+/* Gang membership, tgid → struct gang_cfg.  Populated by userspace. */
+struct {
+	__uint(type, BPF_MAP_TYPE_HASH);
+	__uint(max_entries, GANG_MAX);
+	__type(key, u32);
+	__type(value, struct gang_cfg);
+} gang_map SEC(".maps");
+
+struct {
+	__uint(type, BPF_MAP_TYPE_ARRAY);
+	__uint(max_entries, GANG_MAX);
+	__type(key, u32);
+	__type(value, struct gang_runtime);
+} gang_runtime SEC(".maps");
+
+/*
+ * Per-CPU wake-up burst state (see HERD_GAP_NS), BPF-owned.
+ *   last_ns   previous plain wake-up issued from this CPU
+ *   avail     burst only: idle CPUs from the onset snapshot not yet
+ *             handed out, bit per CPU
+ *   nr        wake-ups in the current run of close ones, saturating;
+ *             HERD_MIN + 1 once the snapshot is taken
+ */
+struct herd {
+	u64 last_ns;
+	u64 avail;
+	u32 nr;
+	u32 _pad;
+};
+
+struct {
+	__uint(type, BPF_MAP_TYPE_PERCPU_ARRAY);
+	__uint(max_entries, 1);
+	__type(key, u32);
+	__type(value, struct herd);
+} herd_state SEC(".maps");
+
+/*
+ * Per-gang wait deadline: wakes a CPU of the gang's class to launch a
+ * partial gang once GANG_WAIT_NS has passed.  Initialised by auction_init.
+ */
+struct gang_timer {
+	struct bpf_timer timer;
+	u32 cls;
+};
+
+struct {
+	__uint(type, BPF_MAP_TYPE_ARRAY);
+	__uint(max_entries, GANG_MAX);
+	__type(key, u32);
+	__type(value, struct gang_timer);
+} gang_timer SEC(".maps");
+
+/* Central-mode round backstop, armed by auction_init. */
+struct central_timer {
+	struct bpf_timer timer;
+};
+
+struct {
+	__uint(type, BPF_MAP_TYPE_ARRAY);
+	__uint(max_entries, 1);
+	__type(key, u32);
+	__type(value, struct central_timer);
+} central_timer SEC(".maps");
+
+/* Stat slots, enum a1349_stat_idx. */
+struct {
+	__uint(type, BPF_MAP_TYPE_PERCPU_ARRAY);
+	__uint(key_size, sizeof(u32));
+	__uint(value_size, sizeof(u64));
+	__uint(max_entries, STAT_NR);
+} stats SEC(".maps");
+
+/*
+ * Parked waiters per futex word.  LRU: a task killed mid-wait never runs
+ * its sys_exit and would otherwise pin the entry forever.
+ */
+struct futex_key {
+	u64 uaddr;
+	u32 tgid;
+	u32 _pad;
+};
+
+struct {
+	__uint(type, BPF_MAP_TYPE_LRU_HASH);
+	__uint(max_entries, FUTEX_WAITERS_MAX);
+	__type(key, struct futex_key);
+	__type(value, u32);
+} futex_waiters SEC(".maps");
+
+/* Operator placement rules, struct a1349_rule.  Populated by userspace. */
+struct {
+	__uint(type, BPF_MAP_TYPE_HASH);
+	__uint(max_entries, A1349_RULE_MAX);
+	__type(key, u64);
+	__type(value, struct a1349_rule);
+} rule_cgroup SEC(".maps");
+
+struct {
+	__uint(type, BPF_MAP_TYPE_LPM_TRIE);
+	__uint(map_flags, BPF_F_NO_PREALLOC);
+	__uint(max_entries, A1349_RULE_MAX);
+	__type(key, struct a1349_comm_key);
+	__type(value, struct a1349_rule);
+} rule_comm SEC(".maps");
+
+struct {
+	__uint(type, BPF_MAP_TYPE_HASH);
+	__uint(max_entries, A1349_RULE_MAX);
+	__type(key, u32);
+	__type(value, struct a1349_rule);
+} rule_uid SEC(".maps");
+
+/* TLD key cache (tld_key_map value type, see task_local_data.bpf.h). */
+struct tld_keys {
+	tld_key_t hint;
+};
+
 /* ── helpers ─────────────────────────────────────────────────────────────── */
 
 static __always_inline struct auction_ctx *
@@ -248,147 +660,946 @@ get_task_ctx(struct task_struct *p, bool create)
 				    create ? BPF_LOCAL_STORAGE_GET_F_CREATE : 0);
 }
 
-static __always_inline bool
-cpu_is_p_type(u32 cpu)
+/* K, clamped so a zeroed or corrupt global_data still yields one class. */
+static __always_inline u32
+nr_classes_of(const struct auction_ctx *gdata)
+{
+	u32 nr = gdata->nr_classes;
+
+	if (homogeneous || !nr)
+		return 1;
+	return nr < NR_CLASSES_MAX ? nr : NR_CLASSES_MAX;
+}
+
+/* Slice for class κ: SLICE_P at κ = 0 up to SLICE_E at κ = K − 1. */
+static __always_inline u64
+class_slice(u32 cls, u32 nr_classes)
 {
-	u8 *flag = bpf_map_lookup_elem(&cpu_is_p, &cpu);
-	return flag && *flag;
+	if (nr_classes < 2)
+		return AUCTION_SLICE_P;
+	if (cls >= nr_classes)
+		cls = nr_classes - 1;
+	return AUCTION_SLICE_P +
+	       (AUCTION_SLICE_E - AUCTION_SLICE_P) * cls / (nr_classes - 1);
+}
+
+static void
+stat_inc(u32 idx)
+{
+	u64 *cnt_p = bpf_map_lookup_elem(&stats, &idx);
+	if (cnt_p)
+		(*cnt_p)++;
+}
+
+/* Close a STARVED stay (dump accounting): it ends at running or re-enqueue. */
+static __always_inline void
+starved_fold(struct auction_task_ctx *tctx, u64 now)
+{
+	if (!tctx->starved_since_ns)
+		return;
+	if (now > tctx->starved_since_ns)
+		tctx->starved_ns += now - tctx->starved_since_ns;
+	tctx->starved_since_ns = 0;
 }
 
 /*
- * Encode signed φ into an unsigned DSQ vtime key such that a larger φ
- * yields a smaller key (kernel DSQ sorts ascending → highest φ served first).
+ * Cost of moving the task off the CPU it last ran on, in ns of lost
+ * progress (see MIG_COST_NS).  len_est_ns stands in for the cache
+ * footprint: a task that runs a whole slice has touched far more than one
+ * that runs for microseconds.
  */
 static __always_inline u64
-encode_phi(s64 phi)
+mig_cost_ns(const struct auction_task_ctx *tctx, u64 now)
 {
-	if (phi >= 0)
-		return PHI_BIAS - (u64)phi;
-	return PHI_BIAS + (u64)(-phi);
+	u64 age, foot;
+
+	if (!tctx->last_ran_ns)
+		return 0;
+	age = now > tctx->last_ran_ns ? now - tctx->last_ran_ns : 0;
+	if (age >= MIG_HOT_WINDOW_NS)
+		return 0;
+
+	foot = tctx->len_est_ns < AUCTION_SLICE_P ? tctx->len_est_ns
+						  : AUCTION_SLICE_P;
+	return MIG_COST_NS * foot / AUCTION_SLICE_P *
+	       (MIG_HOT_WINDOW_NS - age) / MIG_HOT_WINDOW_NS;
+}
+
+static __always_inline u32
+cpu_class_of(u32 cpu)
+{
+	u8 *cls;
+
+	if (homogeneous)
+		return 0;
+	cls = bpf_map_lookup_elem(&cpu_class, &cpu);
+	return cls ? (*cls & CLASS_MASK) : 0;
+}
+
+static __always_inline u32
+cpu_cap_of(u32 cpu)
+{
+	u32 *cap = bpf_map_lookup_elem(&cpu_capacity, &cpu);
+	return cap ? *cap : CAPACITY_SCALE;
 }
 
 /*
- * Compute φ_P and φ_E for a task (eq:phi, rescaled to weight-units).
- *
- *   l_q  = len_ns / SLICE_P            (length in P-quanta, continuous)
- *   φ_P = w           − c_P · l_q
- *   φ_E = w · η_E/η_P − c_E · l_q
- *
- * Earlier (weight × ns) formulation produced |φ| ≈ 1e10, which dominated
- * the budget scale and pushed VCG payments to either clamp at zero (free)
- * or drain the bucket in a single dispatch.  Dividing by SLICE_P
- * normalises φ to the same magnitude as the weight (≈ 1..50000), making
- * the budget and replenishment constants from s4 directly reusable.
- *
- * Integer-only: cost_κ · len_ns is rounded by adding SLICE_P/2 before the
- * division to avoid systematic truncation bias on sub-quantum tasks.
+ * Whether a wake-up should stay on its idle prev_cpu rather than look for
+ * a faster core: the best a move can gain is the expected run sped up from
+ * prev_cpu's capacity to class 0's, len · (cap_0 − cap_prev)/cap_0, and it
+ * pays mig_cost_ns() for the cache left behind.  A prev_cpu already at
+ * class-0 capacity gains nothing by moving, warm or not.
  */
-static __always_inline void
-compute_phi(u32 weight, u64 len_ns,
-	    u32 max_cap, u32 min_cap,
-	    u32 cost_p, u32 cost_e,
-	    s64 *phi_p_out, s64 *phi_e_out)
-{
-	u32 mx = max_cap ? max_cap : CAPACITY_SCALE;
-	u32 mc = min_cap ? min_cap : mx;
-	u64 w_e = (u64)weight * (u64)mc / (u64)mx;
-	/*
-	 * Integer-quantum discretisation of the cost term.  Sub-quantum
-	 * tasks collapse to l_q=0 (cost=0), so same-weight short tasks
-	 * share a single φ key and the DSQ falls back to insertion order
-	 * within that bucket — restores hackbench's natural FIFO producer-
-	 * consumer pairing that the original ns-precision cost destroyed.
-	 * Long-running tasks (l_q ≥ 1) still rank by integer quanta.
-	 */
-	u64 l_q_int = (len_ns + AUCTION_SLICE_P / 2) / AUCTION_SLICE_P;
-	u64 cost_p_q = (u64)cost_p * l_q_int;
-	u64 cost_e_q = (u64)cost_e * l_q_int;
+static __always_inline bool
+mig_stay_prev(const struct auction_ctx *gdata,
+	      const struct auction_task_ctx *tctx, s32 prev_cpu, u64 now)
+{
+	u64 top = gdata->class_capacity[0] ?: CAPACITY_SCALE;
+	u64 cap = cpu_cap_of((u32)prev_cpu);
+	u64 len = tctx->len_est_ns ?: AUCTION_SLICE_P;
 
-	/*
-	 * v_i scaled by PHI_VALUE_SHIFT to break the φ=0 degeneracy that
-	 * collapses default-nice tasks to FIFO inside the DSQ.  Cost stays
-	 * at native scale: ranking now uses widened value with cost as a
-	 * smaller corrective term, which preserves the sign of φ on
-	 * long-running tasks (φ < 0 when the contract dominates the value).
-	 */
-	*phi_p_out = ((s64)weight << PHI_VALUE_SHIFT) - (s64)cost_p_q;
-	*phi_e_out = ((s64)w_e    << PHI_VALUE_SHIFT) - (s64)cost_e_q;
+	if (cap >= top)
+		return true;
+	return mig_cost_ns(tctx, now) >= len * (top - cap) / top;
 }
 
 /*
- * Contract length in quanta:  m_P(l) = l,  m_E(l) = ⌈l · σ⌉.
- * Saturates at MAX_CONTRACT_LENGTH − 1 (lookup-table bound).
- *
- *   l (in P-quanta) = ⌈len_ns / SLICE_P⌉,  l ≥ 1.
- *   m_E(l) = ⌈l · max_cap / min_cap⌉.
+ * Expected wait for a task queued on class κ's DSQ: the backlog drained by
+ * n_κ CPUs one slice at a time.  A class with no CPUs never drains.
  */
-static __always_inline u32
-contract_length(u64 len_ns, bool on_p, u32 max_cap, u32 min_cap)
+static __always_inline u64
+class_wait_ns(const struct auction_ctx *gdata, u32 cls, u32 nr)
 {
-	u64 mx = max_cap ? max_cap : CAPACITY_SCALE;
-	u64 mc = min_cap ? min_cap : mx;
-	u64 l_p;
-	u64 m;
+	u32 n = gdata->class_cpus[cls & CLASS_MASK];
 
-	l_p = (len_ns + AUCTION_SLICE_P - 1) / AUCTION_SLICE_P;
-	if (l_p < 1)
-		l_p = 1;
+	if (!n)
+		return (u64)-1;
+	return scx_bpf_dsq_nr_queued(AUCTION_DSQ_CLASS_BASE + cls) *
+	       class_slice(cls, nr) / n;
+}
 
-	if (on_p)
-		m = l_p;
-	else
-		m = (l_p * mx + mc - 1) / mc;
+static __always_inline bool
+pack_active(const struct auction_ctx *gdata, u64 now)
+{
+	struct auction_runtime *rt;
 
-	if (m >= MAX_CONTRACT_LENGTH)
-		m = MAX_CONTRACT_LENGTH - 1;
-	return (u32)m;
+	if (!pack_enabled || !gdata->pack_nr)
+		return false;
+	rt = get_rt();
+	return rt && now >= rt->pack_backoff_until_ns;
 }
 
-static __always_inline u64
-delta_pow(u32 m)
+static __always_inline bool
+cpu_in_pack(u32 cpu)
 {
-	u32 key = (m < MAX_CONTRACT_LENGTH) ? m : (MAX_CONTRACT_LENGTH - 1);
-	u64 *v = bpf_map_lookup_elem(&delta_table, &key);
-	/* Fallback δ^? ≈ 1 if userspace forgot to populate. */
-	return v ? *v : DELTA_SCALE;
+	u8 *in = bpf_map_lookup_elem(&cpu_pack, &cpu);
+	return in && *in;
 }
 
 /*
- * Replenish budget by idle time × weight.  Token bucket capped at budget_max.
- * Mirrors theory §2.4 "Аллокация задаче … допустима, если p_i ≤ B_i^t":
- * sleep accrues credit; the budget cap prevents permanent stockpiling.
- *
- * Consumes the credited interval by advancing last_stop_ns to `now` on a
- * successful refill.  This lets the caller invoke budget_replenish() on
- * every enqueue (including preempt re-enqueues that lack SCX_ENQ_WAKEUP)
- * without double-crediting: a tight preempt-re-enqueue arrives with
- * idle_ns ≈ 0 and is a no-op, while a genuine sleep period is fully
- * credited exactly once and then consumed.
+ * Pack-set CPU for `p`: an idle one (claimed) if `want_idle`, else any in
+ * its affinity to queue behind.  prev_cpu first for cache warmth.  Only
+ * classes below `lim` count (the uclamp.min floor).  -1 when the affinity
+ * misses the pack set entirely — such a task is placed as if packing were
+ * off.
  */
-static __always_inline void
-budget_replenish(struct auction_task_ctx *tctx, u64 now)
+static __always_inline s32
+pack_pick(struct task_struct *p, s32 prev_cpu, bool want_idle, u32 lim)
 {
-	u64 idle_ns, add;
+	s32 c;
 
-	if (!tctx->last_stop_ns || now <= tctx->last_stop_ns)
-		return;
+	if (prev_cpu >= 0 && cpu_in_pack((u32)prev_cpu) &&
+	    cpu_class_of((u32)prev_cpu) < lim &&
+	    bpf_cpumask_test_cpu(prev_cpu, p->cpus_ptr) &&
+	    (!want_idle || scx_bpf_test_and_clear_cpu_idle(prev_cpu)))
+		return prev_cpu;
 
-	idle_ns = now - tctx->last_stop_ns;
-	if (idle_ns > REPLENISH_IDLE_CAP)
-		idle_ns = REPLENISH_IDLE_CAP;
+	bpf_for(c, 0, AUCTION_NCPU_MAX) {
+		if (!cpu_in_pack((u32)c) || cpu_class_of((u32)c) >= lim ||
+		    !bpf_cpumask_test_cpu(c, p->cpus_ptr))
+			continue;
+		if (!want_idle || scx_bpf_test_and_clear_cpu_idle(c))
+			return c;
+	}
+	return -1;
+}
 
-	add = idle_ns * (u64)(tctx->weight_cached ?: 1) / REPLENISH_DIV;
-	tctx->budget += add;
-	if (tctx->budget > tctx->budget_max)
-		tctx->budget = tctx->budget_max;
+/*
+ * Fastest idle class-0 CPU `p` may run on, claimed.  prev_cpu wins ties so
+ * cache warmth still counts between equally favoured cores.  The idle mask
+ * is only a snapshot: if another CPU claims the winner first, report none
+ * and let the caller fall back to the unranked scan.
+ */
+static __always_inline s32
+prefcore_pick_idle(struct task_struct *p, s32 prev_cpu)
+{
+	const struct cpumask *idle = scx_bpf_get_idle_cpumask();
+	u32 best_cap = 0;
+	s32 best = -1, c;
 
-	tctx->last_stop_ns = now;
+	bpf_for(c, 0, AUCTION_NCPU_MAX) {
+		u32 cap;
+
+		if (cpu_class_of((u32)c))
+			continue;
+		if (!bpf_cpumask_test_cpu(c, p->cpus_ptr) ||
+		    !bpf_cpumask_test_cpu(c, idle))
+			continue;
+		cap = cpu_cap_of((u32)c);
+		if (cap > best_cap || (cap == best_cap && c == prev_cpu)) {
+			best_cap = cap;
+			best     = c;
+		}
+	}
+	scx_bpf_put_idle_cpumask(idle);
+
+	if (best >= 0 && scx_bpf_test_and_clear_cpu_idle(best))
+		return best;
+	return -1;
 }
 
 /*
- * VCG payment in the single-slot regime (eq:single-unit-payment):
- *
- *   p = φ_j  +  (δ^{m_j} − δ^{m_i}) · \bar W_κ / DELTA_SCALE
+ * Migrate-up request, issued by a class-0 CPU about to go idle.  Among the
+ * slower class-0 CPUs, the one running the highest-φ task is asked to
+ * preempt; its re-enqueue honours pull_to (prefcore_take_pull) and lands
+ * the task here.  The φ ranking means the auction's winner, not whichever
+ * task happened to wake first, ends up on the favoured core.
+ */
+static __always_inline void
+prefcore_pull(s32 cpu)
+{
+	struct cpu_run *cr, *victim_cr = NULL;
+	u32 my_cap = cpu_cap_of((u32)cpu);
+	s64 best_phi = 0;
+	s32 victim = -1, c;
+
+	bpf_for(c, 0, AUCTION_NCPU_MAX) {
+		u32 key = (u32)c;
+
+		if (c == cpu || cpu_class_of(key))
+			continue;
+		if (cpu_cap_of(key) >= my_cap)
+			continue;
+		cr = bpf_map_lookup_elem(&cpu_run, &key);
+		if (!cr || !cr->busy || cr->pull_to)
+			continue;
+		if (victim < 0 || cr->phi > best_phi) {
+			victim    = c;
+			victim_cr = cr;
+			best_phi  = cr->phi;
+		}
+	}
+
+	if (victim < 0 || !victim_cr)
+		return;
+	victim_cr->pull_to = (u32)cpu + 1;
+	scx_bpf_kick_cpu(victim, SCX_KICK_PREEMPT);
+	stat_inc(STAT_PREFCORE_KICK);
+}
+
+/*
+ * Re-enqueue side of a migrate-up.  The target must still be idle and in
+ * p's affinity; otherwise the request lapses and the task takes the normal
+ * path.
+ */
+static __always_inline bool
+prefcore_take_pull(struct task_struct *p, u64 slice_ns, u64 enq_flags)
+{
+	u32 cur = bpf_get_smp_processor_id();
+	struct cpu_run *cr = bpf_map_lookup_elem(&cpu_run, &cur);
+	s32 dst;
+
+	/* Only the preempted runner's own re-enqueue may take the request. */
+	if (!cr || !cr->pull_to || cr->pid != (u32)p->pid)
+		return false;
+	dst = (s32)cr->pull_to - 1;
+	cr->pull_to = 0;
+
+	if (!bpf_cpumask_test_cpu(dst, p->cpus_ptr) ||
+	    !scx_bpf_test_and_clear_cpu_idle(dst))
+		return false;
+
+	scx_bpf_dsq_insert(p, SCX_DSQ_LOCAL_ON | (u64)dst, slice_ns, enq_flags);
+	scx_bpf_kick_cpu(dst, SCX_KICK_IDLE);
+	stat_inc(STAT_PREFCORE_PULL);
+	return true;
+}
+
+static __always_inline u32
+cpu_llc_of(u32 cpu)
+{
+	u8 *llc = bpf_map_lookup_elem(&cpu_llc, &cpu);
+	return llc ? (*llc & (LLC_MAX - 1)) : 0;
+}
+
+/*
+ * Count one fork by the current task; true once it is inside a burst.
+ */
+static __always_inline bool
+spawn_note_fork(struct auction_task_ctx *parent, u64 now)
+{
+	if (now - parent->spawn_win_ns > SPAWN_BURST_NS) {
+		parent->spawn_win_ns = now;
+		parent->spawn_nr     = 0;
+	}
+	if (parent->spawn_nr < 0xff)
+		parent->spawn_nr++;
+	return parent->spawn_nr >= SPAWN_BURST_MIN;
+}
+
+/*
+ * Idle CPU for a spawned task on the least-loaded LLC, claimed.  Load is
+ * the idle CPUs of classes [lo, hi) in p's affinity; ties go to prev_cpu's
+ * LLC (the parent's group), and within the LLC the strongest class wins.
+ * With `move_only` the pick lapses unless it leaves prev_cpu's LLC for a
+ * strictly idler one.  -1 when nothing suitable is idle.
+ */
+static __always_inline s32
+spread_pick(struct task_struct *p, s32 prev_cpu, u32 lo, u32 hi,
+	    bool move_only)
+{
+	const struct cpumask *idle = scx_bpf_get_idle_cpumask();
+	u32 nidle[LLC_MAX] = {};
+	u32 home = prev_cpu >= 0 ? cpu_llc_of((u32)prev_cpu) : 0;
+	u32 best = home, best_cls = NR_CLASSES_MAX, l;
+	s32 c, pick = -1;
+
+	bpf_for(c, 0, AUCTION_NCPU_MAX) {
+		u32 k = cpu_class_of((u32)c);
+
+		if (k < lo || k >= hi || !bpf_cpumask_test_cpu(c, idle) ||
+		    !bpf_cpumask_test_cpu(c, p->cpus_ptr))
+			continue;
+		nidle[cpu_llc_of((u32)c)]++;
+	}
+	bpf_for(l, 0, LLC_MAX) {
+		if (nidle[l] > nidle[best])
+			best = l;
+	}
+	if (!nidle[best] || (move_only && best == home))
+		goto out;
+
+	bpf_for(c, 0, AUCTION_NCPU_MAX) {
+		u32 k = cpu_class_of((u32)c);
+
+		if (k < lo || k >= hi || k >= best_cls ||
+		    cpu_llc_of((u32)c) != best ||
+		    !bpf_cpumask_test_cpu(c, idle) ||
+		    !bpf_cpumask_test_cpu(c, p->cpus_ptr))
+			continue;
+		pick     = c;
+		best_cls = k;
+	}
+out:
+	scx_bpf_put_idle_cpumask(idle);
+	if (pick >= 0 && !scx_bpf_test_and_clear_cpu_idle(pick))
+		pick = -1;
+	return pick;
+}
+
+static __always_inline bool
+membw_bound(const struct auction_task_ctx *tctx)
+{
+	return membw_thresh && tctx->mem_rate >= membw_thresh;
+}
+
+static __always_inline u64
+llc_mem_of(u32 llc)
+{
+	u64 *v = bpf_map_lookup_elem(&llc_mem, &llc);
+	return v ? *v : 0;
+}
+
+/*
+ * Idle CPU for a memory-bound task on the LLC with the least memory
+ * traffic, claimed; classes below `lim` only.  -1 unless that LLC carries
+ * at least half a stream (membw_thresh / 2) less than prev_cpu's.
+ */
+static __always_inline s32
+membw_pick(struct task_struct *p, s32 prev_cpu, u32 lim)
+{
+	const struct cpumask *idle = scx_bpf_get_idle_cpumask();
+	u32 home = prev_cpu >= 0 ? cpu_llc_of((u32)prev_cpu) : 0;
+	u64 home_mem = llc_mem_of(home), best_mem = home_mem;
+	s32 c, pick = -1;
+
+	bpf_for(c, 0, AUCTION_NCPU_MAX) {
+		u32 l = cpu_llc_of((u32)c);
+		u64 m;
+
+		if (l == home || cpu_class_of((u32)c) >= lim ||
+		    !bpf_cpumask_test_cpu(c, idle) ||
+		    !bpf_cpumask_test_cpu(c, p->cpus_ptr))
+			continue;
+		m = llc_mem_of(l);
+		if (m < best_mem) {
+			best_mem = m;
+			pick     = c;
+		}
+	}
+	scx_bpf_put_idle_cpumask(idle);
+
+	if (pick < 0 || best_mem + membw_thresh / 2 > home_mem ||
+	    !scx_bpf_test_and_clear_cpu_idle(pick))
+		return -1;
+	return pick;
+}
+
+/*
+ * Count a plain wake-up issued from this CPU; the burst state once it is
+ * part of a herd, else NULL.  The onset wake-up takes the idle snapshot.
+ */
+static __always_inline struct herd *
+herd_note(u64 now)
+{
+	u32 zero = 0;
+	struct herd *h = bpf_map_lookup_elem(&herd_state, &zero);
+	const struct cpumask *idle;
+	s32 c;
+
+	if (!h)
+		return NULL;
+	if (now - h->last_ns > HERD_GAP_NS) {
+		h->nr    = 0;
+		h->avail = 0;
+	}
+	h->last_ns = now;
+	if (h->nr < HERD_MIN)
+		h->nr++;
+	if (h->nr < HERD_MIN)
+		return NULL;
+	if (h->nr == HERD_MIN) {
+		h->nr++;                /* onset: snapshot once per burst */
+		idle = scx_bpf_get_idle_cpumask();
+		bpf_for(c, 0, AUCTION_NCPU_MAX) {
+			if (bpf_cpumask_test_cpu(c, idle))
+				h->avail |= 1ULL << c;
+		}
+		scx_bpf_put_idle_cpumask(idle);
+	}
+	return h;
+}
+
+/* This CPU's burst state while a herd is being woken from it, else NULL. */
+static __always_inline struct herd *
+herd_active(u64 now)
+{
+	u32 zero = 0;
+	struct herd *h = bpf_map_lookup_elem(&herd_state, &zero);
+
+	if (!h || h->nr < HERD_MIN || now - h->last_ns > HERD_GAP_NS)
+		return NULL;
+	return h;
+}
+
+/*
+ * Next snapshot CPU `p` may use, claimed; classes below `lim` only.  A
+ * CPU leaves the snapshot when handed out or found busy, so no two herd
+ * members chase the same one.
+ */
+static __always_inline s32
+herd_pop(struct herd *h, struct task_struct *p, u32 lim)
+{
+	s32 c;
+
+	bpf_for(c, 0, AUCTION_NCPU_MAX) {
+		u64 bit = 1ULL << c;
+
+		if (!(h->avail & bit))
+			continue;
+		if (cpu_class_of((u32)c) >= lim ||
+		    !bpf_cpumask_test_cpu(c, p->cpus_ptr))
+			continue;
+		h->avail &= ~bit;
+		if (scx_bpf_test_and_clear_cpu_idle(c))
+			return c;
+	}
+	return -1;
+}
+
+/*
+ * Re-enqueue side of an exec rebalance (see a1349_exec): move the task to
+ * an idle CPU of its class on an idler LLC, else let it take the normal
+ * path.
+ */
+static __always_inline bool
+spawn_take_exec(struct task_struct *p, struct auction_task_ctx *tctx,
+		u64 slice_ns, u64 enq_flags)
+{
+	s32 dst;
+
+	tctx->spawn &= ~SPAWN_EXEC;
+	dst = spread_pick(p, (s32)bpf_get_smp_processor_id(), tctx->cls,
+			  tctx->cls + 1, true);
+	if (dst < 0)
+		return false;
+
+	scx_bpf_dsq_insert(p, SCX_DSQ_LOCAL_ON | (u64)dst, slice_ns, enq_flags);
+	scx_bpf_kick_cpu(dst, SCX_KICK_IDLE);
+	stat_inc(STAT_SPAWN_EXEC);
+	return true;
+}
+
+/*
+ * Read the task's A1349_HINT_* word from task local data.  Tasks that never
+ * registered a TLD page fail tld_object_init() with -ENODATA after a single
+ * task-storage lookup, so the common unhinted case stays cheap.
+ */
+static __always_inline u32
+task_hints(struct task_struct *p)
+{
+	struct tld_object tld_obj;
+	u32 *hint;
+
+	if (!tld_hints_enabled)
+		return 0;
+	if (tld_object_init(p, &tld_obj))
+		return 0;
+
+	hint = tld_get_data(&tld_obj, hint, A1349_HINT_TLD_NAME, sizeof(u32));
+	return hint ? *hint : 0;
+}
+
+/*
+ * Value term v_i in weight units, before the PHI_VALUE_SHIFT widening.
+ * Hints move v_i only — budgets stay keyed on the real weight, so a task
+ * that claims latency-criticality still pays for every contested quantum.
+ */
+static __always_inline u32
+hinted_value(u32 weight, u32 hints)
+{
+	if (hints & A1349_HINT_LAT_CRIT)
+		return weight << HINT_VALUE_SHIFT;
+	if (hints & A1349_HINT_BATCH)
+		return (weight >> HINT_VALUE_SHIFT) ?: 1;
+	return weight;
+}
+
+/*
+ * Look up p's operator rule: cgroup id, then comm prefix, then real uid.
+ * Three hash / trie probes, done on wake-up only — a preempt re-enqueue
+ * reuses the cached copy.
+ */
+static __always_inline void
+task_rule(struct task_struct *p, struct a1349_rule *out)
+{
+	struct a1349_comm_key ck = {
+		.prefixlen = A1349_RULE_COMM_LEN * 8,
+	};
+	struct a1349_rule *r;
+	u64 cgid;
+	u32 uid;
+
+	out->cls       = A1349_RULE_CLASS_NONE;
+	out->slice     = A1349_RULE_SLICE_DEFAULT;
+	out->value_pct = 0;
+	if (!rules_enabled)
+		return;
+
+	cgid = BPF_CORE_READ(p, cgroups, dfl_cgrp, kn, id);
+	r = bpf_map_lookup_elem(&rule_cgroup, &cgid);
+	if (!r) {
+		bpf_probe_read_kernel(ck.comm, sizeof(ck.comm), p->comm);
+		r = bpf_map_lookup_elem(&rule_comm, &ck);
+	}
+	if (!r) {
+		uid = BPF_CORE_READ(p, real_cred, uid.val);
+		r = bpf_map_lookup_elem(&rule_uid, &uid);
+	}
+	if (r)
+		*out = *r;
+}
+
+static __always_inline u32
+rule_value(u32 value, const struct a1349_rule *rule)
+{
+	if (!rule->value_pct)
+		return value;
+	return ((u64)value * rule->value_pct / 100) ?: 1;
+}
+
+static __always_inline u64
+rule_slice(const struct a1349_rule *rule, u64 dfl)
+{
+	switch (rule->slice) {
+	case A1349_RULE_SLICE_SHORT:
+		return AUCTION_SLICE_P;
+	case A1349_RULE_SLICE_LONG:
+		return AUCTION_SLICE_E;
+	case A1349_RULE_SLICE_BATCH:
+		return AUCTION_SLICE_BATCH;
+	default:
+		return dfl;
+	}
+}
+
+/*
+ * Effective utilisation clamp, on the cpu_capacity scale.  The core folds
+ * the cgroup's cpu.uclamp.{min,max} into p->uclamp[] before ops.enqueue
+ * and marks it active; before that (select_cpu, first enqueue on some
+ * kernels) the task's own request is the best there is.  Kernels built
+ * without CONFIG_UCLAMP_TASK report the neutral [0, CAPACITY_SCALE].
+ */
+static __always_inline u32
+task_uclamp(struct task_struct *p, enum uclamp_id id)
+{
+	u32 dfl = id == UCLAMP_MIN ? 0 : CAPACITY_SCALE;
+
+	if (!bpf_core_field_exists(p->uclamp))
+		return dfl;
+	if (BPF_CORE_READ_BITFIELD(&p->uclamp[id], active))
+		return BPF_CORE_READ_BITFIELD(&p->uclamp[id], value);
+	return BPF_CORE_READ_BITFIELD(&p->uclamp_req[id], value);
+}
+
+/*
+ * uclamp.min is a capacity floor: classes are ordered strongest first, so
+ * the classes with η_k ≥ uclamp.min form a prefix [0, lim).  Class 0 is
+ * always allowed — a floor above η_0 is as good as it gets.
+ */
+static __always_inline u32
+uclamp_class_lim(const struct auction_ctx *gdata, u32 umin, u32 nr)
+{
+	u32 k;
+
+	if (homogeneous || !umin)
+		return nr;
+	bpf_for(k, 1, NR_CLASSES_MAX) {
+		if (k >= nr)
+			break;
+		if (gdata->class_capacity[k] < umin)
+			return k;
+	}
+	return nr;
+}
+
+/*
+ * Preempt one CPU in p's affinity that is running a SCHED_IDLE task.  The
+ * idle-class task is re-enqueued into AUCTION_DSQ_IDLE and the CPU's next
+ * dispatch finds the new arrival ahead of it.
+ */
+static __always_inline bool
+kick_idle_class_runner(struct task_struct *p)
+{
+	s32 c;
+
+	bpf_for(c, 0, AUCTION_NCPU_MAX) {
+		u32 key = (u32)c;
+		u8 *busy_idle = bpf_map_lookup_elem(&cpu_runs_idle_class, &key);
+
+		if (!busy_idle || !*busy_idle)
+			continue;
+		if (!bpf_cpumask_test_cpu(c, p->cpus_ptr))
+			continue;
+		*busy_idle = 0;
+		scx_bpf_kick_cpu(c, SCX_KICK_PREEMPT);
+		return true;
+	}
+	return false;
+}
+
+/*
+ * Tickless lone runner.  A task that starts running with nothing queued
+ * that could displace it (lone_runner) gets SCX_SLICE_INF, which lets a
+ * nohz_full CPU stop its tick.  The first competitor that finds no idle
+ * CPU revokes the grant with a preempting kick (inf_revoke); where the
+ * tick still runs it re-checks as a backstop.  An uncontested run is
+ * priced at zero anyway — there is no runner-up to pay.
+ *
+ * The grant and a competitor's enqueue race store-buffer style: the
+ * runner sets cpu_run.inf and then reads the DSQs, the enqueuer inserts
+ * and then reads inf.  Each side puts a full-barrier RMW between its
+ * store and its loads, so at least one sees the other, and inf_clear()
+ * takes a grant back with an xchg, so exactly one party revokes it.
+ */
+
+/* Drop `cr`'s grant; true for the single caller that took it. */
+static __always_inline bool
+inf_clear(struct cpu_run *cr)
+{
+	struct auction_runtime *rt;
+
+	if (!cr->inf || !__sync_lock_test_and_set(&cr->inf, 0))
+		return false;
+	rt = get_rt();
+	if (rt)
+		__sync_fetch_and_sub(&rt->nr_inf, 1);
+	return true;
+}
+
+/*
+ * True when nothing could displace the task about to run on `cpu`: its
+ * local and sticky DSQs, every class DSQ (stealable) and STARVED are all
+ * empty.  Gangs launch across CPUs on their own schedule, so never alone.
+ */
+static __always_inline bool
+lone_runner(u32 cpu, u32 nr)
+{
+	u32 k;
+
+	/* Central mode hands out slices itself; nothing to hold back. */
+	if (nr_gangs || central_cpu >= 0 ||
+	    scx_bpf_dsq_nr_queued(SCX_DSQ_LOCAL) ||
+	    scx_bpf_dsq_nr_queued(AUCTION_DSQ_PERCPU_BASE + cpu) ||
+	    scx_bpf_dsq_nr_queued(AUCTION_DSQ_STARVED))
+		return false;
+	bpf_for(k, 0, NR_CLASSES_MAX) {
+		if (k >= nr)
+			break;
+		if (scx_bpf_dsq_nr_queued(AUCTION_DSQ_CLASS_BASE + k))
+			return false;
+	}
+	return true;
+}
+
+/*
+ * A competitor found no idle CPU after its DSQ insert: take the infinite
+ * slice back from one lone runner in its affinity.  The fetch of nr_inf is
+ * the enqueue side's full barrier and skips the scan when nobody holds one.
+ */
+static __always_inline bool
+inf_revoke(struct task_struct *p)
+{
+	struct auction_runtime *rt = get_rt();
+	s32 c;
+
+	if (!rt || !__sync_fetch_and_add(&rt->nr_inf, 0))
+		return false;
+
+	bpf_for(c, 0, AUCTION_NCPU_MAX) {
+		u32 key = (u32)c;
+		struct cpu_run *cr = bpf_map_lookup_elem(&cpu_run, &key);
+
+		if (!cr || !cr->inf || !bpf_cpumask_test_cpu(c, p->cpus_ptr))
+			continue;
+		if (!inf_clear(cr))
+			continue;
+		scx_bpf_kick_cpu(c, SCX_KICK_PREEMPT);
+		stat_inc(STAT_SLICE_INF_REVOKE);
+		return true;
+	}
+	return false;
+}
+
+/*
+ * Lock-holder boost, expressed as the hints it stands for so the enqueue
+ * and tick paths need no separate branch.
+ */
+static __always_inline u32
+boost_hints(struct auction_task_ctx *tctx, u64 now)
+{
+	if (futex_boost_enabled && now < tctx->boost_until_ns)
+		return A1349_HINT_LAT_CRIT | A1349_HINT_NO_PREEMPT;
+	return 0;
+}
+
+static __always_inline void
+boost_grant(struct auction_task_ctx *tctx, u64 now, u32 stat)
+{
+	if (tctx->boost_until_ns &&
+	    now < tctx->boost_until_ns + FUTEX_BOOST_COOLDOWN_NS) {
+		/* Still boosted, or cooling down: an extension is a renewal. */
+		if (now >= tctx->boost_until_ns)
+			stat_inc(STAT_FUTEX_THROTTLED);
+		return;
+	}
+	tctx->boost_until_ns = now + FUTEX_BOOST_NS;
+	stat_inc(stat);
+}
+
+/*
+ * Encode signed φ into an unsigned DSQ vtime key such that a larger φ
+ * yields a smaller key (kernel DSQ sorts ascending → highest φ served first).
+ */
+static __always_inline u64
+encode_phi(s64 phi)
+{
+	if (phi >= 0)
+		return PHI_BIAS - (u64)phi;
+	return PHI_BIAS + (u64)(-phi);
+}
+
+/*
+ * DSQ key of a class insert under order_mode.  The deadline modes keep an
+ * EEVDF-style virtual time per class: V_κ follows the vtime of whatever
+ * starts running there (auction_running), a run is charged at 100/w_i
+ * (auction_stopping), and a waking or re-classed task has its lag clamped
+ * to a slice either side of V_κ, so neither a long sleep nor a class
+ * change is worth more than one slice.  Deadline d_i = v_i + r_i · 100/w_i.
+ *
+ * Hybrid moves d_i earlier by ORDER_PHI_NS per unit of φ, bounded by
+ * ORDER_PHI_SPAN_NS either way: valuable short work still goes first, but
+ * equal-φ tasks are ordered by deadline instead of insertion.
+ */
+static __always_inline u64
+order_key(struct auction_task_ctx *tctx, u32 cls, s64 phi, u64 slice_ns,
+	  u32 weight, bool reanchor)
+{
+	struct auction_runtime *rt;
+	u64 vnow, dl;
+	s64 shift;
+
+	if (order_mode == A1349_ORDER_PHI)
+		return encode_phi(phi);
+	rt = get_rt();
+	if (!rt)
+		return encode_phi(phi);
+
+	vnow = rt->vtime_now[cls & CLASS_MASK];
+	if (reanchor) {
+		if (tctx->vtime + slice_ns < vnow)
+			tctx->vtime = vnow - slice_ns;
+		else if (tctx->vtime > vnow + slice_ns)
+			tctx->vtime = vnow + slice_ns;
+	}
+	dl = tctx->vtime + slice_ns * 100 / (weight ?: 1);
+	if (order_mode != A1349_ORDER_HYBRID)
+		return dl;
+
+	shift = phi * (s64)ORDER_PHI_NS;
+	if (shift > (s64)ORDER_PHI_SPAN_NS)
+		shift = ORDER_PHI_SPAN_NS;
+	else if (shift < -(s64)ORDER_PHI_SPAN_NS)
+		shift = -(s64)ORDER_PHI_SPAN_NS;
+	return dl + ORDER_PHI_SPAN_NS - shift;
+}
+
+/*
+ * Compute φ_κ for a task on class κ (eq:phi, rescaled to weight-units).
+ *
+ *   l_q  = len_ns / SLICE_P            (length in P-quanta, continuous)
+ *   φ_κ = w · η_κ/η_0 − c_κ · l_q      (φ_0 = w − c_0 · l_q)
+ *
+ * Earlier (weight × ns) formulation produced |φ| ≈ 1e10, which dominated
+ * the budget scale and pushed VCG payments to either clamp at zero (free)
+ * or drain the bucket in a single dispatch.  Dividing by SLICE_P
+ * normalises φ to the same magnitude as the weight (≈ 1..50000), making
+ * the budget and replenishment constants from s4 directly reusable.
+ *
+ * Integer-only: cost_κ · len_ns is rounded by adding SLICE_P/2 before the
+ * division to avoid systematic truncation bias on sub-quantum tasks.
+ */
+static __always_inline s64
+compute_phi(u32 weight, u64 len_ns, u32 cap, u32 max_cap, u32 cost)
+{
+	u64 mx = max_cap ? max_cap : CAPACITY_SCALE;
+	u64 mc = cap ? cap : mx;
+	u64 w_k = (u64)weight * mc / mx;
+	/*
+	 * Integer-quantum discretisation of the cost term.  Sub-quantum
+	 * tasks collapse to l_q=0 (cost=0), so same-weight short tasks
+	 * share a single φ key and the DSQ falls back to insertion order
+	 * within that bucket — restores hackbench's natural FIFO producer-
+	 * consumer pairing that the original ns-precision cost destroyed.
+	 * Long-running tasks (l_q ≥ 1) still rank by integer quanta.
+	 */
+	u64 l_q_int = (len_ns + AUCTION_SLICE_P / 2) / AUCTION_SLICE_P;
+	u64 cost_q  = (u64)cost * l_q_int;
+
+	/*
+	 * v_i scaled by PHI_VALUE_SHIFT to break the φ=0 degeneracy that
+	 * collapses default-nice tasks to FIFO inside the DSQ.  Cost stays
+	 * at native scale: ranking now uses widened value with cost as a
+	 * smaller corrective term, which preserves the sign of φ on
+	 * long-running tasks (φ < 0 when the contract dominates the value).
+	 */
+	return ((s64)w_k << PHI_VALUE_SHIFT) - (s64)cost_q;
+}
+
+/* φ_κ for one class, capacity capped at uclamp.max (see auction_enqueue). */
+static __always_inline s64
+class_phi(const struct auction_ctx *gdata, u32 k, u32 value, u64 len_ns,
+	  u32 umax, u32 max_cap)
+{
+	u32 cap;
+
+	k &= CLASS_MASK;
+	cap = gdata->class_capacity[k];
+	if (cap > umax)
+		cap = umax ?: 1;        /* 0 would read as "unclamped" */
+	return compute_phi(value, len_ns, cap, max_cap,
+			   gdata->class_cost[k] ?: C_P_DEF);
+}
+
+/*
+ * Contract length in quanta:  m_κ(l) = ⌈l · η_0/η_κ⌉  (m_0(l) = l).
+ * Capped only at CONTRACT_M_MAX: δ^m is computed, not looked up.
+ *
+ *   l (in P-quanta) = ⌈len_ns / SLICE_P⌉,  l ≥ 1.
+ */
+static __always_inline u32
+contract_length(u64 len_ns, u32 cap, u32 max_cap)
+{
+	u64 mx = max_cap ? max_cap : CAPACITY_SCALE;
+	u64 mc = cap ? cap : mx;
+	u64 l_p;
+	u64 m;
+
+	l_p = (len_ns + AUCTION_SLICE_P - 1) / AUCTION_SLICE_P;
+	if (l_p < 1)
+		l_p = 1;
+
+	if (mc >= mx)
+		m = l_p;
+	else
+		m = (l_p * mx + mc - 1) / mc;
+
+	if (m > CONTRACT_M_MAX)
+		m = CONTRACT_M_MAX;
+	return (u32)m;
+}
+
+/*
+ * δ^m · DELTA_SCALE as 2^(m · log2 δ), for m ≤ CONTRACT_M_MAX.  The exponent
+ * is Q32.32, so a fractional contract length only needs m passed in fixed
+ * point.  scx_fix_mul_exp() clamps m · log2 δ at −64, past exp2()'s
+ * underflow, so δ^m floors at 0 instead of wrapping.
+ */
+static __always_inline u64
+delta_pow(u32 m)
+{
+	u64 d = scx_fix_exp2(scx_fix_mul_exp((s64)SCX_FIX(m), delta_log2));
+
+	return (d + (1ULL << (SCX_FIX_SHIFT - DELTA_SHIFT - 1))) >>
+	       (SCX_FIX_SHIFT - DELTA_SHIFT);
+}
+
+/*
+ * Replenish budget by idle time × weight.  Token bucket capped at budget_max.
+ * Mirrors theory §2.4 "Аллокация задаче … допустима, если p_i ≤ B_i^t":
+ * sleep accrues credit; the budget cap prevents permanent stockpiling.
+ *
+ * Consumes the credited interval by advancing last_stop_ns to `now` on a
+ * successful refill.  This lets the caller invoke budget_replenish() on
+ * every enqueue (including preempt re-enqueues that lack SCX_ENQ_WAKEUP)
+ * without double-crediting: a tight preempt-re-enqueue arrives with
+ * idle_ns ≈ 0 and is a no-op, while a genuine sleep period is fully
+ * credited exactly once and then consumed.
+ */
+static __always_inline void
+budget_replenish(struct auction_task_ctx *tctx, u64 now)
+{
+	u64 idle_ns, add;
+
+	if (!tctx->last_stop_ns || now <= tctx->last_stop_ns)
+		return;
+
+	idle_ns = now - tctx->last_stop_ns;
+	if (idle_ns > REPLENISH_IDLE_CAP)
+		idle_ns = REPLENISH_IDLE_CAP;
+
+	add = idle_ns * (u64)(tctx->weight_cached ?: 1) / REPLENISH_DIV;
+	tctx->budget += add;
+	if (tctx->budget > tctx->budget_max)
+		tctx->budget = tctx->budget_max;
+
+	tctx->last_stop_ns = now;
+}
+
+/*
+ * VCG payment in the single-slot regime (eq:single-unit-payment):
+ *
+ *   p = φ_j  +  (δ^{m_j} − δ^{m_i}) · \bar W_κ / DELTA_SCALE
  *
  * If the runner-up j is absent, φ_j ≡ 0 and m_j ≡ 0 (so δ^0 = 1), which
  * collapses the payment to the "lonely winner" form
@@ -412,7 +1623,67 @@ vcg_payment(s64 phi_j, u32 m_j, u32 m_i, u64 w_bar)
 	else
 		ext = -(s64)(((u64)(-diff) * w_bar) >> DELTA_SHIFT);
 
-	return phi_j + ext;
+	return phi_j + ext;
+}
+
+/*
+ * Claim an idle CPU of the given class within `mask` (any CPU if NULL).
+ * Same linear scan as select_cpu's P-bias pass, bounded by
+ * AUCTION_NCPU_MAX.
+ */
+static __always_inline s32
+gang_claim_idle(const struct cpumask *mask, u32 cls)
+{
+	s32 c;
+
+	bpf_for(c, 0, AUCTION_NCPU_MAX) {
+		if (cpu_class_of((u32)c) != cls)
+			continue;
+		if (mask && !bpf_cpumask_test_cpu(c, mask))
+			continue;
+		if (scx_bpf_test_and_clear_cpu_idle(c))
+			return c;
+	}
+	return -1;
+}
+
+/* Queued members a launch waits for, at most GANG_MAX_LAUNCH. */
+static __always_inline u32
+gang_want(const struct gang_cfg *gc)
+{
+	if (!gc || !gc->min_members)
+		return 1;
+	return gc->min_members < GANG_MAX_LAUNCH ? gc->min_members
+						 : GANG_MAX_LAUNCH;
+}
+
+/* Wake a CPU of `cls` at the gang's wait deadline. */
+static __always_inline void
+gang_arm(u32 slot, u32 cls)
+{
+	struct gang_timer *gt = bpf_map_lookup_elem(&gang_timer, &slot);
+
+	if (!gt)
+		return;
+	gt->cls = cls;
+	bpf_timer_start(&gt->timer, GANG_WAIT_NS, 0);
+}
+
+/*
+ * Wait deadline: a partial gang may now launch, but nothing else wakes
+ * an idle CPU for the gang DSQ.  A busy class reaches it on its own.
+ */
+static int
+gang_timerfn(void *map, int *key, struct gang_timer *gt)
+{
+	s32 c;
+
+	if (!scx_bpf_dsq_nr_queued(AUCTION_DSQ_GANG_BASE + (u32)*key))
+		return 0;
+	c = gang_claim_idle(NULL, gt->cls & CLASS_MASK);
+	if (c >= 0)
+		scx_bpf_kick_cpu(c, SCX_KICK_IDLE);
+	return 0;
 }
 
 /* ── sched_ext ops ───────────────────────────────────────────────────────── */
@@ -423,36 +1694,187 @@ BPF_STRUCT_OPS(auction_select_cpu,
 	       s32                 prev_cpu,
 	       u64                 wake_flags)
 {
+	struct auction_ctx      *gdata = get_ctx();
 	struct auction_task_ctx *tctx;
 	bool is_idle = false;
 	s32 cpu = -1;
 	s32 c;
 
+	/* Central mode: placement is the central CPU's auction. */
+	if (central_cpu >= 0)
+		return prev_cpu;
+
 	tctx = get_task_ctx(p, false);
 	if (tctx)
 		tctx->wake_prev_cpu = prev_cpu;
 
+	/*
+	 * Gang members wake into their gang DSQ (auction_enqueue); an idle
+	 * direct insert here would run them one by one, co-scheduled only
+	 * under contention.
+	 */
+	if (nr_gangs && p->nr_cpus_allowed > 1) {
+		u32 tgid = (u32)p->tgid;
+
+		if (bpf_map_lookup_elem(&gang_map, &tgid))
+			return prev_cpu;
+	}
+
+	/*
+	 * Consolidation: an idle pack-set CPU, else queue behind a busy one
+	 * rather than wake a core outside the set.
+	 */
+	if (gdata && pack_active(gdata, bpf_ktime_get_ns())) {
+		u32 lim = uclamp_class_lim(gdata, task_uclamp(p, UCLAMP_MIN),
+					   nr_classes_of(gdata));
+
+		cpu = pack_pick(p, prev_cpu, true, lim);
+		if (cpu >= 0) {
+			is_idle = true;
+			goto have_cpu;
+		}
+		cpu = pack_pick(p, prev_cpu, false, lim);
+		if (cpu >= 0)
+			return cpu;
+	}
+
+	/*
+	 * Fork balancing: a child of a fork burst goes to an idle CPU on the
+	 * idlest LLC; a lone fork falls through and stays near its parent.
+	 */
+	if ((wake_flags & SCX_WAKE_FORK) && gdata && tctx) {
+		struct auction_task_ctx *ptctx =
+			get_task_ctx(bpf_get_current_task_btf(), false);
+
+		if (ptctx && spawn_note_fork(ptctx, bpf_ktime_get_ns())) {
+			u32 lim = uclamp_class_lim(gdata,
+						   task_uclamp(p, UCLAMP_MIN),
+						   nr_classes_of(gdata));
+
+			tctx->spawn |= SPAWN_SPREAD;
+			cpu = spread_pick(p, prev_cpu, 0, lim, false);
+			if (cpu >= 0) {
+				stat_inc(STAT_SPAWN_SPREAD);
+				is_idle = true;
+				goto have_cpu;
+			}
+		}
+	}
+
+	/*
+	 * SCHED_BATCH / SCHED_IDLE and BATCH-hinted tasks stay off class 0;
+	 * let the default selector find them a core and leave P-cores to
+	 * interactive work.
+	 */
+	if (p->policy == SCHED_BATCH || p->policy == SCHED_IDLE ||
+	    (tctx && (tctx->hints & A1349_HINT_BATCH)))
+		goto dfl;
+
+	/*
+	 * Sync wake-up (pipe / socket handoff): the waker is about to block,
+	 * so its CPU frees up at once and still holds the data it just
+	 * wrote.  Queue the wakee behind it instead of on another idle P-core
+	 * — the hackbench pipe pairing.  Only when the waker's CPU is of the
+	 * class the wakee last ran on (no silent class change), is in its
+	 * affinity, and has nothing else queued locally to wait behind.
+	 *
+	 * Not while the waker holds SCX_SLICE_INF: a local insert bypasses
+	 * enqueue and its inf_revoke(), and a waker that keeps running after
+	 * all would leave the wakee with no tick to preempt it.
+	 */
+	if ((wake_flags & SCX_WAKE_SYNC) && gdata && tctx) {
+		s32 waker_cpu = (s32)bpf_get_smp_processor_id();
+		u32 key = (u32)waker_cpu;
+		struct cpu_run *cr = bpf_map_lookup_elem(&cpu_run, &key);
+
+		if (cr && !cr->inf &&
+		    cpu_class_of((u32)waker_cpu) == tctx->cls &&
+		    bpf_cpumask_test_cpu(waker_cpu, p->cpus_ptr) &&
+		    !scx_bpf_dsq_nr_queued(SCX_DSQ_LOCAL)) {
+			tctx->slice_ns = (u32)class_slice(tctx->cls,
+						  nr_classes_of(gdata));
+			scx_bpf_dsq_insert(p, SCX_DSQ_LOCAL, tctx->slice_ns, 0);
+			stat_inc(STAT_SYNC_LOCAL);
+			return waker_cpu;
+		}
+		stat_inc(STAT_SYNC_SKIP);
+	}
+
+	/*
+	 * Herd member: the next CPU off the burst's idle snapshot; with the
+	 * snapshot spent nothing is idle worth scanning for, so queue.
+	 */
+	if (gdata && !(wake_flags & (SCX_WAKE_SYNC | SCX_WAKE_FORK))) {
+		struct herd *h = herd_note(bpf_ktime_get_ns());
+
+		if (h) {
+			cpu = herd_pop(h, p, uclamp_class_lim(gdata,
+					task_uclamp(p, UCLAMP_MIN),
+					nr_classes_of(gdata)));
+			if (cpu < 0)
+				return prev_cpu;
+			stat_inc(STAT_HERD_SPREAD);
+			is_idle = true;
+			goto have_cpu;
+		}
+	}
+
+	/*
+	 * Memory-bound: an idle CPU on a quieter LLC, ahead of the P-bias — a
+	 * stream gains little from a faster core and a lot from a memory
+	 * path it does not share.
+	 */
+	if (membw_thresh && gdata && tctx && membw_bound(tctx) &&
+	    gdata->nr_llcs > 1) {
+		cpu = membw_pick(p, prev_cpu, uclamp_class_lim(gdata,
+					task_uclamp(p, UCLAMP_MIN),
+					nr_classes_of(gdata)));
+		if (cpu >= 0) {
+			stat_inc(STAT_MEMBW_SPREAD);
+			is_idle = true;
+			goto have_cpu;
+		}
+	}
+
 	/*
 	 * P-bias scan (model §2.4 Allocation rule, refined):  prefer an idle
-	 * P-cluster CPU first.  For default-weight tasks φ_P ≥ φ_E almost
-	 * always (weight − cost > weight·η_E/η_P − cost), so the rule reduces
+	 * class-0 CPU first.  For default-weight tasks φ_0 ≥ φ_κ almost
+	 * always (weight − cost > weight·η_κ/η_0 − cost), so the rule reduces
 	 * to "land on the strongest core that's free".  Avoids the
 	 * select_cpu_dfl bias toward prev_cpu which routinely strands single-
 	 * threaded passmark workers on E-cores.
 	 *
-	 * Fast path: cache-warm prev_cpu wins if it is an idle P-core.
+	 * Fast path: an idle prev_cpu wins when moving to a faster core would
+	 * not pay for its cache (mig_stay_prev); on a full-capacity P-core
+	 * that is always.
+	 *
+	 * Favoured cores (prefcore): rank the idle P-cores by capacity and
+	 * take the fastest, prev_cpu breaking ties.
+	 *
+	 * Homogeneous: every core is a P-core, and the default selector's
+	 * prev_cpu / SMT / LLC preference is the better scan.
 	 */
-	if (prev_cpu >= 0 && cpu_is_p_type((u32)prev_cpu) &&
+	if (homogeneous)
+		goto dfl;
+	if (gdata && tctx && prev_cpu >= 0 &&
 	    bpf_cpumask_test_cpu(prev_cpu, p->cpus_ptr) &&
+	    mig_stay_prev(gdata, tctx, prev_cpu, bpf_ktime_get_ns()) &&
 	    scx_bpf_test_and_clear_cpu_idle(prev_cpu)) {
 		cpu = prev_cpu;
 		is_idle = true;
 		goto have_cpu;
 	}
+	if (gdata && gdata->prefcore) {
+		cpu = prefcore_pick_idle(p, prev_cpu);
+		if (cpu >= 0) {
+			is_idle = true;
+			goto have_cpu;
+		}
+	}
 
 	/* Scan for any idle P-core.  AUCTION_NCPU_MAX bounds the loop. */
 	bpf_for(c, 0, AUCTION_NCPU_MAX) {
-		if (!cpu_is_p_type((u32)c))
+		if (cpu_class_of((u32)c))
 			continue;
 		if (!bpf_cpumask_test_cpu(c, p->cpus_ptr))
 			continue;
@@ -463,15 +1885,20 @@ BPF_STRUCT_OPS(auction_select_cpu,
 		}
 	}
 
-	/* No idle P: fall back to default selector (lets idle E be picked). */
+	/* No idle P: fall back to default selector (lets any class be picked). */
+dfl:
 	if (cpu < 0)
 		cpu = scx_bpf_select_cpu_dfl(p, prev_cpu, wake_flags, &is_idle);
 
 have_cpu:
 	if (cpu >= 0 && is_idle) {
+		/* SCHED_IDLE gets the idle-class slice, as in enqueue. */
+		u64 slice = p->policy == SCHED_IDLE ? AUCTION_SLICE_E
+						    : AUCTION_SLICE_P;
+
 		if (tctx)
-			tctx->long_slice = 0;
-		scx_bpf_dsq_insert(p, SCX_DSQ_LOCAL, AUCTION_SLICE_P, 0);
+			tctx->slice_ns = slice;
+		scx_bpf_dsq_insert(p, SCX_DSQ_LOCAL, slice, 0);
 	}
 
 	return cpu;
@@ -482,22 +1909,23 @@ BPF_STRUCT_OPS(auction_enqueue, struct task_struct *p, u64 enq_flags)
 {
 	struct auction_ctx      *gdata = get_ctx();
 	struct auction_task_ctx *tctx  = get_task_ctx(p, true);
-	u32 max_cap, min_cap, cost_p, cost_e, weight;
-	u64 len_ns, slice_ns, dsq_id;
-	s64 phi_p, phi_e, phi_chosen;
-	u32 m_chosen;
-	bool on_p, is_wakeup;
+	s64 phi[NR_CLASSES_MAX] = {};
+	u32 max_cap, weight, hints, nr, cls, k, umin, umax, value;
+	u32 lim = NR_CLASSES_MAX;
+	u64 len_ns, slice_ns, dsq_id, now;
+	s64 phi_chosen;
+	bool is_wakeup, packed = false;
+	u8 prev_cls;
 
 	if (!gdata || !tctx)
 		return;
 
-	max_cap = gdata->max_capacity ?: CAPACITY_SCALE;
-	min_cap = gdata->min_capacity ?: max_cap;
-	cost_p  = gdata->cost_p       ?: C_P_DEF;
-	cost_e  = gdata->cost_e       ?: C_E_DEF;
+	nr      = nr_classes_of(gdata);
+	max_cap = gdata->class_capacity[0] ?: CAPACITY_SCALE;
 	weight  = p->scx.weight       ?: 1;
 	tctx->weight_cached = weight;
 	is_wakeup = (enq_flags & SCX_ENQ_WAKEUP) || !tctx->last_stop_ns;
+	prev_cls  = tctx->cls;
 
 	/*
 	 * Replenish unconditionally — preempt re-enqueues arrive with
@@ -506,33 +1934,172 @@ BPF_STRUCT_OPS(auction_enqueue, struct task_struct *p, u64 enq_flags)
 	 * the moderate-load schbench p99 cliff where workers preempted
 	 * faster than REPLENISH_DIV could refill on WAKEUP-only path.
 	 */
-	budget_replenish(tctx, bpf_ktime_get_ns());
+	now = bpf_ktime_get_ns();
+	budget_replenish(tctx, now);
+	if (pack_enabled)
+		tctx->enq_ns = now;
+	starved_fold(tctx, now);
+
+	/*
+	 * Central mode: a task that may run on one CPU only has nothing to
+	 * bid for — straight to that CPU's local DSQ.
+	 */
+	if (central_cpu >= 0 && p->nr_cpus_allowed == 1) {
+		s32 cpu = scx_bpf_task_cpu(p);
+
+		scx_bpf_dsq_insert(p, SCX_DSQ_LOCAL_ON | (u64)cpu,
+				   tctx->slice_ns ?: AUCTION_SLICE_P, enq_flags);
+		scx_bpf_kick_cpu(cpu, SCX_KICK_IDLE);
+		return;
+	}
+
+	/*
+	 * SCHED_IDLE never enters the auction: it only soaks up cycles
+	 * nobody bid for.  No φ, no payment, no \bar W contribution.
+	 */
+	if (p->policy == SCHED_IDLE) {
+		tctx->cls      = (u8)(nr - 1);
+		tctx->slice_ns = AUCTION_SLICE_E;
+		tctx->phi_enq  = 0;
+		tctx->m_enq    = 0;
+		scx_bpf_dsq_insert(p, AUCTION_DSQ_IDLE, AUCTION_SLICE_E,
+				   enq_flags);
+		packed = pack_active(gdata, now) &&
+			 pack_pick(p, -1, false, lim) >= 0;
+		goto kick;
+	}
+
+	hints = task_hints(p) | boost_hints(tctx, now);
+	if (p->policy == SCHED_BATCH)
+		hints |= A1349_HINT_BATCH;
+	tctx->hints = hints;
+
+	if (is_wakeup)
+		task_rule(p, &tctx->rule);
 
 	len_ns = tctx->len_est_ns ?: AUCTION_SLICE_P;
-	compute_phi(weight, len_ns, max_cap, min_cap, cost_p, cost_e,
-		    &phi_p, &phi_e);
+	if ((hints & A1349_HINT_BATCH) && len_ns < BATCH_MIN_LEN_NS)
+		len_ns = BATCH_MIN_LEN_NS;
 
 	/*
-	 * Cluster routing:
-	 *   - WAKEUP / first enqueue: re-evaluate κ* = argmax_κ φ_κ.
-	 *   - Preempt re-enqueue (no WAKEUP): keep the cluster the task was
+	 * Class routing:
+	 *   - WAKEUP / first enqueue: re-evaluate κ* = argmax_κ φ_κ.  Ties
+	 *     go to the stronger class (strict > while walking down).  An
+	 *     operator rule's class, then an app hint, override the argmax.
+	 *   - Preempt re-enqueue (no WAKEUP): keep the class the task was
 	 *     last running on.  Re-routing mid-run thrashes caches without
 	 *     yielding new auction information — the task's φ hasn't moved
 	 *     enough between two adjacent quanta to justify migration.
 	 */
-	if (is_wakeup) {
-		on_p = (phi_p >= phi_e);
+	/*
+	 * uclamp: .min bounds the routable classes to lim (see
+	 * uclamp_class_lim); .max caps the capacity the task can use, so the
+	 * value term only counts min(η_κ, uclamp.max) and a stronger class
+	 * that adds nothing under the cap loses to a cheaper one on cost.
+	 */
+	umax  = task_uclamp(p, UCLAMP_MAX);
+	value = rule_value(hinted_value(weight, hints), &tctx->rule);
+
+	cls = 0;
+	if (homogeneous) {
+		/* One class: φ_0 is the bid, there is nothing to route. */
+		phi[0] = class_phi(gdata, 0, value, len_ns, umax, max_cap);
+		lim    = 1;
 	} else {
-		on_p = tctx->on_p_type != 0;
+		umin = task_uclamp(p, UCLAMP_MIN);
+		lim  = uclamp_class_lim(gdata, umin, nr);
+
+		bpf_for(k, 0, NR_CLASSES_MAX) {
+			if (k >= nr)
+				break;
+			phi[k] = class_phi(gdata, k, value, len_ns, umax,
+					   max_cap);
+			if (k < lim && k && phi[k] > phi[cls & CLASS_MASK])
+				cls = k;
+		}
+		if (is_wakeup) {
+			u8 rc = tctx->rule.cls;
+
+			if (hints & A1349_HINT_LAT_CRIT)
+				cls = 0;
+			else if (hints & A1349_HINT_BATCH)
+				cls = nr - 1;
+			else if (rc == A1349_RULE_CLASS_LAST)
+				cls = nr - 1;
+			else if (rc != A1349_RULE_CLASS_NONE)
+				cls = rc < nr ? rc : nr - 1;
+		} else {
+			cls = tctx->cls < nr ? tctx->cls : nr - 1;
+		}
+		if (cls >= lim) {
+			cls = lim - 1;
+			stat_inc(STAT_UCLAMP_FLOOR);
+		}
+	}
+
+	/*
+	 * While packing, queue on the pack set's class: a task left on
+	 * another class's DSQ would wait for a CPU that is never woken.
+	 */
+	if (pack_active(gdata, now)) {
+		s32 home = pack_pick(p, -1, false, lim);
+
+		if (home >= 0) {
+			cls    = cpu_class_of((u32)home);
+			packed = true;
+		}
+	}
+	cls &= CLASS_MASK;
+
+	phi_chosen    = phi[cls];
+	dsq_id        = AUCTION_DSQ_CLASS_BASE + cls;
+	slice_ns      = (hints & A1349_HINT_BATCH) ? AUCTION_SLICE_BATCH
+			: rule_slice(&tctx->rule, class_slice(cls, nr));
+	tctx->cls      = (u8)cls;
+	tctx->slice_ns = (u32)slice_ns;
+	tctx->phi_enq  = phi_chosen;
+	tctx->m_enq    = contract_length(len_ns, gdata->class_capacity[cls],
+					 max_cap);
+
+	/*
+	 * Gang members wake into their gang DSQ.  Admission is decided per
+	 * gang at launch time against the pooled budget, so the per-task
+	 * STARVED shortcut below does not apply; preempt re-enqueues keep the
+	 * normal sticky / class path so a running gang is not torn apart.
+	 */
+	if (nr_gangs && is_wakeup && p->nr_cpus_allowed > 1) {
+		u32 tgid = (u32)p->tgid;
+		struct gang_cfg *gc = bpf_map_lookup_elem(&gang_map, &tgid);
+
+		if (gc && gc->slot < GANG_MAX) {
+			u64 gdsq = AUCTION_DSQ_GANG_BASE + gc->slot;
+			u32 slot = gc->slot;
+			struct gang_runtime *gr =
+				bpf_map_lookup_elem(&gang_runtime, &slot);
+			bool first = !scx_bpf_dsq_nr_queued(gdsq);
+
+			if (gr && first)
+				gr->wait_since_ns = bpf_ktime_get_ns();
+			scx_bpf_dsq_insert_vtime(p, gdsq, slice_ns,
+						 encode_phi(phi_chosen),
+						 enq_flags);
+
+			/*
+			 * Only dispatch launches gangs: wake an idle CPU of
+			 * the class once enough members are queued, and arm
+			 * the wait deadline when a partial gang starts.
+			 */
+			if (scx_bpf_dsq_nr_queued(gdsq) >= gang_want(gc)) {
+				s32 c = gang_claim_idle(p->cpus_ptr, cls);
+
+				if (c >= 0)
+					scx_bpf_kick_cpu(c, SCX_KICK_IDLE);
+			} else if (first) {
+				gang_arm(slot, cls);
+			}
+			return;
+		}
 	}
-	phi_chosen    = on_p ? phi_p : phi_e;
-	m_chosen      = contract_length(len_ns, on_p, max_cap, min_cap);
-	dsq_id        = on_p ? AUCTION_DSQ_P : AUCTION_DSQ_E;
-	slice_ns      = on_p ? AUCTION_SLICE_P : AUCTION_SLICE_E;
-	tctx->on_p_type = on_p ? 1 : 0;
-	tctx->long_slice = on_p ? 0 : 1;
-	tctx->phi_enq   = phi_chosen;
-	tctx->m_enq     = m_chosen;
 
 	/*
 	 * Budget admissibility (theory Proposition 1):  if the task cannot
@@ -540,21 +2107,23 @@ BPF_STRUCT_OPS(auction_enqueue, struct task_struct *p, u64 enq_flags)
 	 * \bar W_κ, route directly to STARVED so the auction tries do not
 	 * waste a dispatch tick on it.  Cheap conservative test.
 	 */
-	if (tctx->budget_max &&
+	if (tctx->budget_max && !boost_hints(tctx, now) &&
 	    tctx->budget * 10 < tctx->budget_max) {
 		dsq_id = AUCTION_DSQ_STARVED;
 		slice_ns = AUCTION_SLICE_P;
-		tctx->long_slice = 0;
+		tctx->slice_ns = AUCTION_SLICE_P;
+		tctx->starved_since_ns = now;
 		goto insert;
 	}
 
 	/*
-	 * Asymmetric P→E spill (extension §X.1 mirrored from s4).  When the
-	 * P queue is saturated and relatively more crowded than E in
-	 * normalised depth, route the would-be P task to E to keep all cores
-	 * busy on big-P / small-E and big-E / small-P silicon alike.
+	 * Downward spill across classes (extension §X.1 mirrored from s4,
+	 * generalised from P→E).  When class κ is saturated, walk the weaker
+	 * classes j > κ and spill to the first one that is either not yet
+	 * saturated or relatively less crowded in normalised depth, keeping
+	 * every core busy whichever end of the part has more CPUs.
 	 * Cross-multiplied to avoid a 64-bit divide on the hot path:
-	 *   Q_P · K_E > Q_E · K_P  ⇒  P is the bottleneck, spill to E.
+	 *   Q_κ · n_j > Q_j · n_κ  ⇒  κ is the bottleneck, spill to j.
 	 *
 	 * Previously gated on short tasks only.  The gate caused stress
 	 * hackbench regression because long P-resident pipe pairs piled up
@@ -563,40 +2132,85 @@ BPF_STRUCT_OPS(auction_enqueue, struct task_struct *p, u64 enq_flags)
 	 * on memory-bound long-runners: those workloads still benefit from
 	 * the per-CPU sticky DSQ pin on subsequent quanta, which keeps the
 	 * task cache-warm even after the initial spill.
+	 *
+	 * A task still cache-hot on a class-κ CPU stays when waiting out the
+	 * κ backlog costs less than refilling its cache on class j.  No spill
+	 * while packing: the pack set is the only place work should run, nor
+	 * below the task's uclamp.min floor.
 	 */
-	if (on_p) {
-		u32 p_cc = gdata->p_core_count;
-		u32 e_cc = gdata->e_core_count;
-		u64 p_q  = scx_bpf_dsq_nr_queued(AUCTION_DSQ_P);
-		u64 e_q  = scx_bpf_dsq_nr_queued(AUCTION_DSQ_E);
-
-		if (p_cc && e_cc && p_q >= p_cc &&
-		    (e_q < e_cc || p_q * e_cc > e_q * p_cc)) {
-			dsq_id          = AUCTION_DSQ_E;
-			slice_ns        = AUCTION_SLICE_E;
-			tctx->on_p_type = 0;
-			tctx->long_slice = 1;
-			phi_chosen      = phi_e;
-			tctx->phi_enq   = phi_e;
-			tctx->m_enq     = contract_length(len_ns, false,
-							  max_cap, min_cap);
-			on_p            = false;
+	if (!homogeneous && cls + 1 < nr && !packed &&
+	    !(hints & A1349_HINT_LAT_CRIT)) {
+		u32 n_k = gdata->class_cpus[cls];
+		u64 q_k = scx_bpf_dsq_nr_queued(dsq_id);
+		bool hot = false;
+		u32 j;
+
+		if (n_k && q_k >= n_k &&
+		    cpu_class_of((u32)scx_bpf_task_cpu(p)) == cls &&
+		    mig_cost_ns(tctx, now) > q_k * slice_ns / n_k) {
+			stat_inc(STAT_MIG_HOLD);
+			hot = true;
+		}
+
+		bpf_for(j, 1, NR_CLASSES_MAX) {
+			u32 to = cls + j;
+			u32 n_j;
+			u64 q_j;
+
+			/* Only a saturated class spills. */
+			if (hot || !n_k || q_k < n_k || to >= lim)
+				break;
+			to &= CLASS_MASK;
+			n_j = gdata->class_cpus[to];
+			q_j = scx_bpf_dsq_nr_queued(AUCTION_DSQ_CLASS_BASE + to);
+			if (!n_j || (q_j >= n_j && q_k * n_j <= q_j * n_k))
+				continue;
+
+			cls        = to;
+			dsq_id     = AUCTION_DSQ_CLASS_BASE + to;
+			phi_chosen = phi[to];
+			if (!(hints & A1349_HINT_BATCH))
+				slice_ns = rule_slice(&tctx->rule,
+						      class_slice(to, nr));
+			tctx->cls      = (u8)to;
+			tctx->slice_ns = (u32)slice_ns;
+			tctx->phi_enq  = phi_chosen;
+			tctx->m_enq    = contract_length(len_ns,
+						gdata->class_capacity[to],
+						max_cap);
+			break;
 		}
 	}
 
+	/*
+	 * A faster class-0 core asked for this task (prefcore_pull): the
+	 * kick that triggered this re-enqueue exists only to move it there,
+	 * ahead of the sticky hold below.
+	 */
+	if (!is_wakeup && gdata->prefcore && !cls &&
+	    prefcore_take_pull(p, slice_ns, enq_flags))
+		return;
+	if (!is_wakeup && !packed && (tctx->spawn & SPAWN_EXEC) &&
+	    spawn_take_exec(p, tctx, slice_ns, enq_flags))
+		return;
+
 	/*
 	 * Per-CPU sticky DSQ for long-running preempted tasks (cache-warm
-	 * hold).  When a CPU-bound task (len_est_ns ≥ SLICE_P) hits a slice
-	 * expiry preempt, the kernel calls enqueue again on the SAME CPU
-	 * the task just ran on; routing it into the cluster DSQ allows the
-	 * next dispatch to pull it onto any peer core, losing L1/L2.
-	 * Sticky path keeps it on the same physical CPU.
+	 * hold).  When a CPU-bound task hits a slice expiry preempt, the
+	 * kernel calls enqueue again on the SAME CPU the task just ran on;
+	 * routing it into the class DSQ allows the next dispatch to pull it
+	 * onto any peer core, losing L1/L2.  Sticky path keeps it on the same
+	 * physical CPU.
+	 *
+	 * Held when the migration cost is near its ceiling — a (near)
+	 * full-slice footprint that stopped a moment ago (MIG_STICKY_NS), the
+	 * historical len_est_ns ≥ SLICE_P gate expressed in the cost model.
 	 *
 	 * Skipped for: WAKEUP (handled by cache-warm pin above), new tasks
-	 * (no last_stop_ns), short tasks (cluster mobility helps latency).
+	 * (no last_stop_ns), short tasks (class mobility helps latency).
 	 */
 	if (!is_wakeup && tctx->last_stop_ns &&
-	    tctx->len_est_ns >= AUCTION_SLICE_P) {
+	    mig_cost_ns(tctx, now) >= MIG_STICKY_NS) {
 		s32 cur = (s32)bpf_get_smp_processor_id();
 		if (cur >= 0 && cur < AUCTION_NCPU_MAX &&
 		    bpf_cpumask_test_cpu(cur, p->cpus_ptr)) {
@@ -604,6 +2218,7 @@ BPF_STRUCT_OPS(auction_enqueue, struct task_struct *p, u64 enq_flags)
 				AUCTION_DSQ_PERCPU_BASE + (u64)cur,
 				slice_ns, encode_phi(phi_chosen),
 				enq_flags);
+			tctx->sticky = 1;
 			return;
 		}
 	}
@@ -611,7 +2226,7 @@ BPF_STRUCT_OPS(auction_enqueue, struct task_struct *p, u64 enq_flags)
 	/*
 	 * Cache-warm pin on wake-up (extension §X.5 mirrored from s4).  If
 	 * the task is waking and its previously-used CPU is in the chosen
-	 * cluster and currently idle, dispatch directly to that CPU's local
+	 * class and currently idle, dispatch directly to that CPU's local
 	 * DSQ — bypasses the auction queue but only when the resource is
 	 * uncontested (consistent with theory §2.4: φ-argmax binds only when
 	 * K_κ^t < |eligible tasks|).  Empirically saves a queue-trip + an
@@ -620,38 +2235,70 @@ BPF_STRUCT_OPS(auction_enqueue, struct task_struct *p, u64 enq_flags)
 	if (is_wakeup) {
 		s32 prev_cpu = tctx->wake_prev_cpu;
 		tctx->wake_prev_cpu = -1;
-		if (prev_cpu >= 0) {
-			u32 pkey = (u32)prev_cpu;
-			u8 *flag = bpf_map_lookup_elem(&cpu_is_p, &pkey);
-			bool prev_is_p = flag && *flag;
-			bool cluster_match = on_p ? prev_is_p : !prev_is_p;
-
-			if (cluster_match &&
-			    bpf_cpumask_test_cpu(prev_cpu, p->cpus_ptr) &&
-			    scx_bpf_test_and_clear_cpu_idle(prev_cpu)) {
-				scx_bpf_dsq_insert(p,
-					SCX_DSQ_LOCAL_ON | (u64)prev_cpu,
-					slice_ns, enq_flags);
-				if ((s32)bpf_get_smp_processor_id() != prev_cpu)
-					scx_bpf_kick_cpu(prev_cpu, SCX_KICK_IDLE);
-				return;
-			}
+		if (prev_cpu >= 0 &&
+		    cpu_class_of((u32)prev_cpu) == cls &&
+		    (!pack_active(gdata, now) || cpu_in_pack((u32)prev_cpu)) &&
+		    bpf_cpumask_test_cpu(prev_cpu, p->cpus_ptr) &&
+		    scx_bpf_test_and_clear_cpu_idle(prev_cpu)) {
+			scx_bpf_dsq_insert(p, SCX_DSQ_LOCAL_ON | (u64)prev_cpu,
+					   slice_ns, enq_flags);
+			if ((s32)bpf_get_smp_processor_id() != prev_cpu)
+				scx_bpf_kick_cpu(prev_cpu, SCX_KICK_IDLE);
+			return;
 		}
 	}
 
 insert:
 	scx_bpf_dsq_insert_vtime(p, dsq_id, slice_ns,
-				 encode_phi(phi_chosen), enq_flags);
+				 dsq_id == AUCTION_DSQ_STARVED
+				 ? encode_phi(phi_chosen)
+				 : order_key(tctx, cls, phi_chosen, slice_ns,
+					     weight,
+					     is_wakeup || prev_cls != cls),
+				 enq_flags);
 
 	/*
 	 * Work-conservation kick: wake any idle CPU in the task's allowed set
 	 * so a newly queued task does not wait for a peer's slice expiry.
+	 * With no idle CPU, a CPU that is only running SCHED_IDLE work counts
+	 * as free — preempt it (CFS does the same on wakeup).  While packing,
+	 * only pack-set CPUs are woken.
 	 */
+kick:
+	if (central_cpu >= 0) {
+		scx_bpf_kick_cpu(central_cpu, SCX_KICK_IDLE);
+		return;
+	}
 	{
-		s32 idle_cpu = scx_bpf_pick_idle_cpu(p->cpus_ptr, 0);
+		struct herd *h = is_wakeup ? herd_active(now) : NULL;
+		s32 idle_cpu = -1;
+
+		/*
+		 * Herd: one kick per snapshot CPU, none once it is spent.  Only
+		 * the woken herd is rationed; a preempted or requeued task
+		 * kicks as usual.
+		 */
+		if (h && !packed) {
+			idle_cpu = herd_pop(h, p, lim);
+			if (idle_cpu < 0) {
+				stat_inc(STAT_HERD_COALESCED);
+				if (p->policy != SCHED_IDLE)
+					inf_revoke(p);
+				return;
+			}
+		} else if (packed)
+			idle_cpu = pack_pick(p, -1, true, lim);
+		/* Class-0 arrivals wake the fastest idle core first. */
+		else if (gdata->prefcore && !tctx->cls && p->policy != SCHED_IDLE)
+			idle_cpu = prefcore_pick_idle(p, -1);
+		if (idle_cpu < 0 && !packed)
+			idle_cpu = scx_bpf_pick_idle_cpu(p->cpus_ptr, 0);
 		if (idle_cpu >= 0 &&
 		    idle_cpu != (s32)bpf_get_smp_processor_id())
 			scx_bpf_kick_cpu(idle_cpu, SCX_KICK_IDLE);
+		else if (idle_cpu < 0 && p->policy != SCHED_IDLE &&
+			 !kick_idle_class_runner(p))
+			inf_revoke(p);
 	}
 
 }
@@ -726,64 +2373,529 @@ auction_try_round(u64 src_dsq, u64 w_bar, s32 cpu)
 
 	m_top = t_top->m_enq;
 
-	p_runner = bpf_iter_scx_dsq_next(&it);
-	if (p_runner) {
-		t_runner = get_task_ctx(p_runner, false);
+	/*
+	 * Runner-up j: the best loser.  In φ order that is the next entry;
+	 * in a deadline order it is the highest φ among the next
+	 * ORDER_PRICE_SCAN, and a winner chosen by deadline never pays
+	 * against a bid above its own.
+	 */
+	if (order_mode == A1349_ORDER_PHI) {
+		p_runner = bpf_iter_scx_dsq_next(&it);
+		t_runner = p_runner ? get_task_ctx(p_runner, false) : NULL;
 		if (t_runner) {
 			phi_runner = t_runner->phi_enq;
 			m_runner   = t_runner->m_enq;
 		}
+	} else {
+		bool found = false;
+		int k;
+
+		bpf_for(k, 0, ORDER_PRICE_SCAN) {
+			p_runner = bpf_iter_scx_dsq_next(&it);
+			if (!p_runner)
+				break;
+			t_runner = get_task_ctx(p_runner, false);
+			if (!t_runner ||
+			    (found && t_runner->phi_enq <= phi_runner))
+				continue;
+			phi_runner = t_runner->phi_enq;
+			m_runner   = t_runner->m_enq;
+			found      = true;
+		}
+		if (found && phi_runner > t_top->phi_enq) {
+			phi_runner = t_top->phi_enq;
+			m_runner   = m_top;
+		}
+	}
+
+	payment = vcg_payment(phi_runner, m_runner, m_top, w_bar);
+
+	/*
+	 * Budget check (theory §2.4, Proposition 1).
+	 * Negative payments are clamped to zero: VCG never credits budget.
+	 */
+	if (payment <= 0 || (u64)payment <= t_top->budget) {
+		u64 charge = payment > 0 ? (u64)payment : 0;
+		if (t_top->budget >= charge)
+			t_top->budget -= charge;
+		else
+			t_top->budget = 0;
+		/*
+		 * SCX_DSQ_LOCAL is a built-in per-CPU FIFO queue — kernel
+		 * rejects vtime ordering on it, so the bare move() is correct.
+		 */
+		scx_bpf_dsq_move(&it, p_top, SCX_DSQ_LOCAL, 0);
+		dispatched = true;
+	} else {
+		/*
+		 * Cannot afford the auction — exile to STARVED.
+		 *
+		 * STARVED was populated by enqueue via scx_bpf_dsq_insert_vtime
+		 * (PRIQ mode).  A bare scx_bpf_dsq_move() would FIFO-insert and
+		 * crash with "DSQ already had PRIQ-enqueued tasks".  Preserve the
+		 * task's φ-encoded vtime so STARVED stays φ-ordered: least-bad
+		 * task gets pulled first when budget recovers.
+		 */
+		scx_bpf_dsq_move_set_vtime(&it, encode_phi(t_top->phi_enq));
+		if (scx_bpf_dsq_move_vtime(&it, p_top, AUCTION_DSQ_STARVED, 0))
+			t_top->starved_since_ns = bpf_ktime_get_ns();
+	}
+
+out:
+	bpf_iter_scx_dsq_destroy(&it);
+	return dispatched;
+}
+
+/*
+ * Co-schedule one gang onto the calling CPU's class.
+ *
+ * Aggregate payment: every member would displace the head j of the class
+ * DSQ, so member i owes p_i = φ_j + (δ^{m_j} − δ^{m_i}) · \bar W_κ and the
+ * gang owes P = Σ p_i.  The gang is admitted as a unit when the pooled
+ * budget ΣB_i covers P; each launched member is then charged its
+ * budget-proportional share P · B_i / ΣB_i.  An unaffordable gang launches
+ * nothing: its members go to STARVED like any task that cannot pay, and
+ * run from there once the classes are empty.
+ *
+ * Two passes over the gang DSQ (price, then place).  Peers may pull from
+ * it in between; the price is then a slight over-estimate, never an
+ * under-charge.
+ *
+ * Returns true if a member landed on the calling CPU.
+ */
+static __always_inline bool
+gang_try_launch(u32 slot, s32 cpu, u32 cls, u64 self_dsq, u64 w_bar)
+{
+	struct bpf_iter_scx_dsq it;
+	struct task_struct *p;
+	struct auction_task_ctx *t;
+	struct gang_runtime *gr;
+	struct gang_cfg *gc;
+	u64 gdsq = AUCTION_DSQ_GANG_BASE + slot;
+	u64 nq, now, total = 0, pool = 0, paid = 0;
+	s64 phi_j = 0;
+	u32 m_j = 0, want = 1, n = 0;
+	bool self_used = false, afford;
+
+	nq = scx_bpf_dsq_nr_queued(gdsq);
+	if (!nq)
+		return false;
+
+	gr = bpf_map_lookup_elem(&gang_runtime, &slot);
+	if (!gr)
+		return false;
+
+	/* gang_map is keyed by tgid; the head member tells us which one. */
+	p = NULL;
+	if (!bpf_iter_scx_dsq_new(&it, gdsq, 0))
+		p = bpf_iter_scx_dsq_next(&it);
+	if (p) {
+		u32 tgid = (u32)p->tgid;
+		gc = bpf_map_lookup_elem(&gang_map, &tgid);
+		want = gang_want(gc);
+	}
+	bpf_iter_scx_dsq_destroy(&it);
+
+	now = bpf_ktime_get_ns();
+	if (nq < want && gr->wait_since_ns &&
+	    now - gr->wait_since_ns < GANG_WAIT_NS)
+		return false;
+
+	/* Runner-up j: the class's best non-gang candidate. */
+	if (!bpf_iter_scx_dsq_new(&it, self_dsq, 0)) {
+		p = bpf_iter_scx_dsq_next(&it);
+		t = p ? get_task_ctx(p, false) : NULL;
+		if (t) {
+			phi_j = t->phi_enq;
+			m_j   = t->m_enq;
+		}
+	}
+	bpf_iter_scx_dsq_destroy(&it);
+
+	/* Pass 1 — price the gang. */
+	if (!bpf_iter_scx_dsq_new(&it, gdsq, 0)) {
+		bpf_for(n, 0, GANG_MAX_LAUNCH) {
+			s64 pay;
+
+			p = bpf_iter_scx_dsq_next(&it);
+			if (!p)
+				break;
+			t = get_task_ctx(p, false);
+			if (!t)
+				continue;
+			pay = vcg_payment(phi_j, m_j, t->m_enq, w_bar);
+			if (pay > 0)
+				total += (u64)pay;
+			pool += t->budget;
+		}
+	}
+	bpf_iter_scx_dsq_destroy(&it);
+
+	afford = total <= pool;
+
+	/*
+	 * Cannot pay: exile the priced members to STARVED, φ-ordered as in
+	 * auction_try_round, so the gang does not jump the class auction.
+	 */
+	if (!afford) {
+		if (!bpf_iter_scx_dsq_new(&it, gdsq, 0)) {
+			u32 i;
+
+			bpf_for(i, 0, GANG_MAX_LAUNCH) {
+				p = bpf_iter_scx_dsq_next(&it);
+				if (!p)
+					break;
+				t = get_task_ctx(p, false);
+				if (!t)
+					continue;
+				scx_bpf_dsq_move_set_vtime(&it,
+						encode_phi(t->phi_enq));
+				if (scx_bpf_dsq_move_vtime(&it, p,
+						AUCTION_DSQ_STARVED, 0))
+					t->starved_since_ns = now;
+			}
+		}
+		bpf_iter_scx_dsq_destroy(&it);
+		goto out;
+	}
+
+	/* Pass 2 — place and charge. */
+	n = 0;
+	if (!bpf_iter_scx_dsq_new(&it, gdsq, 0)) {
+		u32 i;
+
+		bpf_for(i, 0, GANG_MAX_LAUNCH) {
+			u64 charge;
+			s32 dst = -1;
+
+			p = bpf_iter_scx_dsq_next(&it);
+			if (!p)
+				break;
+			t = get_task_ctx(p, false);
+			if (!t)
+				continue;
+
+			if (!self_used &&
+			    bpf_cpumask_test_cpu((u32)cpu, p->cpus_ptr))
+				dst = cpu;
+			else
+				dst = gang_claim_idle(p->cpus_ptr, cls);
+			if (dst < 0)
+				continue;
+
+			charge = pool ? total * t->budget / pool : 0;
+			t->budget = t->budget > charge ? t->budget - charge : 0;
+			paid += charge;
+
+			if (dst == cpu) {
+				scx_bpf_dsq_move(&it, p, SCX_DSQ_LOCAL, 0);
+				self_used = true;
+			} else {
+				scx_bpf_dsq_move(&it, p,
+						 SCX_DSQ_LOCAL_ON | (u64)dst, 0);
+				scx_bpf_kick_cpu(dst, SCX_KICK_IDLE);
+			}
+			n++;
+		}
+	}
+	bpf_iter_scx_dsq_destroy(&it);
+
+	if (n) {
+		__sync_fetch_and_add(&gr->launches, 1);
+		__sync_fetch_and_add(&gr->members_launched, n);
+		__sync_fetch_and_add(&gr->paid, paid);
+	}
+out:
+	/* Stragglers start a fresh wait, with a wake-up at its end. */
+	gr->wait_since_ns = scx_bpf_dsq_nr_queued(gdsq) ? now : 0;
+	if (gr->wait_since_ns)
+		gang_arm(slot, cls);
+
+	return self_used;
+}
+
+/*
+ * Phase-2 steal from class `src`: move the first of the MIG_STEAL_SCAN head
+ * tasks that may run on `cpu` and whose migration cost does not exceed
+ * `wait_ns`, the time it would otherwise spend queued on `src`.  A task
+ * last run on `cpu` itself is never hot elsewhere.
+ */
+static __always_inline bool
+steal_cold(u32 src, s32 cpu, u64 wait_ns, u64 now)
+{
+	struct bpf_iter_scx_dsq it;
+	struct task_struct *p;
+	struct auction_task_ctx *t;
+	bool moved = false;
+	/* This LLC already carries a stream: leave the next to a quieter one. */
+	bool crowded = membw_thresh &&
+		       llc_mem_of(cpu_llc_of((u32)cpu)) >= membw_thresh;
+	u32 i;
+
+	if (!bpf_iter_scx_dsq_new(&it, AUCTION_DSQ_CLASS_BASE + src, 0)) {
+		bpf_for(i, 0, MIG_STEAL_SCAN) {
+			p = bpf_iter_scx_dsq_next(&it);
+			if (!p)
+				break;
+			if (!bpf_cpumask_test_cpu((u32)cpu, p->cpus_ptr))
+				continue;
+			t = get_task_ctx(p, false);
+			if (t && scx_bpf_task_cpu(p) != cpu &&
+			    mig_cost_ns(t, now) > wait_ns) {
+				stat_inc(STAT_MIG_HOLD);
+				continue;
+			}
+			if (crowded && t && membw_bound(t)) {
+				stat_inc(STAT_MEMBW_HOLD);
+				continue;
+			}
+			if (scx_bpf_dsq_move(&it, p, SCX_DSQ_LOCAL, 0)) {
+				moved = true;
+				break;
+			}
+		}
+	}
+	bpf_iter_scx_dsq_destroy(&it);
+	return moved;
+}
+
+/*
+ * Central mode: anything queued that the central CPU should place?  Gang
+ * DSQs are launched by the consumers themselves and do not count.
+ */
+static __always_inline bool
+central_backlog(u32 nr)
+{
+	u32 k;
+
+	if (scx_bpf_dsq_nr_queued(AUCTION_DSQ_STARVED))
+		return true;
+	bpf_for(k, 0, NR_CLASSES_MAX) {
+		if (k >= nr)
+			break;
+		if (scx_bpf_dsq_nr_queued(AUCTION_DSQ_CLASS_BASE + k))
+			return true;
+	}
+	return false;
+}
+
+/* Wake a CPU just handed work; one running only SCHED_IDLE is preempted. */
+static __always_inline void
+central_kick(s32 cpu)
+{
+	u32 key = (u32)cpu;
+	u8 *busy_idle = bpf_map_lookup_elem(&cpu_runs_idle_class, &key);
+
+	scx_bpf_kick_cpu(cpu, busy_idle && *busy_idle ? SCX_KICK_PREEMPT
+						       : SCX_KICK_IDLE);
+}
+
+/*
+ * Clear one auction of `units` CPUs (the set bits of *free) over `dsq`.
+ * Demand is one unit per task, and with interchangeable units VCG would
+ * give the top `units` bids in φ order, each paying vcg_payment against
+ * the (units + 1)-th bid.  This is an approximation of that: the price is
+ * fixed from the queue before placement, so a bid skipped for affinity or
+ * exiled to STARVED over budget (as in auction_try_round; the unit passes
+ * down the queue) does not move it, and the CPUs are not interchangeable.
+ * Unpriced (`priced` false) it is plain work conservation: the first
+ * `units` tasks that fit, no payment.
+ *
+ * Each winner takes the lowest free CPU in its affinity; a task with none
+ * stays queued without taking a unit.  Returns the CPUs filled.
+ */
+static __always_inline u32
+central_fill(u64 dsq, u64 *free, u32 units, u64 w_bar, bool priced)
+{
+	struct bpf_iter_scx_dsq it;
+	struct task_struct *p;
+	struct auction_task_ctx *t;
+	s64 phi_clear = 0;
+	u32 m_clear = 0, filled = 0, i;
+
+	if (priced && scx_bpf_dsq_nr_queued(dsq) > units) {
+		if (!bpf_iter_scx_dsq_new(&it, dsq, 0)) {
+			bpf_for(i, 0, AUCTION_NCPU_MAX + 1) {
+				p = bpf_iter_scx_dsq_next(&it);
+				if (!p)
+					break;
+				if (i < units)
+					continue;
+				t = get_task_ctx(p, false);
+				if (t) {
+					phi_clear = t->phi_enq;
+					m_clear   = t->m_enq;
+				}
+				break;
+			}
+		}
+		bpf_iter_scx_dsq_destroy(&it);
+	}
+
+	if (!bpf_iter_scx_dsq_new(&it, dsq, 0)) {
+		bpf_for(i, 0, 2 * AUCTION_NCPU_MAX) {
+			s32 dst = -1, c;
+
+			if (filled >= units || !*free)
+				break;
+			p = bpf_iter_scx_dsq_next(&it);
+			if (!p)
+				break;
+			bpf_for(c, 0, AUCTION_NCPU_MAX) {
+				if ((*free & (1ULL << c)) &&
+				    bpf_cpumask_test_cpu(c, p->cpus_ptr)) {
+					dst = c;
+					break;
+				}
+			}
+			if (dst < 0)
+				continue;
+
+			t = get_task_ctx(p, false);
+			if (priced && t) {
+				s64 pay = vcg_payment(phi_clear, m_clear,
+						      t->m_enq, w_bar);
+				u64 charge = pay > 0 ? (u64)pay : 0;
+
+				if (charge > t->budget) {
+					scx_bpf_dsq_move_set_vtime(&it,
+							encode_phi(t->phi_enq));
+					if (scx_bpf_dsq_move_vtime(&it, p,
+							AUCTION_DSQ_STARVED, 0))
+						t->starved_since_ns =
+							bpf_ktime_get_ns();
+					continue;
+				}
+				t->budget -= charge;
+			}
+			if (!scx_bpf_dsq_move(&it, p,
+					      SCX_DSQ_LOCAL_ON | (u64)dst, 0))
+				continue;
+			*free &= ~(1ULL << dst);
+			filled++;
+			central_kick(dst);
+		}
+	}
+	bpf_iter_scx_dsq_destroy(&it);
+	return filled;
+}
+
+/*
+ * Central round.  A CPU is free when it runs no auction task and has
+ * nothing in its local or sticky DSQ; free CPUs are grouped by class and
+ * each class's auction is cleared against its own \bar W_κ.  CPUs still
+ * free afterwards take whatever fits from the other classes, nearest
+ * first as Phase 2 does, then STARVED, unpriced.
+ */
+static __always_inline void
+central_dispatch(u32 nr)
+{
+	struct auction_runtime *rt = get_rt();
+	const struct cpumask *online;
+	u64 free[NR_CLASSES_MAX] = {};
+	u32 units[NR_CLASSES_MAX] = {};
+	u32 ncpu = scx_bpf_nr_cpu_ids();
+	u32 k, d;
+	s32 c;
+
+	if (!rt)
+		return;
+
+	online = scx_bpf_get_online_cpumask();
+	bpf_for(c, 0, AUCTION_NCPU_MAX) {
+		u32 key = (u32)c;
+		struct cpu_run *cr;
+
+		if (key >= ncpu)
+			break;
+		if (c == central_cpu || !bpf_cpumask_test_cpu(key, online))
+			continue;
+		cr = bpf_map_lookup_elem(&cpu_run, &key);
+		if (!cr || cr->busy ||
+		    scx_bpf_dsq_nr_queued(SCX_DSQ_LOCAL_ON | (u64)key) ||
+		    scx_bpf_dsq_nr_queued(AUCTION_DSQ_PERCPU_BASE + key))
+			continue;
+		k = cpu_class_of(key);
+		if (k >= nr)
+			k = nr - 1;
+		k &= CLASS_MASK;
+		free[k] |= 1ULL << c;
+		units[k]++;
+	}
+	scx_bpf_put_cpumask(online);
+
+	bpf_for(k, 0, NR_CLASSES_MAX) {
+		if (k >= nr)
+			break;
+		if (units[k])
+			units[k] -= central_fill(AUCTION_DSQ_CLASS_BASE + k,
+						 &free[k], units[k],
+						 rt->w_bar[k], true);
+	}
+
+	bpf_for(k, 0, NR_CLASSES_MAX) {
+		if (k >= nr)
+			break;
+		bpf_for(d, 1, NR_CLASSES_MAX) {
+			u32 src;
+
+			if (!units[k])
+				break;
+			if (d <= k) {
+				src = (k - d) & CLASS_MASK;
+				units[k] -= central_fill(
+					AUCTION_DSQ_CLASS_BASE + src,
+					&free[k], units[k], 0, false);
+			}
+			if (units[k] && k + d < nr) {
+				src = (k + d) & CLASS_MASK;
+				units[k] -= central_fill(
+					AUCTION_DSQ_CLASS_BASE + src,
+					&free[k], units[k], 0, false);
+			}
+		}
+		if (units[k])
+			units[k] -= central_fill(AUCTION_DSQ_STARVED, &free[k],
+						 units[k], 0, false);
 	}
+	stat_inc(STAT_CENTRAL_ROUND);
+}
 
-	payment = vcg_payment(phi_runner, m_runner, m_top, w_bar);
-
-	/*
-	 * Budget check (theory §2.4, Proposition 1).
-	 * Negative payments are clamped to zero: VCG never credits budget.
-	 */
-	if (payment <= 0 || (u64)payment <= t_top->budget) {
-		u64 charge = payment > 0 ? (u64)payment : 0;
-		if (t_top->budget >= charge)
-			t_top->budget -= charge;
-		else
-			t_top->budget = 0;
-		/*
-		 * SCX_DSQ_LOCAL is a built-in per-CPU FIFO queue — kernel
-		 * rejects vtime ordering on it, so the bare move() is correct.
-		 */
-		scx_bpf_dsq_move(&it, p_top, SCX_DSQ_LOCAL, 0);
-		dispatched = true;
-	} else {
-		/*
-		 * Cannot afford the auction — exile to STARVED.
-		 *
-		 * STARVED was populated by enqueue via scx_bpf_dsq_insert_vtime
-		 * (PRIQ mode).  A bare scx_bpf_dsq_move() would FIFO-insert and
-		 * crash with "DSQ already had PRIQ-enqueued tasks".  Preserve the
-		 * task's φ-encoded vtime so STARVED stays φ-ordered: least-bad
-		 * task gets pulled first when budget recovers.
-		 */
-		scx_bpf_dsq_move_set_vtime(&it, p_top->scx.dsq_vtime);
-		scx_bpf_dsq_move_vtime(&it, p_top, AUCTION_DSQ_STARVED, 0);
-	}
+/* Backstop: kicks to the central CPU are dropped while it is busy. */
+static int
+central_timerfn(void *map, int *key, struct bpf_timer *timer)
+{
+	struct auction_ctx *gdata = get_ctx();
 
-out:
-	bpf_iter_scx_dsq_destroy(&it);
-	return dispatched;
+	if (gdata && central_backlog(nr_classes_of(gdata)))
+		scx_bpf_kick_cpu(central_cpu, SCX_KICK_PREEMPT);
+	bpf_timer_start(timer, CENTRAL_PERIOD_NS, 0);
+	return 0;
 }
 
 void
 BPF_STRUCT_OPS(auction_dispatch, s32 cpu, struct task_struct *prev)
 {
-	struct auction_runtime *rt = get_rt();
-	bool is_p;
-	u64 self_dsq, other_dsq, w_bar_self;
+	struct auction_ctx     *gdata = get_ctx();
+	struct auction_runtime *rt    = get_rt();
+	u32 self, nr, d;
+	u64 self_dsq, w_bar_self, now;
 	int attempt;
 
-	if (!rt)
+	if (!gdata || !rt)
 		return;
 
-	is_p = cpu_is_p_type((u32)cpu);
+	nr   = nr_classes_of(gdata);
+	self = cpu_class_of((u32)cpu);
+	if (self >= nr)
+		self = nr - 1;
+	self &= CLASS_MASK;
+
+	/* Central mode: the central CPU only runs rounds (and its pinned work). */
+	if (cpu == central_cpu) {
+		central_dispatch(nr);
+		return;
+	}
 
 	/*
 	 * Phase 0 — per-CPU sticky DSQ.  Long-running preempted tasks live
@@ -795,18 +2907,40 @@ BPF_STRUCT_OPS(auction_dispatch, s32 cpu, struct task_struct *prev)
 	    scx_bpf_dsq_move_to_local(AUCTION_DSQ_PERCPU_BASE + (u64)cpu, 0))
 		return;
 
-	if (is_p) {
-		self_dsq    = AUCTION_DSQ_P;
-		other_dsq   = AUCTION_DSQ_E;
-		w_bar_self  = rt->w_bar_p;
-	} else {
-		self_dsq    = AUCTION_DSQ_E;
-		other_dsq   = AUCTION_DSQ_P;
-		w_bar_self  = rt->w_bar_e;
+	self_dsq   = AUCTION_DSQ_CLASS_BASE + self;
+	w_bar_self = rt->w_bar[self];
+
+	/*
+	 * Phase 0.5 — gang launches.  Ahead of the class auction: a gang
+	 * that has gathered its members is priced against the class head
+	 * (see gang_try_launch), so it only jumps the queue if it pays for
+	 * every quantum it displaces.
+	 */
+	if (nr_gangs) {
+		u32 g;
+
+		bpf_for(g, 0, GANG_MAX) {
+			if (g >= nr_gangs)
+				break;
+			if (gang_try_launch(g, cpu, self, self_dsq, w_bar_self))
+				return;
+		}
+	}
+
+	/*
+	 * Central mode: a consumer never touches the shared DSQs.  Out of
+	 * work, it asks for a round; SCHED_IDLE only when there is none.
+	 */
+	if (central_cpu >= 0) {
+		if (central_backlog(nr))
+			scx_bpf_kick_cpu(central_cpu, SCX_KICK_IDLE);
+		else
+			scx_bpf_dsq_move_to_local(AUCTION_DSQ_IDLE, 0);
+		return;
 	}
 
 	/*
-	 * Phase 1 — auction on the local cluster.  Run up to N rounds: each
+	 * Phase 1 — auction on the local class.  Run up to N rounds: each
 	 * losing round (STARVED exile) consumes the current top, so the next
 	 * round operates on the previous runner-up.  Bounded by
 	 * DISPATCH_AUCTION_TRIES for the BPF verifier.  Fast-path: when there
@@ -830,15 +2964,31 @@ BPF_STRUCT_OPS(auction_dispatch, s32 cpu, struct task_struct *prev)
 	}
 
 	/*
-	 * Phase 2 — cross-cluster steal (theory §2.4 work-conservation:
-	 * an unused quantum is lost forever).  Use the plain FIFO drain on
-	 * the foreign DSQ — the auction was already evaluated when those
-	 * tasks were enqueued for THAT cluster, so re-running VCG with the
-	 * wrong \bar W_κ would introduce noise.  move_to_local skips tasks
-	 * incompatible with the calling CPU's affinity automatically.
+	 * Phase 2 — cross-class steal (theory §2.4 work-conservation:
+	 * an unused quantum is lost forever).  No VCG on the foreign DSQ —
+	 * the auction was already evaluated when those tasks were enqueued
+	 * for THAT class, so re-running it with the wrong \bar W_κ would
+	 * introduce noise.  Take the first task, in φ order, that may run
+	 * here and is not cache-hot enough to prefer its own queue
+	 * (steal_cold).
+	 *
+	 * Nearest classes first, the stronger neighbour before the weaker:
+	 * work queued for a faster class loses the least by running one tier
+	 * down, and a weaker class's backlog is what spill already feeds.
 	 */
-	if (scx_bpf_dsq_move_to_local(other_dsq, 0))
-		return;
+	now = bpf_ktime_get_ns();
+	bpf_for(d, 1, NR_CLASSES_MAX) {
+		if (homogeneous)
+			break;
+		if (d <= self &&
+		    steal_cold(self - d, cpu, class_wait_ns(gdata, self - d, nr),
+			       now))
+			return;
+		if (self + d < nr &&
+		    steal_cold(self + d, cpu, class_wait_ns(gdata, self + d, nr),
+			       now))
+			return;
+	}
 
 	/*
 	 * Phase 3 — STARVED queue.  Bypasses the VCG check entirely:
@@ -846,13 +2996,150 @@ BPF_STRUCT_OPS(auction_dispatch, s32 cpu, struct task_struct *prev)
 	 * idle-time replenishment.  Plain head-of-queue FIFO via the
 	 * DSQ's own vtime ordering (φ at enqueue moment).
 	 */
-	scx_bpf_dsq_move_to_local(AUCTION_DSQ_STARVED, 0);
+	if (scx_bpf_dsq_move_to_local(AUCTION_DSQ_STARVED, 0))
+		return;
+
+	/* Phase 4 — SCHED_IDLE: nothing else wanted this CPU. */
+	if (scx_bpf_dsq_move_to_local(AUCTION_DSQ_IDLE, 0))
+		return;
+
+	/*
+	 * Phase 5 — about to idle.  A favoured core pulls the best task off
+	 * a slower P-core rather than sit empty next to it.  Not while prev
+	 * keeps the CPU: the pulled task would find no idle target.
+	 */
+	if (gdata->prefcore && !self &&
+	    !(prev && (prev->scx.flags & SCX_TASK_QUEUED)))
+		prefcore_pull(cpu);
 }
 
 void
 BPF_STRUCT_OPS(auction_running, struct task_struct *p)
 {
-	(void)p;
+	u32 cpu = bpf_get_smp_processor_id();
+	u8 *busy_idle = bpf_map_lookup_elem(&cpu_runs_idle_class, &cpu);
+	struct cpu_run *cr = bpf_map_lookup_elem(&cpu_run, &cpu);
+	struct auction_task_ctx *tctx;
+
+	if (busy_idle)
+		*busy_idle = p->policy == SCHED_IDLE;
+
+	tctx = get_task_ctx(p, false);
+	if (cr) {
+		cr->phi  = tctx ? tctx->phi_enq : 0;
+		cr->busy = p->policy != SCHED_IDLE;
+		cr->pid  = (u32)p->pid;
+	}
+
+	if (tctx) {
+		starved_fold(tctx, bpf_ktime_get_ns());
+		tctx->sticky = 0;
+	}
+
+	/* Deadline order: V_κ advances to the vtime of the task starting. */
+	if (order_mode != A1349_ORDER_PHI && tctx && p->policy != SCHED_IDLE) {
+		struct auction_runtime *rt = get_rt();
+		u32 cls = tctx->cls & CLASS_MASK;
+
+		if (rt && tctx->vtime > rt->vtime_now[cls])
+			rt->vtime_now[cls] = tctx->vtime;
+	}
+
+	/*
+	 * Publish the grant before looking for competition.  The xchg is the
+	 * full barrier between the inf store and lone_runner()'s loads: an
+	 * enqueue racing with us either sees inf set and revokes, or is seen
+	 * here.  Count the holder first so inf_revoke() cannot skip it.
+	 */
+	if (cr && tctx && p->policy != SCHED_IDLE) {
+		struct auction_ctx *gdata = get_ctx();
+		struct auction_runtime *rt = get_rt();
+
+		if (gdata && rt) {
+			__sync_fetch_and_add(&rt->nr_inf, 1);
+			__sync_lock_test_and_set(&cr->inf, 1);
+			if (lone_runner(cpu, nr_classes_of(gdata))) {
+				p->scx.slice       = SCX_SLICE_INF;
+				tctx->inf_since_ns = bpf_ktime_get_ns();
+				stat_inc(STAT_SLICE_INF);
+			} else {
+				inf_clear(cr);
+			}
+		}
+	}
+
+	if (membw_thresh && tctx && tctx->mem_rate) {
+		u32 llc = cpu_llc_of(cpu);
+		u64 *m = bpf_map_lookup_elem(&llc_mem, &llc);
+
+		if (m) {
+			__sync_fetch_and_add(m, tctx->mem_rate);
+			tctx->mem_charged = tctx->mem_rate;
+			tctx->mem_llc     = (u8)llc;
+		}
+	}
+
+	/*
+	 * Queueing delay for consolidation: once the pack set makes tasks
+	 * wait, spread again until the agent re-sizes it.
+	 */
+	if (pack_enabled && tctx && tctx->enq_ns) {
+		struct auction_runtime *rt = get_rt();
+		u64 now = bpf_ktime_get_ns();
+		u64 wait = now > tctx->enq_ns ? now - tctx->enq_ns : 0;
+
+		tctx->enq_ns = 0;
+		if (rt) {
+			rt->wait_ewma_ns = (rt->wait_ewma_ns * 7 + wait) >> 3;
+			if (rt->wait_ewma_ns > PACK_DELAY_NS &&
+			    now >= rt->pack_backoff_until_ns) {
+				rt->pack_backoff_until_ns = now + PACK_BACKOFF_NS;
+				stat_inc(STAT_PACK_BACKOFF);
+			}
+		}
+	}
+}
+
+/*
+ * NO_PREEMPT hint: the kernel has just charged the tick and is about to
+ * reschedule if the slice ran dry.  Re-read the hint live (critical
+ * sections are far shorter than an enqueue-to-enqueue interval) and top
+ * the slice up once per run.  stopping() folds slice_ext_ns back into the
+ * granted slice so the consumed-time accounting stays exact.  A boosted
+ * lock holder gets the same single extension.
+ */
+void
+BPF_STRUCT_OPS(auction_tick, struct task_struct *p)
+{
+	struct auction_task_ctx *tctx;
+	u32 hints;
+
+	/* Backstop for a revoke that raced the grant. */
+	if (p->scx.slice == SCX_SLICE_INF) {
+		struct auction_ctx *gdata = get_ctx();
+		u32 cpu = bpf_get_smp_processor_id();
+		struct cpu_run *cr = bpf_map_lookup_elem(&cpu_run, &cpu);
+
+		if (gdata && !lone_runner(cpu, nr_classes_of(gdata))) {
+			p->scx.slice = 0;
+			if (cr)
+				inf_clear(cr);
+		}
+		return;
+	}
+
+	if ((!tld_hints_enabled && !futex_boost_enabled) || p->scx.slice)
+		return;
+
+	tctx = get_task_ctx(p, false);
+	if (!tctx || tctx->slice_ext_ns)
+		return;
+
+	hints = task_hints(p) | boost_hints(tctx, bpf_ktime_get_ns());
+	if (hints & A1349_HINT_NO_PREEMPT) {
+		p->scx.slice        = HINT_SLICE_EXT_NS;
+		tctx->slice_ext_ns  = HINT_SLICE_EXT_NS;
+	}
 }
 
 void
@@ -864,31 +3151,89 @@ BPF_STRUCT_OPS(auction_stopping, struct task_struct *p, bool runnable)
 	u64 slice_granted, consumed;
 	u64 phi_realised, w_bar_new;
 	u64 *w_bar_slot;
-	bool on_p;
 
 	if (!gdata || !rt || !tctx)
 		return;
 
-	slice_granted = tctx->long_slice ? AUCTION_SLICE_E : AUCTION_SLICE_P;
+	{
+		u32 cpu = bpf_get_smp_processor_id();
+		u8 *busy_idle = bpf_map_lookup_elem(&cpu_runs_idle_class, &cpu);
+		struct cpu_run *cr = bpf_map_lookup_elem(&cpu_run, &cpu);
+
+		if (busy_idle && p->policy == SCHED_IDLE)
+			*busy_idle = 0;
+		if (cr) {
+			cr->busy = 0;
+			inf_clear(cr);
+			/* Went to sleep before the kick landed. */
+			if (!runnable)
+				cr->pull_to = 0;
+		}
+	}
+	/* A burst child that sleeps before exec'ing has settled where it is. */
+	if (!runnable)
+		tctx->spawn &= ~SPAWN_SPREAD;
+
+	slice_granted = tctx->slice_ns ?: AUCTION_SLICE_P;
+	slice_granted += tctx->slice_ext_ns;
+	tctx->slice_ext_ns = 0;
 	consumed      = slice_granted > p->scx.slice
 			? slice_granted - p->scx.slice : 0;
+	/* An infinite slice never counts down: time the run instead. */
+	if (tctx->inf_since_ns) {
+		u64 now = bpf_ktime_get_ns();
+
+		consumed = now > tctx->inf_since_ns ? now - tctx->inf_since_ns : 0;
+		tctx->inf_since_ns = 0;
+	}
+
+	if (order_mode != A1349_ORDER_PHI)
+		tctx->vtime += consumed * 100 / (tctx->weight_cached ?: 1);
+
+	/* Memory intensity: release this run's llc_mem share, resample. */
+	if (membw_thresh) {
+		u64 miss;
+
+		if (tctx->mem_charged) {
+			u32 llc = tctx->mem_llc & (LLC_MAX - 1);
+			u64 *m = bpf_map_lookup_elem(&llc_mem, &llc);
+
+			if (m)
+				__sync_fetch_and_sub(m, tctx->mem_charged);
+			tctx->mem_charged = 0;
+		}
+		tctx->mem_run_ns += consumed;
+		if (tctx->mem_run_ns >= MEMBW_SAMPLE_NS &&
+		    !scx_pmu_read(p, A1349_PMU_LLC_MISS, &miss, true)) {
+			u64 rate = miss * 1000000 / tctx->mem_run_ns;
+
+			if (rate > 0xffffffffULL)
+				rate = 0xffffffffULL;
+			tctx->mem_rate   = (u32)((3ULL * tctx->mem_rate + rate) >> 2);
+			tctx->mem_run_ns = 0;
+		}
+	}
 
 	/*
 	 * \bar W_κ update (architecture.md §5).  Realised contribution of
 	 * this run = |φ_κ| · (consumed / SLICE_P), capped at |φ| to bound
-	 * the EWMA input even on E-cores that ran a longer slice.  The
+	 * the EWMA input even on weaker classes that ran a longer slice.  The
 	 * absolute value keeps \bar W ≥ 0, matching its role as expected
 	 * future welfare — a noisy φ < 0 sample (rare: STARVED routing
 	 * filters these) does not subtract credit from a healthy cluster.
 	 */
-	on_p = tctx->on_p_type != 0;
-	{
+	if (p->policy != SCHED_IDLE) {
 		s64 phi = tctx->phi_enq;
 		u64 phi_abs = phi >= 0 ? (u64)phi : (u64)(-phi);
-		/* phi_abs · consumed / SLICE_P, with consumed ≤ slice_granted. */
-		phi_realised = phi_abs * consumed / AUCTION_SLICE_P;
+		/*
+		 * phi_abs · consumed / SLICE_P, with consumed ≤ slice_granted
+		 * (an infinite-slice run counts as one granted slice).
+		 */
+		phi_realised = phi_abs *
+			       (consumed < slice_granted ? consumed : slice_granted) /
+			       AUCTION_SLICE_P;
 
-		w_bar_slot = on_p ? &rt->w_bar_p : &rt->w_bar_e;
+		w_bar_slot = &rt->w_bar[tctx->cls & CLASS_MASK];
 		w_bar_new  = ((*w_bar_slot) * (W_BAR_EWMA_DEN - 1) + phi_realised)
 			     / W_BAR_EWMA_DEN;
 		*w_bar_slot = w_bar_new;
@@ -912,8 +3257,9 @@ BPF_STRUCT_OPS(auction_stopping, struct task_struct *p, bool runnable)
 	 * a CPU-bound task that is constantly preempted would never accrue
 	 * replenishment.
 	 */
+	tctx->last_ran_ns = bpf_ktime_get_ns();
 	if (!runnable)
-		tctx->last_stop_ns = bpf_ktime_get_ns();
+		tctx->last_stop_ns = tctx->last_ran_ns;
 }
 
 s32
@@ -956,11 +3302,31 @@ BPF_STRUCT_OPS(auction_enable, struct task_struct *p)
 	tctx->budget        = tctx->budget_max;          /* fully funded at admission */
 	tctx->len_est_ns    = AUCTION_SLICE_P;           /* one P-quantum prior       */
 	tctx->last_stop_ns  = 0;
+	tctx->last_ran_ns   = 0;
+	tctx->enq_ns        = 0;
+	task_rule(p, &tctx->rule);
 	tctx->wake_prev_cpu = -1;
 	tctx->phi_enq       = 0;
 	tctx->m_enq         = 0;
-	tctx->on_p_type     = 0;
-	tctx->long_slice    = 0;
+	tctx->cls           = 0;
+	tctx->slice_ns      = AUCTION_SLICE_P;
+	tctx->hints         = 0;
+	tctx->slice_ext_ns  = 0;
+	tctx->futex_uaddr   = 0;
+	tctx->futex_nr      = 0;
+	tctx->boost_until_ns = 0;
+	tctx->spawn_win_ns  = 0;
+	tctx->spawn_nr      = 0;
+	tctx->spawn         = 0;
+	tctx->mem_run_ns    = 0;
+	tctx->mem_rate      = 0;
+	tctx->mem_charged   = 0;
+	tctx->mem_llc       = 0;
+	tctx->inf_since_ns  = 0;
+	tctx->vtime         = 0;
+	tctx->starved_since_ns = 0;
+	tctx->starved_ns    = 0;
+	tctx->sticky        = 0;
 }
 
 void
@@ -974,41 +3340,339 @@ BPF_STRUCT_OPS(auction_disable, struct task_struct *p)
 	bpf_task_storage_delete(&task_ctx_map, p);
 }
 
+/* ── futex tracing (attached by userspace only with -f) ─────────────────── */
+
+static __always_inline bool
+futex_cmd_waits(u32 cmd)
+{
+	return cmd == FUTEX_WAIT || cmd == FUTEX_WAIT_BITSET ||
+	       cmd == FUTEX_WAIT_REQUEUE_PI || cmd == FUTEX_LOCK_PI ||
+	       cmd == FUTEX_LOCK_PI2;
+}
+
+/*
+ * PI owner boost.  The futex word carries the owner's TID, so the holder is
+ * known exactly — no need to wait for it to be woken.  The word is read
+ * without faulting; a page that was just touched by the waiter is resident
+ * in all but pathological cases, and a failed read simply skips the boost.
+ *
+ * The TID is in the waiter's pid namespace while bpf_task_from_pid()
+ * resolves in the initial one, and the word is user memory anyone can
+ * forge through FUTEX_LOCK_PI.  So waiters in a child namespace are
+ * skipped, and the owner must be a thread of the waiter's own process.
+ */
+static __always_inline void
+futex_boost_pi_owner(u64 uaddr, u32 waiters, u64 now)
+{
+	struct task_struct *cur = bpf_get_current_task_btf();
+	struct auction_task_ctx *otctx;
+	struct task_struct *owner;
+	u32 val = 0;
+
+	if (waiters < FUTEX_BOOST_MIN_WAITERS)
+		return;
+	if (cur->thread_pid->level)
+		return;
+	if (bpf_probe_read_user(&val, sizeof(val), (void *)uaddr))
+		return;
+	if (!(val & FUTEX_TID_MASK))
+		return;
+
+	owner = bpf_task_from_pid((s32)(val & FUTEX_TID_MASK));
+	if (!owner)
+		return;
+	if (owner->tgid == cur->tgid) {
+		otctx = get_task_ctx(owner, false);
+		if (otctx)
+			boost_grant(otctx, now, STAT_FUTEX_BOOST_PI);
+	}
+	bpf_task_release(owner);
+}
+
+/* Count the current task as parked on `uaddr`; the waiters there now. */
+static __always_inline u32
+futex_park(u64 uaddr, u32 tgid)
+{
+	struct futex_key key = { .uaddr = uaddr, .tgid = tgid };
+	u32 one = 1, *cnt;
+
+	cnt = bpf_map_lookup_elem(&futex_waiters, &key);
+	if (cnt)
+		return __sync_add_and_fetch(cnt, 1);
+	bpf_map_update_elem(&futex_waiters, &key, &one, BPF_NOEXIST);
+	return 1;
+}
+
+/* Undo futex_park(); the waiters still parked on `uaddr`. */
+static __always_inline u32
+futex_unpark(u64 uaddr, u32 tgid)
+{
+	struct futex_key key = { .uaddr = uaddr, .tgid = tgid };
+	u32 *cnt, left = 0;
+
+	cnt = bpf_map_lookup_elem(&futex_waiters, &key);
+	if (cnt && *cnt) {
+		left = __sync_sub_and_fetch(cnt, 1);
+		if (!left)
+			bpf_map_delete_elem(&futex_waiters, &key);
+	}
+	return left;
+}
+
+SEC("tracepoint/syscalls/sys_enter_futex")
+int a1349_futex_enter(struct trace_event_raw_sys_enter *ctx)
+{
+	struct task_struct *p = bpf_get_current_task_btf();
+	struct auction_task_ctx *tctx;
+	u32 cmd = (u32)ctx->args[1] & FUTEX_CMD_MASK;
+	u64 uaddr = ctx->args[0];
+	u32 waiters;
+
+	if (!futex_boost_enabled || !futex_cmd_waits(cmd))
+		return 0;
+
+	tctx = get_task_ctx(p, false);
+	if (!tctx)
+		return 0;
+
+	waiters = futex_park(uaddr, (u32)p->tgid);
+	tctx->futex_uaddr = uaddr;
+	tctx->futex_nr    = 0;
+
+	if (cmd == FUTEX_LOCK_PI || cmd == FUTEX_LOCK_PI2)
+		futex_boost_pi_owner(uaddr, waiters, bpf_ktime_get_ns());
+	return 0;
+}
+
+/*
+ * futex_waitv(): the task is parked on every word of the vector at once.
+ * The vector stays mapped for the whole syscall, so the exit side reads
+ * it again rather than keeping a copy per task.
+ */
+SEC("tracepoint/syscalls/sys_enter_futex_waitv")
+int a1349_futex_waitv_enter(struct trace_event_raw_sys_enter *ctx)
+{
+	struct task_struct *p = bpf_get_current_task_btf();
+	struct auction_task_ctx *tctx;
+	struct a1349_futex_waitv w;
+	u64 vec = ctx->args[0];
+	u32 nr = (u32)ctx->args[1], n = 0, i;
+
+	if (!futex_boost_enabled || !vec)
+		return 0;
+
+	tctx = get_task_ctx(p, false);
+	if (!tctx)
+		return 0;
+
+	bpf_for(i, 0, FUTEX_WAITV_SCAN) {
+		if (i >= nr ||
+		    bpf_probe_read_user(&w, sizeof(w), (void *)(vec + i * sizeof(w))))
+			break;
+		futex_park(w.uaddr, (u32)p->tgid);
+		n++;
+	}
+	if (n) {
+		tctx->futex_uaddr = vec;
+		tctx->futex_nr    = (u8)n;
+	}
+	return 0;
+}
+
+/*
+ * Exit side of a traced wait.  `woken` is 0 if it timed out or was
+ * interrupted, else 1 + the index of the word that woke it (1 for futex()).
+ */
+static __always_inline void
+futex_wait_done(struct auction_task_ctx *tctx, u32 tgid, u64 woken)
+{
+	struct a1349_futex_waitv w;
+	u64 vec = tctx->futex_uaddr;
+	u32 nr = tctx->futex_nr, left = 0, l, i;
+
+	tctx->futex_uaddr = 0;
+	tctx->futex_nr    = 0;
+
+	if (!nr) {
+		left = futex_unpark(vec, tgid);
+	} else {
+		bpf_for(i, 0, FUTEX_WAITV_SCAN) {
+			if (i >= nr ||
+			    bpf_probe_read_user(&w, sizeof(w),
+						(void *)(vec + i * sizeof(w))))
+				break;
+			l = futex_unpark(w.uaddr, tgid);
+			if (i == woken - 1)
+				left = l;
+		}
+	}
+
+	/* Woken (not timed out / interrupted) with a queue still behind us. */
+	if (woken && left >= FUTEX_BOOST_MIN_WAITERS)
+		boost_grant(tctx, bpf_ktime_get_ns(), STAT_FUTEX_BOOST);
+}
+
+SEC("tracepoint/syscalls/sys_exit_futex")
+int a1349_futex_exit(struct trace_event_raw_sys_exit *ctx)
+{
+	struct task_struct *p = bpf_get_current_task_btf();
+	struct auction_task_ctx *tctx;
+
+	if (!futex_boost_enabled)
+		return 0;
+
+	tctx = get_task_ctx(p, false);
+	if (!tctx || !tctx->futex_uaddr)
+		return 0;
+
+	futex_wait_done(tctx, (u32)p->tgid, ctx->ret == 0);
+	return 0;
+}
+
+/* futex_waitv() returns the index of the word that woke it. */
+SEC("tracepoint/syscalls/sys_exit_futex_waitv")
+int a1349_futex_waitv_exit(struct trace_event_raw_sys_exit *ctx)
+{
+	struct task_struct *p = bpf_get_current_task_btf();
+	struct auction_task_ctx *tctx;
+
+	if (!futex_boost_enabled)
+		return 0;
+
+	tctx = get_task_ctx(p, false);
+	if (!tctx || !tctx->futex_uaddr)
+		return 0;
+
+	futex_wait_done(tctx, (u32)p->tgid,
+			ctx->ret >= 0 ? (u64)ctx->ret + 1 : 0);
+	return 0;
+}
+
+/*
+ * Exec balancing.  sched_ext gives the BPF scheduler no say at WF_EXEC —
+ * the core keeps the task where it is — so a burst child marks itself and
+ * yields here; the re-enqueue (spawn_take_exec) moves it to an idler LLC.
+ * The new image has no warm cache to lose.
+ */
+SEC("tp_btf/sched_process_exec")
+int BPF_PROG(a1349_exec, struct task_struct *unused, pid_t old_pid,
+	     struct linux_binprm *bprm)
+{
+	struct task_struct *p = bpf_get_current_task_btf();
+	struct auction_task_ctx *tctx = get_task_ctx(p, false);
+
+	if (!tctx || !(tctx->spawn & SPAWN_SPREAD) || p->nr_cpus_allowed == 1)
+		return 0;
+	/* One rebalance per fork: a later exec is not part of the burst. */
+	tctx->spawn = (tctx->spawn & ~SPAWN_SPREAD) | SPAWN_EXEC;
+	scx_bpf_kick_cpu(bpf_get_smp_processor_id(), SCX_KICK_PREEMPT);
+	return 0;
+}
+
+/*
+ * Per-task auction state for the agent's top view (-t / -T): one struct
+ * a1349_task_dump per task the scheduler has seen, read(2) from a task
+ * iterator.  No map walk, no per-task syscall; a full pass is one read
+ * loop in the agent.
+ */
+SEC("iter/task")
+int a1349_dump(struct bpf_iter__task *ctx)
+{
+	struct task_struct *p = ctx->task;
+	struct auction_task_ctx *tctx;
+	struct a1349_task_dump d = {};
+	u64 now;
+
+	if (!p)
+		return 0;
+	tctx = bpf_task_storage_get(&task_ctx_map, p, 0, 0);
+	if (!tctx)
+		return 0;
+
+	now = bpf_ktime_get_ns();
+	d.budget      = tctx->budget;
+	d.budget_max  = tctx->budget_max;
+	d.len_est_ns  = tctx->len_est_ns;
+	d.phi_enq     = tctx->phi_enq;
+	d.starved_ns  = tctx->starved_ns;
+	if (tctx->starved_since_ns && now > tctx->starved_since_ns)
+		d.starved_ns += now - tctx->starved_since_ns;
+	d.pid         = p->pid;
+	d.tgid        = p->tgid;
+	d.m_enq       = tctx->m_enq;
+	d.weight      = tctx->weight_cached;
+	d.cls         = tctx->cls;
+	d.sticky      = tctx->sticky;
+	d.starved     = tctx->starved_since_ns != 0;
+	__builtin_memcpy(d.comm, p->comm, sizeof(d.comm));
+
+	bpf_seq_write(ctx->meta->seq, &d, sizeof(d));
+	return 0;
+}
+
 s32
 BPF_STRUCT_OPS_SLEEPABLE(auction_init)
 {
 	struct auction_ctx *gdata = get_ctx();
 	s32 ret;
 
-	if (gdata) {
-		if (!gdata->max_capacity)
-			gdata->max_capacity = CAPACITY_SCALE;
-		if (!gdata->min_capacity)
-			gdata->min_capacity = CAPACITY_SCALE;
-		if (!gdata->cost_p)
-			gdata->cost_p = C_P_DEF;
-		if (!gdata->cost_e)
-			gdata->cost_e = C_E_DEF;
+	if (gdata && !gdata->nr_classes) {
+		gdata->nr_classes        = 1;
+		gdata->class_capacity[0] = CAPACITY_SCALE;
+		gdata->class_cost[0]     = C_P_DEF;
 	}
 
-	ret = scx_bpf_create_dsq(AUCTION_DSQ_P, -1);
-	if (ret)
-		return ret;
-	ret = scx_bpf_create_dsq(AUCTION_DSQ_E, -1);
+	ret = scx_bpf_create_dsq(AUCTION_DSQ_STARVED, -1);
 	if (ret)
 		return ret;
-	ret = scx_bpf_create_dsq(AUCTION_DSQ_STARVED, -1);
+	ret = scx_bpf_create_dsq(AUCTION_DSQ_IDLE, -1);
 	if (ret)
 		return ret;
 
 	{
 		u32 i;
+		bpf_for(i, 0, NR_CLASSES_MAX) {
+			s32 r = scx_bpf_create_dsq(
+				AUCTION_DSQ_CLASS_BASE + i, -1);
+			if (r)
+				return r;
+		}
 		bpf_for(i, 0, AUCTION_NCPU_MAX) {
 			s32 r = scx_bpf_create_dsq(
 				AUCTION_DSQ_PERCPU_BASE + i, -1);
 			if (r)
 				return r;
 		}
+		bpf_for(i, 0, GANG_MAX) {
+			struct gang_timer *gt;
+			s32 r;
+
+			if (i >= nr_gangs)
+				break;
+			r = scx_bpf_create_dsq(AUCTION_DSQ_GANG_BASE + i, -1);
+			if (r)
+				return r;
+
+			gt = bpf_map_lookup_elem(&gang_timer, &i);
+			if (!gt)
+				return -ESRCH;
+			bpf_timer_init(&gt->timer, &gang_timer, CLOCK_MONOTONIC);
+			bpf_timer_set_callback(&gt->timer, gang_timerfn);
+		}
+	}
+
+	if (central_cpu >= 0) {
+		u32 key = 0;
+		struct central_timer *ct =
+			bpf_map_lookup_elem(&central_timer, &key);
+
+		if (!ct)
+			return -ESRCH;
+		bpf_timer_init(&ct->timer, &central_timer, CLOCK_MONOTONIC);
+		bpf_timer_set_callback(&ct->timer, central_timerfn);
+		ret = bpf_timer_start(&ct->timer, CENTRAL_PERIOD_NS, 0);
+		if (ret)
+			return ret;
 	}
 	return 0;
 }
@@ -1018,6 +3682,7 @@ SCX_OPS_DEFINE(auction_ops,
 	       .enqueue    = (void *)auction_enqueue,
 	       .dispatch   = (void *)auction_dispatch,
 	       .running    = (void *)auction_running,
+	       .tick       = (void *)auction_tick,
 	       .stopping   = (void *)auction_stopping,
 	       .set_weight = (void *)auction_set_weight,
 	       .enable     = (void *)auction_enable,
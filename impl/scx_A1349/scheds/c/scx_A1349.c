@@ -3,17 +3,28 @@
  * scx_A1349 — userspace agent for the pure-auction VCG scheduler (A1349 s4+).
  *
  * Responsibilities:
- *   1. Discover per-CPU capacities from /sys/.../cpu_capacity, derive
- *      max_capacity (η_P), min_capacity (η_E), classify P vs E cores.
- *   2. Auto-derive c_E = c_P · η_E / η_P so γ = c_P/c_E = σ unless the
- *      operator overrides via -e.
- *   3. Precompute δ^m · DELTA_SCALE for m ∈ [0, MAX_CONTRACT_LENGTH) and
- *      ship it to BPF via the delta_table map.  Avoids BPF-side fp math.
+ *   1. Discover per-CPU capacities from /sys/.../cpu_capacity and cluster
+ *      them into up to NR_CLASSES_MAX capacity classes (η_0 > η_1 > …).
+ *   2. Auto-derive c_κ = c_0 · η_κ / η_0 so γ = σ between any two classes
+ *      unless the operator overrides the weakest class via -e.
+ *   3. Ship log2 δ to BPF in fixed point (rodata); BPF raises it to any
+ *      contract length with lib/fixmath.h instead of a lookup table.
  *   4. Periodic refresh for hotplug.
+ *   5. Load-time feature switches (rodata), e.g. -l for task-local-data
+ *      application hints (scx_A1349.h).
+ *   6. Gang membership (-g): tgid → gang slot, with the launch threshold
+ *      tracking the gang's live thread count unless pinned by the operator.
+ *   7. Optional futex tracepoints (-f) for lock-holder boosting, and the
+ *      per-CPU event counters report on exit.
+ *   8. Consolidation (-c): size the pack set from /proc/stat utilisation.
+ *   9. Operator placement rules (-r): cgroup / comm / uid → soft class
+ *      preference, value multiplier and slice.
  */
 
 #include <bpf/bpf.h>
+#include <bpf/libbpf.h>
 #include <scx/common.h>
+#include <lib/fixmath.h>
 #include <signal.h>
 #include <libgen.h>
 #include <unistd.h>
@@ -23,7 +34,12 @@
 #include <errno.h>
 #include <math.h>
 #include <getopt.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
 
+#include "scx_A1349.h"
 #include "scx_A1349.bpf.skel.h"
 
 static volatile int exit_req;
@@ -35,44 +51,573 @@ sigint_handler(int dummy)
 	exit_req = 1;
 }
 
-#define MAX_CONTRACT_LENGTH 32u
-#define DELTA_SHIFT         20
-#define DELTA_SCALE         (1ULL << DELTA_SHIFT)
 #define P_CAP_PCT           90u
 
-/* Mirrors the BPF auction_ctx layout — config-only, no runtime estimator state. */
-struct auction_ctx {
-	__u32 max_capacity;
-	__u32 min_capacity;
-	__u32 cost_p;
-	__u32 cost_e;
-	__u32 p_core_count;
-	__u32 e_core_count;
+static const char *const stat_names[STAT_NR] = {
+	[STAT_FUTEX_BOOST]      = "futex_boost",
+	[STAT_FUTEX_BOOST_PI]   = "futex_boost_pi",
+	[STAT_FUTEX_THROTTLED]  = "futex_throttled",
+	[STAT_PREFCORE_KICK]    = "prefcore_kick",
+	[STAT_PREFCORE_PULL]    = "prefcore_pull",
+	[STAT_SYNC_LOCAL]       = "sync_local",
+	[STAT_SYNC_SKIP]        = "sync_skip",
+	[STAT_MIG_HOLD]         = "mig_hold",
+	[STAT_PACK_BACKOFF]     = "pack_backoff",
+	[STAT_UCLAMP_FLOOR]     = "uclamp_floor",
+	[STAT_SPAWN_SPREAD]     = "spawn_spread",
+	[STAT_SPAWN_EXEC]       = "spawn_exec",
+	[STAT_HERD_SPREAD]      = "herd_spread",
+	[STAT_HERD_COALESCED]   = "herd_coalesced",
+	[STAT_MEMBW_SPREAD]     = "membw_spread",
+	[STAT_MEMBW_HOLD]       = "membw_hold",
+	[STAT_SLICE_INF]        = "slice_inf",
+	[STAT_SLICE_INF_REVOKE] = "slice_inf_revoke",
+	[STAT_CENTRAL_ROUND]    = "central_round",
 };
 
+/* Sum the per-CPU stats map into out[STAT_NR]. */
+static void
+read_stats(struct scx_A1349 *skel, __u64 *out)
+{
+	int fd = bpf_map__fd(skel->maps.stats);
+	int ncpu = libbpf_num_possible_cpus();
+	__u64 *vals;
+
+	memset(out, 0, STAT_NR * sizeof(*out));
+	if (ncpu <= 0)
+		return;
+	vals = calloc(ncpu, sizeof(*vals));
+	if (!vals)
+		return;
+
+	for (__u32 idx = 0; idx < STAT_NR; idx++) {
+		if (bpf_map_lookup_elem(fd, &idx, vals))
+			continue;
+		for (int cpu = 0; cpu < ncpu; cpu++)
+			out[idx] += vals[cpu];
+	}
+	free(vals);
+}
+
+static void
+print_stats(struct scx_A1349 *skel)
+{
+	__u64 st[STAT_NR];
+
+	read_stats(skel, st);
+	printf("scx_A1349: stats");
+	for (__u32 i = 0; i < STAT_NR; i++)
+		printf(" %s=%llu", stat_names[i], (unsigned long long)st[i]);
+	printf("\n");
+}
+
+struct gang_opt {
+	__u32 tgid;
+	__u32 min_members;         /* 0 ⇒ follow the live thread count */
+};
+
+static struct gang_opt gangs[GANG_MAX];
+static __u32           nr_gang_opts;
+
 /*
- * Populate the δ^m lookup table.  Computed in double precision; written as
- * fixed-point u64 with DELTA_SCALE = 2^20.  The table is RO from BPF and is
- * refreshed only on δ change (not on every hotplug tick).
+ * Parse "TGID[:MIN]".  MIN pins the launch threshold; without it the
+ * threshold follows /proc/TGID/task so an OpenMP team that grows or
+ * shrinks between parallel regions is still gathered whole.
  */
+static bool
+parse_gang_opt(const char *arg)
+{
+	char *end;
+	unsigned long tgid, min = 0;
+
+	if (nr_gang_opts >= GANG_MAX)
+		return false;
+
+	tgid = strtoul(arg, &end, 10);
+	if (end == arg || !tgid)
+		return false;
+	if (*end == ':') {
+		const char *m = end + 1;
+		min = strtoul(m, &end, 10);
+		if (end == m)
+			return false;
+	}
+	if (*end)
+		return false;
+
+	gangs[nr_gang_opts].tgid        = (__u32)tgid;
+	gangs[nr_gang_opts].min_members = (__u32)min;
+	nr_gang_opts++;
+	return true;
+}
+
+static __u32
+count_threads(__u32 tgid)
+{
+	char path[64];
+	struct dirent *de;
+	__u32 n = 0;
+	DIR *d;
+
+	snprintf(path, sizeof(path), "/proc/%u/task", tgid);
+	d = opendir(path);
+	if (!d)
+		return 0;
+	while ((de = readdir(d)))
+		if (de->d_name[0] != '.')
+			n++;
+	closedir(d);
+	return n;
+}
+
+/*
+ * Sync gang_map with the configured gangs.  Dead tgids are left in place:
+ * the entry is harmless (no task can match it) and a restarted job under
+ * the same tgid is vanishingly rare.
+ */
+static void
+refresh_gangs(struct scx_A1349 *skel)
+{
+	int fd = bpf_map__fd(skel->maps.gang_map);
+
+	for (__u32 i = 0; i < nr_gang_opts; i++) {
+		struct gang_cfg cfg = {
+			.slot        = i,
+			.min_members = gangs[i].min_members,
+		};
+
+		if (!cfg.min_members)
+			cfg.min_members = count_threads(gangs[i].tgid);
+		bpf_map_update_elem(fd, &gangs[i].tgid, &cfg, BPF_ANY);
+	}
+}
+
 static void
-populate_delta_table(struct scx_A1349 *skel, double delta)
+print_gang_stats(struct scx_A1349 *skel)
 {
-	int fd = bpf_map__fd(skel->maps.delta_table);
-	double cur = 1.0;
+	int fd = bpf_map__fd(skel->maps.gang_runtime);
 
-	for (__u32 m = 0; m < MAX_CONTRACT_LENGTH; m++) {
-		__u64 fp = (__u64)llround(cur * (double)DELTA_SCALE);
-		__u32 key = m;
-		bpf_map_update_elem(fd, &key, &fp, BPF_ANY);
-		cur *= delta;
+	for (__u32 i = 0; i < nr_gang_opts; i++) {
+		struct gang_runtime gr = {};
+
+		if (bpf_map_lookup_elem(fd, &i, &gr))
+			continue;
+		printf("scx_A1349: gang tgid=%u launches=%llu members=%llu "
+		       "paid=%llu\n", gangs[i].tgid,
+		       (unsigned long long)gr.launches,
+		       (unsigned long long)gr.members_launched,
+		       (unsigned long long)gr.paid);
 	}
 }
 
+/*
+ * Operator placement rules (-r FILE), one per line:
+ *
+ *   # MATCH                       CLASS  VALUE%  SLICE
+ *   cgroup:/sys/fs/cgroup/build   e      50      batch
+ *   comm:postgres                 p      150     -
+ *   uid:1001                      -      100     long
+ *
+ * MATCH is cgroup:PATH (a cgroup v2 directory, whose inode number is the
+ * cgroup id), cgroup:ID, comm:PREFIX or uid:UID.  CLASS is p (class 0),
+ * e (the weakest class), a class index, or - for no preference.  SLICE is
+ * default, short, long, batch or -.  The file is re-read on every
+ * refresh: edits take effect, removed rules leave the maps, and cgroup
+ * paths are re-resolved so a cgroup created after start-up is picked up.
+ * A file that no longer parses keeps the previous rules.
+ */
+enum rule_kind {
+	RULE_CGROUP,
+	RULE_COMM,
+	RULE_UID,
+};
+
+struct rule_opt {
+	enum rule_kind    kind;
+	char              arg[256];
+	struct a1349_rule rule;
+	__u64             cg_id;        /* RULE_CGROUP, resolved; 0 ⇒ none */
+};
+
+static const char     *rules_path;
+static struct rule_opt rules[A1349_RULE_MAX];
+static __u32           nr_rules;
+
+static bool
+parse_rule_class(const char *s, __u8 *out)
+{
+	char *end;
+	unsigned long k;
+
+	if (!strcmp(s, "-")) {
+		*out = A1349_RULE_CLASS_NONE;
+		return true;
+	}
+	if (!strcmp(s, "p")) {
+		*out = 0;
+		return true;
+	}
+	if (!strcmp(s, "e")) {
+		*out = A1349_RULE_CLASS_LAST;
+		return true;
+	}
+	k = strtoul(s, &end, 10);
+	if (end == s || *end || k >= NR_CLASSES_MAX)
+		return false;
+	*out = (__u8)k;
+	return true;
+}
+
+static bool
+parse_rule_slice(const char *s, __u8 *out)
+{
+	static const char *const names[] = {
+		[A1349_RULE_SLICE_DEFAULT] = "default",
+		[A1349_RULE_SLICE_SHORT]   = "short",
+		[A1349_RULE_SLICE_LONG]    = "long",
+		[A1349_RULE_SLICE_BATCH]   = "batch",
+	};
+
+	if (!strcmp(s, "-")) {
+		*out = A1349_RULE_SLICE_DEFAULT;
+		return true;
+	}
+	for (__u8 i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+		if (!strcmp(s, names[i])) {
+			*out = i;
+			return true;
+		}
+	}
+	return false;
+}
+
+static bool
+load_rules(const char *path)
+{
+	static struct rule_opt parsed[A1349_RULE_MAX];
+	char line[512];
+	int lineno = 0;
+	__u32 nr = 0;
+	FILE *f = fopen(path, "r");
+
+	if (!f) {
+		fprintf(stderr, "Error: cannot open rules file %s: %s\n",
+			path, strerror(errno));
+		return false;
+	}
+
+	while (fgets(line, sizeof(line), f)) {
+		char match[300], cls[16], val[16], slice[16];
+		struct rule_opt *r;
+		char *colon, *end;
+		int n;
+
+		lineno++;
+		n = sscanf(line, "%299s %15s %15s %15s", match, cls, val, slice);
+		if (n <= 0 || match[0] == '#')
+			continue;
+
+		if (nr >= A1349_RULE_MAX) {
+			fprintf(stderr, "Error: %s:%d: more than %u rules\n",
+				path, lineno, A1349_RULE_MAX);
+			goto err;
+		}
+		r = &parsed[nr];
+		memset(r, 0, sizeof(*r));
+
+		colon = strchr(match, ':');
+		if (n != 4 || !colon || !colon[1])
+			goto bad;
+		*colon = '\0';
+		if (!strcmp(match, "cgroup"))
+			r->kind = RULE_CGROUP;
+		else if (!strcmp(match, "comm"))
+			r->kind = RULE_COMM;
+		else if (!strcmp(match, "uid"))
+			r->kind = RULE_UID;
+		else
+			goto bad;
+		snprintf(r->arg, sizeof(r->arg), "%s", colon + 1);
+		if (r->kind == RULE_COMM &&
+		    strlen(r->arg) >= A1349_RULE_COMM_LEN)
+			goto bad;
+
+		if (!parse_rule_class(cls, &r->rule.cls) ||
+		    !parse_rule_slice(slice, &r->rule.slice))
+			goto bad;
+		if (strcmp(val, "-")) {
+			unsigned long pct = strtoul(val, &end, 10);
+
+			if (end == val || *end || !pct || pct > 1000)
+				goto bad;
+			r->rule.value_pct = (__u16)pct;
+		}
+		nr++;
+		continue;
+bad:
+		fprintf(stderr, "Error: %s:%d: bad rule (MATCH CLASS VALUE%% "
+			"SLICE)\n", path, lineno);
+		goto err;
+	}
+	fclose(f);
+	memcpy(rules, parsed, nr * sizeof(parsed[0]));
+	nr_rules = nr;
+	return true;
+err:
+	fclose(f);
+	return false;
+}
+
+/* Whether map key `key` of a `kind` rule still belongs to a loaded rule. */
+static bool
+rule_key_live(enum rule_kind kind, const void *key)
+{
+	for (__u32 i = 0; i < nr_rules; i++) {
+		const struct rule_opt *r = &rules[i];
+
+		if (r->kind != kind)
+			continue;
+		switch (kind) {
+		case RULE_CGROUP:
+			if (r->cg_id && r->cg_id == *(const __u64 *)key)
+				return true;
+			break;
+		case RULE_COMM: {
+			const struct a1349_comm_key *ck = key;
+
+			if (ck->prefixlen == strlen(r->arg) * 8 &&
+			    !memcmp(ck->comm, r->arg, strlen(r->arg)))
+				return true;
+			break;
+		}
+		case RULE_UID:
+			if (*(const __u32 *)key == (__u32)strtoul(r->arg, NULL, 10))
+				return true;
+			break;
+		}
+	}
+	return false;
+}
+
+/* Delete the keys of `map_fd` that no loaded rule of `kind` produces. */
+static void
+prune_rules(int map_fd, enum rule_kind kind, size_t key_sz)
+{
+	char key[sizeof(struct a1349_comm_key)], next[sizeof(key)];
+	void *prev = NULL;
+
+	if (key_sz > sizeof(key))
+		return;
+
+	/* A deleted key cannot seed get_next_key, so restart the walk after one. */
+	while (!bpf_map_get_next_key(map_fd, prev, next)) {
+		if (!rule_key_live(kind, next)) {
+			bpf_map_delete_elem(map_fd, next);
+			prev = NULL;
+			continue;
+		}
+		memcpy(key, next, key_sz);
+		prev = key;
+	}
+}
+
+static void
+refresh_rules(struct scx_A1349 *skel)
+{
+	int cg_fd   = bpf_map__fd(skel->maps.rule_cgroup);
+	int comm_fd = bpf_map__fd(skel->maps.rule_comm);
+	int uid_fd  = bpf_map__fd(skel->maps.rule_uid);
+
+	/* On a parse error, load_rules() says why and keeps the last rules. */
+	if (rules_path)
+		load_rules(rules_path);
+
+	for (__u32 i = 0; i < nr_rules; i++) {
+		struct rule_opt *r = &rules[i];
+
+		switch (r->kind) {
+		case RULE_CGROUP: {
+			struct stat st;
+			__u64 id;
+			char *end;
+
+			r->cg_id = 0;
+			id = strtoull(r->arg, &end, 10);
+			if (end == r->arg || *end) {
+				if (stat(r->arg, &st))
+					continue;       /* not created yet */
+				id = st.st_ino;
+			}
+			r->cg_id = id;
+			bpf_map_update_elem(cg_fd, &id, &r->rule, BPF_ANY);
+			break;
+		}
+		case RULE_COMM: {
+			struct a1349_comm_key key = {};
+
+			key.prefixlen = strlen(r->arg) * 8;
+			memcpy(key.comm, r->arg, strlen(r->arg));
+			bpf_map_update_elem(comm_fd, &key, &r->rule, BPF_ANY);
+			break;
+		}
+		case RULE_UID: {
+			__u32 uid = (__u32)strtoul(r->arg, NULL, 10);
+
+			bpf_map_update_elem(uid_fd, &uid, &r->rule, BPF_ANY);
+			break;
+		}
+		}
+	}
+
+	prune_rules(cg_fd, RULE_CGROUP, sizeof(__u64));
+	prune_rules(comm_fd, RULE_COMM, sizeof(struct a1349_comm_key));
+	prune_rules(uid_fd, RULE_UID, sizeof(__u32));
+}
+
+/* δ^m the way BPF computes it (delta_pow()), as a double for the banner. */
+static double
+delta_pow_fix(__s64 delta_log2, __u32 m)
+{
+	return ldexp((double)scx_fix_exp2(scx_fix_mul_exp(SCX_FIX(m), delta_log2)),
+		     -SCX_FIX_SHIFT);
+}
+
+static int
+cmp_cap_desc(const void *a, const void *b)
+{
+	__u32 x = *(const __u32 *)a, y = *(const __u32 *)b;
+
+	return x < y ? 1 : x > y ? -1 : 0;
+}
+
+/*
+ * Cluster capacities into classes, strongest first.  Walking the distinct
+ * capacities in descending order, a value below P_CAP_PCT of the current
+ * class's top opens a new class — the old P/E threshold applied
+ * recursively, so 1024/1000/760/420 yields {1024,1000} {760} {420}.
+ * Anything past NR_CLASSES_MAX folds into the last class.
+ *
+ * Returns K and fills tops[0..K) with each class's top capacity.
+ */
+static __u32
+cluster_capacities(const __u32 *caps, int ncpu, __u32 *tops)
+{
+	__u32 sorted[512];
+	__u32 nr = 0;
+
+	if (ncpu <= 0) {
+		tops[0] = 1024;
+		return 1;
+	}
+
+	memcpy(sorted, caps, ncpu * sizeof(*caps));
+	qsort(sorted, ncpu, sizeof(*sorted), cmp_cap_desc);
+
+	tops[nr++] = sorted[0];
+	for (int i = 1; i < ncpu && nr < NR_CLASSES_MAX; i++) {
+		if ((__u64)sorted[i] * 100 < (__u64)tops[nr - 1] * P_CAP_PCT)
+			tops[nr++] = sorted[i];
+	}
+	return nr;
+}
+
+static __u8
+class_of_cap(__u32 cap, const __u32 *tops, __u32 nr)
+{
+	__u8 k = 0;
+
+	while (k + 1 < nr && tops[k + 1] >= cap)
+		k++;
+	return k;
+}
+
+/* cpu_capacity from sysfs; 1024 where the kernel does not expose it. */
+static __u32
+read_cpu_capacity(int cpu)
+{
+	char path[128];
+	__u32 cap = 1024;
+	FILE *f;
+
+	snprintf(path, sizeof(path),
+		 "/sys/devices/system/cpu/cpu%d/cpu_capacity", cpu);
+	f = fopen(path, "r");
+	if (f) {
+		if (fscanf(f, "%u", &cap) != 1)
+			cap = 1024;
+		fclose(f);
+	}
+	return cap;
+}
+
+/*
+ * max_cap == min_cap across every possible CPU.  Decided once before load
+ * (rodata homogeneous); refresh_cpu_capacities() only warns if it stops
+ * holding.
+ */
+static bool
+topology_homogeneous(void)
+{
+	int ncpu = libbpf_num_possible_cpus();
+	__u32 cap0 = read_cpu_capacity(0);
+
+	for (int cpu = 1; cpu < ncpu; cpu++) {
+		if (read_cpu_capacity(cpu) != cap0)
+			return false;
+	}
+	return true;
+}
+
+/*
+ * Id of `cpu`'s last-level cache: the highest cache level sysfs lists for
+ * it.  -1 when there is no cache topology (some VMs).
+ */
+static int
+read_cpu_llc(int cpu)
+{
+	int best_level = -1, id = -1;
+
+	for (int i = 0; i < 8; i++) {
+		char path[128];
+		int level, cid;
+		FILE *f;
+
+		snprintf(path, sizeof(path),
+			 "/sys/devices/system/cpu/cpu%d/cache/index%d/level",
+			 cpu, i);
+		f = fopen(path, "r");
+		if (!f)
+			break;
+		if (fscanf(f, "%d", &level) != 1)
+			level = -1;
+		fclose(f);
+		if (level <= best_level)
+			continue;
+
+		snprintf(path, sizeof(path),
+			 "/sys/devices/system/cpu/cpu%d/cache/index%d/id",
+			 cpu, i);
+		f = fopen(path, "r");
+		if (!f)
+			continue;
+		if (fscanf(f, "%d", &cid) == 1) {
+			best_level = level;
+			id = cid;
+		}
+		fclose(f);
+	}
+	return id;
+}
+
 /*
  * Refresh per-CPU capacity-derived data:
- *   cpu_capacity[cpu], cpu_is_p[cpu], global_data.{max,min,cost,p_cc,e_cc}.
- * Caller picks cost_p; cost_e is either operator-provided or auto-derived.
+ *   cpu_capacity[cpu], cpu_class[cpu], cpu_llc[cpu], global_data (per-class
+ *   η, c, n; LLC count).
+ *
+ * Caller picks c_0 = cost_p.  Without -e the remaining costs are
+ * auto-derived as c_κ = c_0 · η_κ/η_0 (γ = σ between every pair of
+ * classes); with -e, c_{K−1} = cost_e and the classes in between are
+ * interpolated linearly in capacity.
  */
 static bool
 refresh_cpu_capacities(struct scx_A1349 *skel,
@@ -81,9 +626,12 @@ refresh_cpu_capacities(struct scx_A1349 *skel,
 {
 	int cap_fd  = bpf_map__fd(skel->maps.cpu_capacity);
 	int gmap_fd = bpf_map__fd(skel->maps.global_data);
-	int isp_fd  = bpf_map__fd(skel->maps.cpu_is_p);
-	__u32 max_cap = 0, min_cap = 0;
-	__u32 cost_e;
+	int cls_fd  = bpf_map__fd(skel->maps.cpu_class);
+	int llc_fd  = bpf_map__fd(skel->maps.cpu_llc);
+	__u32 tops[NR_CLASSES_MAX] = {};
+	__u32 cpus[NR_CLASSES_MAX] = {};
+	int llc_ids[LLC_MAX];
+	__u32 nr, min_cap0, nr_llcs = 0;
 	bool changed = false;
 
 	int ncpu = libbpf_num_possible_cpus();
@@ -92,17 +640,7 @@ refresh_cpu_capacities(struct scx_A1349 *skel,
 		ncpu = 512;
 
 	for (int cpu = 0; cpu < ncpu; cpu++) {
-		char path[128];
-		snprintf(path, sizeof(path),
-			 "/sys/devices/system/cpu/cpu%d/cpu_capacity", cpu);
-
-		__u32 cap = 1024;
-		FILE *f = fopen(path, "r");
-		if (f) {
-			if (fscanf(f, "%u", &cap) != 1)
-				cap = 1024;
-			fclose(f);
-		}
+		__u32 cap = read_cpu_capacity(cpu);
 		caps[cpu] = cap;
 
 		__u32 key = (__u32)cpu;
@@ -113,79 +651,421 @@ refresh_cpu_capacities(struct scx_A1349 *skel,
 			changed = true;
 		}
 
-		if (cap > max_cap)
-			max_cap = cap;
-		if (!min_cap || cap < min_cap)
-			min_cap = cap;
+		if (cpu >= (int)AUCTION_NCPU_MAX)       /* cpu_llc */
+			continue;
+		int id = read_cpu_llc(cpu);
+		__u32 l;
+		for (l = 0; l < nr_llcs && llc_ids[l] != id; l++)
+			;
+		if (l == nr_llcs) {
+			if (nr_llcs < LLC_MAX)
+				llc_ids[nr_llcs++] = id;
+			else
+				l = (__u32)id % LLC_MAX;
+		}
+		__u8 llc = (__u8)l, old_llc = 0xff;
+		if (bpf_map_lookup_elem(llc_fd, &key, &old_llc) != 0 ||
+		    old_llc != llc) {
+			bpf_map_update_elem(llc_fd, &key, &llc, BPF_ANY);
+			changed = true;
+		}
 	}
 
-	__u32 p_cc = 0, e_cc = 0;
+	nr = cluster_capacities(caps, ncpu, tops);
+	min_cap0 = tops[0];
+
 	for (int cpu = 0; cpu < ncpu; cpu++) {
-		__u8 is_p = ((__u64)caps[cpu] * 100 >= (__u64)max_cap * P_CAP_PCT);
+		__u8 cls = class_of_cap(caps[cpu], tops, nr);
 		__u32 key = (__u32)cpu;
-		__u8 old_flag = 0xff;
-		if (bpf_map_lookup_elem(isp_fd, &key, &old_flag) != 0 ||
-		    old_flag != is_p) {
-			bpf_map_update_elem(isp_fd, &key, &is_p, BPF_ANY);
+		__u8 old_cls = 0xff;
+		if (bpf_map_lookup_elem(cls_fd, &key, &old_cls) != 0 ||
+		    old_cls != cls) {
+			bpf_map_update_elem(cls_fd, &key, &cls, BPF_ANY);
 			changed = true;
 		}
-		if (is_p) p_cc++; else e_cc++;
+		cpus[cls]++;
+		if (!cls && caps[cpu] < min_cap0)
+			min_cap0 = caps[cpu];
 	}
 
-	if (!max_cap)
-		max_cap = 1024;
-	if (!min_cap)
-		min_cap = max_cap;
+	__u32 gkey = 0;
+	struct auction_ctx ctx = {}, old = {};
+	if (bpf_map_lookup_elem(gmap_fd, &gkey, &old) != 0)
+		memset(&old, 0, sizeof(old));
+
+	ctx.nr_classes = nr;
+	ctx.pack_nr    = old.pack_nr;  /* owned by refresh_pack() */
+	ctx.nr_llcs    = nr_llcs ?: 1;
+	/* Favoured cores: class 0 spans more than one capacity. */
+	ctx.prefcore   = min_cap0 < tops[0];
+	for (__u32 k = 0; k < nr; k++) {
+		__u64 cost;
 
-	if (cost_e_user) {
-		cost_e = cost_e_in;
-	} else {
-		__u64 derived = (__u64)cost_p * min_cap / max_cap;
-		if (!derived)
-			derived = 1;
-		cost_e = (__u32)derived;
+		if (nr == 1 || k == 0) {
+			cost = cost_p;
+		} else if (cost_e_user) {
+			__u64 span = tops[0] - tops[nr - 1];
+			cost = cost_e_in;
+			if (span)
+				cost += (__u64)(cost_p - cost_e_in) *
+					(tops[k] - tops[nr - 1]) / span;
+		} else {
+			cost = (__u64)cost_p * tops[k] / tops[0];
+		}
+		ctx.class_capacity[k] = tops[k];
+		ctx.class_cost[k]     = cost ? (__u32)cost : 1;
+		ctx.class_cpus[k]     = cpus[k];
 	}
 
-	__u32 gkey = 0;
-	struct auction_ctx ctx = {};
-	if (bpf_map_lookup_elem(gmap_fd, &gkey, &ctx) != 0)
-		memset(&ctx, 0, sizeof(ctx));
-
-	if (ctx.max_capacity != max_cap || ctx.min_capacity != min_cap ||
-	    ctx.cost_p != cost_p || ctx.cost_e != cost_e ||
-	    ctx.p_core_count != p_cc || ctx.e_core_count != e_cc) {
-		ctx.max_capacity = max_cap;
-		ctx.min_capacity = min_cap;
-		ctx.cost_p       = cost_p;
-		ctx.cost_e       = cost_e;
-		ctx.p_core_count = p_cc;
-		ctx.e_core_count = e_cc;
+	if (memcmp(&ctx, &old, sizeof(ctx))) {
 		bpf_map_update_elem(gmap_fd, &gkey, &ctx, BPF_ANY);
 		changed = true;
 	}
 
 	if (force_log || changed) {
-		double sigma = (min_cap > 0) ? (double)max_cap / min_cap : 1.0;
-		printf("scx_A1349: max_cap=%u min_cap=%u sigma=%.3f "
-		       "cost_p=%u cost_e=%u p_cores=%u e_cores=%u (%s)%s\n",
-		       max_cap, min_cap, sigma, cost_p, cost_e, p_cc, e_cc,
-		       (max_cap == min_cap) ? "homogeneous" : "heterogeneous",
+		double sigma = (double)tops[0] / tops[nr - 1];
+		printf("scx_A1349: classes=%u llcs=%u sigma=%.3f (%s)%s%s\n",
+		       nr, ctx.nr_llcs, sigma,
+		       nr == 1 ? "homogeneous" : "heterogeneous",
+		       ctx.prefcore ? " prefcore" : "",
 		       changed ? " [updated]" : "");
+		for (__u32 k = 0; k < nr; k++)
+			printf("scx_A1349:   class %u: cap=%u cost=%u cpus=%u\n",
+			       k, ctx.class_capacity[k], ctx.class_cost[k],
+			       ctx.class_cpus[k]);
+		if (skel->rodata->homogeneous && (nr > 1 || ctx.prefcore))
+			fprintf(stderr, "scx_A1349: capacities diverged under "
+				"the homogeneous fast path; restart to "
+				"schedule by class\n");
 	}
 
 	return changed;
 }
 
+/*
+ * Consolidation (-c PCT).  Below PCT % system utilisation the BPF side
+ * keeps wake-ups inside a pack set sized for PACK_TARGET_PCT busy per
+ * packed CPU, taken from the weakest class upwards (least power per
+ * running task).  Leaving needs 1.5 × PCT so one busy sample does not
+ * flap the set; the BPF side spreads on its own as soon as queueing delay
+ * rises, well before the next sample.
+ */
+#define PACK_TARGET_PCT     60u
+
+struct cpu_times {
+	__u64 busy;
+	__u64 total;
+};
+
+static struct cpu_times pack_prev;
+static bool             pack_on;
+static __u32            pack_cur;
+
+static bool
+read_cpu_times(struct cpu_times *t)
+{
+	unsigned long long v[8] = {};
+	FILE *f = fopen("/proc/stat", "r");
+	int n;
+
+	if (!f)
+		return false;
+	n = fscanf(f, "cpu %llu %llu %llu %llu %llu %llu %llu %llu",
+		   &v[0], &v[1], &v[2], &v[3], &v[4], &v[5], &v[6], &v[7]);
+	fclose(f);
+	if (n < 4)
+		return false;
+
+	t->total = 0;
+	for (int i = 0; i < 8; i++)
+		t->total += v[i];
+	t->busy = t->total - v[3] - v[4];       /* minus idle, iowait */
+	return true;
+}
+
+static bool
+cpu_online(int cpu)
+{
+	char path[64];
+	int on = 1;
+	FILE *f;
+
+	snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/online", cpu);
+	f = fopen(path, "r");
+	if (!f)
+		return true;            /* cpu0 is usually not hot-pluggable */
+	if (fscanf(f, "%d", &on) != 1)
+		on = 1;
+	fclose(f);
+	return on;
+}
+
+static void
+refresh_pack(struct scx_A1349 *skel, __u32 pack_pct)
+{
+	int pack_fd = bpf_map__fd(skel->maps.cpu_pack);
+	int cls_fd  = bpf_map__fd(skel->maps.cpu_class);
+	int gmap_fd = bpf_map__fd(skel->maps.global_data);
+	int ncpu = libbpf_num_possible_cpus();
+	struct auction_ctx ctx = {};
+	struct cpu_times now;
+	__u64 d_busy, d_total;
+	__u32 util_pct, want = 0, n = 0, gkey = 0;
+
+	if (ncpu > (int)AUCTION_NCPU_MAX)
+		ncpu = AUCTION_NCPU_MAX;
+	if (ncpu <= 0 || !read_cpu_times(&now))
+		return;
+
+	d_busy  = now.busy  - pack_prev.busy;
+	d_total = now.total - pack_prev.total;
+	pack_prev = now;
+	if (!d_total)
+		return;
+	util_pct = (__u32)(d_busy * 100 / d_total);
+
+	if (util_pct < pack_pct)
+		pack_on = true;
+	else if (util_pct > pack_pct + pack_pct / 2)
+		pack_on = false;
+
+	if (pack_on) {
+		want = (util_pct * ncpu + PACK_TARGET_PCT - 1) / PACK_TARGET_PCT;
+		if (!want)
+			want = 1;
+		if (want > (__u32)ncpu)
+			want = ncpu;
+	}
+
+	for (int k = NR_CLASSES_MAX - 1; k >= 0; k--) {
+		for (int cpu = 0; cpu < ncpu; cpu++) {
+			__u32 key = (__u32)cpu;
+			__u8 cls = 0, in;
+
+			bpf_map_lookup_elem(cls_fd, &key, &cls);
+			if (cls != k)
+				continue;
+			in = n < want && cpu_online(cpu);
+			n += in;
+			bpf_map_update_elem(pack_fd, &key, &in, BPF_ANY);
+		}
+	}
+
+	if (bpf_map_lookup_elem(gmap_fd, &gkey, &ctx) || ctx.pack_nr == n)
+		return;
+	ctx.pack_nr = n;
+	bpf_map_update_elem(gmap_fd, &gkey, &ctx, BPF_ANY);
+
+	if (n != pack_cur)
+		printf("scx_A1349: util=%u%% pack_cpus=%u%s\n", util_pct, n,
+		       n ? "" : " (spreading)");
+	pack_cur = n;
+}
+
+/*
+ * Memory-bandwidth mode (-m): one PERF_COUNT_HW_CACHE_MISSES counter per
+ * CPU in lib/pmu.bpf.c's scx_pmu_map, counter slot 0 (key = cpu).  The fds
+ * stay open for the scheduler's lifetime.  Returns the CPUs counting; 0
+ * leaves the mode inert (no PMU access, e.g. in most VMs).
+ */
+static int
+open_llc_miss_counters(struct scx_A1349 *skel)
+{
+	int map_fd = bpf_map__fd(skel->maps.scx_pmu_map);
+	int ncpu = libbpf_num_possible_cpus();
+	int n = 0;
+
+	for (int cpu = 0; cpu < ncpu; cpu++) {
+		struct perf_event_attr attr = {
+			.type   = PERF_TYPE_HARDWARE,
+			.size   = sizeof(attr),
+			.config = PERF_COUNT_HW_CACHE_MISSES,
+		};
+		__u32 key = (__u32)cpu;
+		int fd;
+
+		fd = (int)syscall(__NR_perf_event_open, &attr, -1, cpu, -1,
+				  PERF_FLAG_FD_CLOEXEC);
+		if (fd < 0)
+			continue;
+		if (bpf_map_update_elem(map_fd, &key, &fd, BPF_ANY)) {
+			close(fd);
+			continue;
+		}
+		n++;
+	}
+	return n;
+}
+
+/*
+ * Per-task introspection (-t / -T FILE).  Once a second the a1349_dump
+ * task iterator is read into one buffer and sorted worst-off first: least
+ * budget left (as a fraction of the cap), then longest time in STARVED,
+ * then highest φ.  -t redraws the top DUMP_TOP_ROWS on the terminal; -T
+ * rewrites FILE with every task, atomically via rename(2).
+ */
+#define DUMP_TOP_ROWS       20
+
+static struct a1349_task_dump *dump_buf;
+static size_t                  dump_cap;        /* bytes */
+
+/* One pass of the task iterator; returns the record count or -errno. */
+static int
+read_task_dump(struct bpf_link *iter_link)
+{
+	size_t len = 0;
+	ssize_t r;
+	int fd;
+
+	fd = bpf_iter_create(bpf_link__fd(iter_link));
+	if (fd < 0)
+		return -errno;
+	for (;;) {
+		if (len == dump_cap) {
+			size_t cap = dump_cap ? 2 * dump_cap
+					      : 1024 * sizeof(*dump_buf);
+			void *nb = realloc(dump_buf, cap);
+
+			if (!nb) {
+				close(fd);
+				return -ENOMEM;
+			}
+			dump_buf = nb;
+			dump_cap = cap;
+		}
+		r = read(fd, (char *)dump_buf + len, dump_cap - len);
+		if (r < 0 && errno == EINTR)
+			continue;
+		if (r <= 0)
+			break;
+		len += (size_t)r;
+	}
+	close(fd);
+	if (r < 0)
+		return -errno;
+	return (int)(len / sizeof(*dump_buf));
+}
+
+static int
+cmp_dump(const void *a, const void *b)
+{
+	const struct a1349_task_dump *x = a, *y = b;
+	/* budget / budget_max, cross-multiplied; both stay far below 2^32. */
+	__u64 fx = x->budget * (y->budget_max ?: 1);
+	__u64 fy = y->budget * (x->budget_max ?: 1);
+
+	if (fx != fy)
+		return fx < fy ? -1 : 1;
+	if (x->starved_ns != y->starved_ns)
+		return x->starved_ns > y->starved_ns ? -1 : 1;
+	if (x->phi_enq != y->phi_enq)
+		return x->phi_enq > y->phi_enq ? -1 : 1;
+	return 0;
+}
+
+static void
+print_dump_rows(FILE *out, int nr, int rows)
+{
+	fprintf(out, "%8s %8s %-16s %3s %7s %11s %8s %3s %9s %5s %s\n",
+		"PID", "TGID", "COMM", "CLS", "BUDGET%", "STARVED_MS",
+		"PHI", "M", "LEN_US", "W", "Q");
+	for (int i = 0; i < nr && i < rows; i++) {
+		const struct a1349_task_dump *d = &dump_buf[i];
+		char comm[A1349_RULE_COMM_LEN + 1];
+
+		memcpy(comm, d->comm, A1349_RULE_COMM_LEN);
+		comm[A1349_RULE_COMM_LEN] = '\0';
+		fprintf(out, "%8u %8u %-16s %3u %7.1f %11.1f %8lld %3u %9.1f "
+			"%5u %s\n",
+			d->pid, d->tgid, comm, d->cls,
+			d->budget_max ? 100.0 * d->budget / d->budget_max : 0.0,
+			d->starved_ns / 1e6, (long long)d->phi_enq, d->m_enq,
+			d->len_est_ns / 1e3, d->weight,
+			d->starved ? "starved" : d->sticky ? "sticky" : "-");
+	}
+}
+
+static void
+dump_tasks(struct bpf_link *iter_link, bool top, const char *snap_path)
+{
+	int nr = read_task_dump(iter_link);
+
+	if (nr < 0) {
+		fprintf(stderr, "scx_A1349: task dump failed: %s\n",
+			strerror(-nr));
+		return;
+	}
+	qsort(dump_buf, nr, sizeof(*dump_buf), cmp_dump);
+
+	if (top) {
+		printf("\033[H\033[2J");
+		printf("scx_A1349: %d tasks, worst-off first\n", nr);
+		print_dump_rows(stdout, nr, DUMP_TOP_ROWS);
+		fflush(stdout);
+	}
+
+	if (snap_path) {
+		char tmp[4096];
+		FILE *f;
+
+		snprintf(tmp, sizeof(tmp), "%s.tmp", snap_path);
+		f = fopen(tmp, "w");
+		if (!f) {
+			fprintf(stderr, "scx_A1349: %s: %s\n", tmp,
+				strerror(errno));
+			return;
+		}
+		print_dump_rows(f, nr, nr);
+		if (fclose(f) || rename(tmp, snap_path))
+			fprintf(stderr, "scx_A1349: %s: %s\n", snap_path,
+				strerror(errno));
+	}
+}
+
 static void
 usage(const char *prog)
 {
 	fprintf(stderr,
-		"Usage: %s [-p COST_P] [-e COST_E] [-d DELTA] [-h]\n"
+		"Usage: %s [-p COST_P] [-e COST_E] [-d DELTA] [-l] [-g TGID[:MIN]]... [-f] [-c PCT]\n"
+		"       [-r RULES] [-m RATE] [-C CPU] [-o ORDER] [-t] [-T FILE] [-h]\n"
 		"\n"
-		"  -p COST_P   per-quantum cost on P-core (default 1024)\n"
-		"  -e COST_E   per-quantum cost on E-core (default: auto-derive\n"
-		"              cost_p * min_cap / max_cap to keep γ = σ)\n"
+		"  -p COST_P   per-quantum cost on the strongest class (default 1024)\n"
+		"  -e COST_E   per-quantum cost on the weakest class; classes in\n"
+		"              between are interpolated by capacity (default:\n"
+		"              auto-derive cost_p * cap / max_cap to keep γ = σ)\n"
 		"  -d DELTA    MDP discount factor δ ∈ (0,1) (default 0.98)\n"
+		"  -l          honour application hints published through\n"
+		"              task local data (key \"" A1349_HINT_TLD_NAME "\")\n"
+		"  -g TGID[:MIN]\n"
+		"              co-schedule the threads of TGID as a gang; MIN\n"
+		"              members must be runnable before a launch (default:\n"
+		"              current thread count).  Repeatable, up to %u gangs\n"
+		"  -f          trace futex wait/wake and temporarily boost tasks\n"
+		"              that other waiters are queued behind\n"
+		"  -c PCT      below PCT %% utilisation, pack work onto as few\n"
+		"              CPUs as it needs (weakest class first) and let\n"
+		"              the rest reach deep idle\n"
+		"  -r RULES    placement rules file, one rule per line:\n"
+		"              MATCH CLASS VALUE%% SLICE, e.g.\n"
+		"                comm:make e 50 batch\n"
+		"              MATCH  cgroup:PATH|cgroup:ID|comm:PREFIX|uid:UID\n"
+		"              CLASS  p | e | class index | -\n"
+		"              SLICE  default | short | long | batch | -\n"
+		"              Re-read every 5 s; removed rules are dropped\n"
+		"  -m RATE     treat tasks above RATE LLC misses per ms of run\n"
+		"              time as memory-bound and keep them on LLCs with\n"
+		"              the least memory traffic (needs a hardware PMU)\n"
+		"  -C CPU      central-dispatcher mode: CPU (< %u) clears the\n"
+		"              auction for all classes at once and hands tasks\n"
+		"              to the other CPUs, which only consume\n"
+		"  -o ORDER    order inside a class: phi (default), deadline\n"
+		"              (EEVDF virtual deadlines per class) or hybrid\n"
+		"              (deadline shifted by a bounded φ term); only\n"
+		"              phi with -C\n"
+		"  -t          live per-task view (budget, STARVED time, φ),\n"
+		"              worst-off first, redrawn every second\n"
+		"  -T FILE     rewrite FILE every second with the same view\n"
+		"              for every task\n"
 		"\n"
 		"Pure VCG auction scheduler for heterogeneous CPUs (A1349 s4+).\n"
 		"No virtual time / no EEVDF — tasks ranked by φ_κ = v − c_κ · l\n"
@@ -195,7 +1075,7 @@ usage(const char *prog)
 		"dispatch time.  Tasks that cannot afford the payment fall back\n"
 		"to AUCTION_DSQ_STARVED until idle-time replenishment refills\n"
 		"their budget.\n",
-		basename((char *)prog));
+		basename((char *)prog), GANG_MAX, AUCTION_NCPU_MAX);
 }
 
 int
@@ -203,17 +1083,29 @@ main(int argc, char **argv)
 {
 	struct scx_A1349 *skel;
 	struct bpf_link   *link;
+	struct bpf_link   *futex_links[4] = {};
+	struct bpf_link   *exec_link;
+	struct bpf_link   *pmu_links[2] = {};
 	int                opt;
 	__u32              cost_p = 1024;
 	__u32              cost_e = 0;
 	bool               cost_e_user = false;
+	bool               tld_hints = false;
+	bool               futex_boost = false;
+	__u32              pack_pct = 0;
+	__u32              membw_rate = 0;
+	int                central = -1;
+	__u32              order = A1349_ORDER_PHI;
+	bool               dump_top = false;
+	const char        *dump_path = NULL;
+	struct bpf_link   *iter_link = NULL;
 	double             delta = 0.98;
 	unsigned int       refresh_tick = 0;
 
 	signal(SIGINT,  sigint_handler);
 	signal(SIGTERM, sigint_handler);
 
-	while ((opt = getopt(argc, argv, "p:e:d:h")) != -1) {
+	while ((opt = getopt(argc, argv, "p:e:d:lg:fc:r:m:C:o:tT:h")) != -1) {
 		switch (opt) {
 		case 'p':
 			cost_p = (__u32)atoi(optarg);
@@ -225,6 +1117,69 @@ main(int argc, char **argv)
 		case 'd':
 			delta = atof(optarg);
 			break;
+		case 'l':
+			tld_hints = true;
+			break;
+		case 'g':
+			if (!parse_gang_opt(optarg)) {
+				fprintf(stderr,
+					"Error: bad or too many -g '%s' "
+					"(TGID[:MIN], max %u).\n",
+					optarg, GANG_MAX);
+				return 1;
+			}
+			break;
+		case 'f':
+			futex_boost = true;
+			break;
+		case 'r':
+			if (!load_rules(optarg))
+				return 1;
+			rules_path = optarg;
+			break;
+		case 'm':
+			membw_rate = (__u32)atoi(optarg);
+			if (!membw_rate) {
+				fprintf(stderr, "Error: -m needs RATE > 0.\n");
+				return 1;
+			}
+			break;
+		case 'C':
+			central = atoi(optarg);
+			if (central < 0 || central >= (int)AUCTION_NCPU_MAX ||
+			    central >= libbpf_num_possible_cpus()) {
+				fprintf(stderr, "Error: bad -C CPU '%s'.\n",
+					optarg);
+				return 1;
+			}
+			break;
+		case 'o':
+			if (!strcmp(optarg, "phi")) {
+				order = A1349_ORDER_PHI;
+			} else if (!strcmp(optarg, "deadline")) {
+				order = A1349_ORDER_DEADLINE;
+			} else if (!strcmp(optarg, "hybrid")) {
+				order = A1349_ORDER_HYBRID;
+			} else {
+				fprintf(stderr, "Error: -o needs phi, deadline "
+					"or hybrid.\n");
+				return 1;
+			}
+			break;
+		case 't':
+			dump_top = true;
+			break;
+		case 'T':
+			dump_path = optarg;
+			break;
+		case 'c':
+			pack_pct = (__u32)atoi(optarg);
+			if (!pack_pct || pack_pct >= 100) {
+				fprintf(stderr,
+					"Error: -c needs 0 < PCT < 100.\n");
+				return 1;
+			}
+			break;
 		default:
 			usage(argv[0]);
 			return opt != 'h';
@@ -241,6 +1196,16 @@ main(int argc, char **argv)
 			"(got %.6f).\n", delta);
 		return 1;
 	}
+	/*
+	 * Central rounds clear the top bids in queue order at the (units+1)-th
+	 * bid's price, which only approximates VCG when the queue is in φ order.
+	 */
+	if (central >= 0 && order != A1349_ORDER_PHI) {
+		fprintf(stderr,
+			"Error: -C needs -o phi (the central round prices "
+			"in queue order).\n");
+		return 1;
+	}
 	if (cost_e_user && (cost_e == 0 || cost_e >= cost_p)) {
 		fprintf(stderr,
 			"Error: need cost_p > cost_e > 0 "
@@ -257,6 +1222,34 @@ main(int argc, char **argv)
 	skel->struct_ops.auction_ops->hotplug_seq = scx_hotplug_seq();
 	SCX_ENUM_INIT(skel);
 
+	skel->rodata->tld_hints_enabled = tld_hints;
+	skel->rodata->nr_gangs          = nr_gang_opts;
+	skel->rodata->futex_boost_enabled = futex_boost;
+	skel->rodata->pack_enabled      = pack_pct != 0;
+	skel->rodata->rules_enabled     = nr_rules != 0;
+	skel->rodata->membw_thresh      = membw_rate;
+	skel->rodata->central_cpu       = central;
+	skel->rodata->homogeneous       = topology_homogeneous();
+	skel->rodata->order_mode        = order;
+	skel->rodata->delta_log2        = llround(ldexp(log2(delta), SCX_FIX_SHIFT));
+
+	/* LLC-miss accounting (lib/pmu.bpf.c) only runs for -m. */
+	if (membw_rate)
+		skel->bss->scx_event_idx[0] = A1349_PMU_LLC_MISS;
+	bpf_program__set_autoload(skel->progs.scx_pmu_switch_tc, membw_rate);
+	bpf_program__set_autoload(skel->progs.scx_pmu_tick_tc, membw_rate);
+
+	bpf_program__set_autoload(skel->progs.a1349_dump,
+				  dump_top || dump_path);
+
+	/* Don't require syscall tracepoints unless futex boosting is on. */
+	bpf_program__set_autoload(skel->progs.a1349_futex_enter, futex_boost);
+	bpf_program__set_autoload(skel->progs.a1349_futex_exit, futex_boost);
+	bpf_program__set_autoload(skel->progs.a1349_futex_waitv_enter,
+				  futex_boost);
+	bpf_program__set_autoload(skel->progs.a1349_futex_waitv_exit,
+				  futex_boost);
+
 	if (scx_A1349__load(skel)) {
 		fprintf(stderr, "Failed to load BPF skeleton\n");
 		scx_A1349__destroy(skel);
@@ -264,34 +1257,101 @@ main(int argc, char **argv)
 	}
 
 	/*
-	 * Order matters: delta_table and capacity data must be in place
+	 * Order matters: capacity data must be in place
 	 * before attach so that auction_init() observes consistent config
 	 * the moment the struct_ops becomes active.
 	 */
-	populate_delta_table(skel, delta);
 	refresh_cpu_capacities(skel, cost_p, cost_e, cost_e_user, true);
+	refresh_gangs(skel);
+	refresh_rules(skel);
+
+	printf("scx_A1349: delta=%.4f (δ^1=%.6f, δ^100=%.6f)\n", delta,
+	       delta_pow_fix(skel->rodata->delta_log2, 1),
+	       delta_pow_fix(skel->rodata->delta_log2, 100));
+
+	if (futex_boost) {
+		futex_links[0] = bpf_program__attach(skel->progs.a1349_futex_enter);
+		futex_links[1] = bpf_program__attach(skel->progs.a1349_futex_exit);
+		futex_links[2] = bpf_program__attach(skel->progs.a1349_futex_waitv_enter);
+		futex_links[3] = bpf_program__attach(skel->progs.a1349_futex_waitv_exit);
+		if (!futex_links[0] || !futex_links[1] ||
+		    !futex_links[2] || !futex_links[3]) {
+			fprintf(stderr, "Failed to attach futex tracepoints\n");
+			for (int i = 0; i < 4; i++)
+				bpf_link__destroy(futex_links[i]);
+			scx_A1349__destroy(skel);
+			return 1;
+		}
+	}
 
-	printf("scx_A1349: delta=%.4f (table[1]=%.6f, table[%u]=%.6f)\n",
-	       delta, pow(delta, 1.0), MAX_CONTRACT_LENGTH - 1,
-	       pow(delta, (double)(MAX_CONTRACT_LENGTH - 1)));
+	if (membw_rate) {
+		int n = open_llc_miss_counters(skel);
+
+		pmu_links[0] = bpf_program__attach(skel->progs.scx_pmu_switch_tc);
+		pmu_links[1] = bpf_program__attach(skel->progs.scx_pmu_tick_tc);
+		if (!n || !pmu_links[0] || !pmu_links[1])
+			fprintf(stderr, "scx_A1349: LLC-miss counters unavailable "
+				"(%d CPUs), -m inert\n", n);
+		else
+			printf("scx_A1349: membw rate=%u misses/ms, %d CPUs "
+			       "counting\n", membw_rate, n);
+	}
+
+	if (dump_top || dump_path) {
+		iter_link = bpf_program__attach_iter(skel->progs.a1349_dump,
+						     NULL);
+		if (!iter_link)
+			fprintf(stderr, "scx_A1349: task iterator unavailable, "
+				"-t / -T off\n");
+	}
+
+	/* Exec balancing only; the scheduler runs fine without it. */
+	exec_link = bpf_program__attach(skel->progs.a1349_exec);
+	if (!exec_link)
+		fprintf(stderr, "scx_A1349: exec hook unavailable, "
+			"exec balancing off\n");
 
 	link = bpf_map__attach_struct_ops(skel->maps.auction_ops);
 	if (!link) {
 		fprintf(stderr, "Failed to attach struct ops\n");
+		bpf_link__destroy(iter_link);
+		bpf_link__destroy(exec_link);
+		bpf_link__destroy(pmu_links[0]);
+		bpf_link__destroy(pmu_links[1]);
+		for (int i = 0; i < 4; i++)
+			bpf_link__destroy(futex_links[i]);
 		scx_A1349__destroy(skel);
 		return 1;
 	}
 
 	printf("scx_A1349 auction scheduler attached.  Ctrl+C exits.\n");
+	if (central >= 0)
+		printf("scx_A1349: central dispatcher on CPU %d\n", central);
 
 	while (!exit_req) {
 		sleep(1);
-		if ((refresh_tick++ % 5) == 0)
+		if (pack_pct)
+			refresh_pack(skel, pack_pct);
+		if ((refresh_tick++ % 5) == 0) {
 			refresh_cpu_capacities(skel, cost_p, cost_e,
 					       cost_e_user, false);
+			refresh_gangs(skel);
+			refresh_rules(skel);
+		}
+		if (iter_link)
+			dump_tasks(iter_link, dump_top, dump_path);
 	}
 
+	print_gang_stats(skel);
+	print_stats(skel);
+
 	bpf_link__destroy(link);
+	bpf_link__destroy(iter_link);
+	bpf_link__destroy(exec_link);
+	bpf_link__destroy(pmu_links[0]);
+	bpf_link__destroy(pmu_links[1]);
+	for (int i = 0; i < 4; i++)
+		bpf_link__destroy(futex_links[i]);
 	scx_A1349__destroy(skel);
 	return 0;
 }
@@ -0,0 +1,226 @@
+/* SPDX-License-Identifier: GPL-2.0
+ *
+ * scx_A1349 — interface shared by the BPF scheduler, its userspace agent and
+ * applications that talk to the scheduler directly.
+ *
+ * Kept free of libbpf / vmlinux dependencies beyond the __uN types so that
+ * an RPC framework can include it next to the kernel's task_local_data.h
+ * without pulling in the scheduler build.
+ */
+#ifndef __SCX_A1349_H
+#define __SCX_A1349_H
+
+/*
+ * Application hints delivered through task local data (TLD).
+ *
+ * A thread publishes its hint word once and then flips bits with plain
+ * stores — no syscall, the BPF side reads the shared page directly:
+ *
+ *   TLD_DEFINE_KEY(a1349_hint, A1349_HINT_TLD_NAME, sizeof(__u32));
+ *   ...
+ *   __u32 *hint = tld_get_data(tld_map_fd, a1349_hint);
+ *   *hint |= A1349_HINT_LAT_CRIT;
+ *
+ * Hints only shape the auction (value term, cluster preference, a bounded
+ * slice extension); budgets still bound what any single task can take.
+ */
+#define A1349_HINT_TLD_NAME     "scx_a1349.hint"
+
+enum a1349_hint_flags {
+	/* Latency-critical: raise v_i, route to class 0, exempt from spill. */
+	A1349_HINT_LAT_CRIT     = 1u << 0,
+	/* Inside a critical section: extend the current slice once, briefly. */
+	A1349_HINT_NO_PREEMPT   = 1u << 1,
+	/* Throughput-only: lower v_i, route to the last class, batch slice. */
+	A1349_HINT_BATCH        = 1u << 2,
+};
+
+/*
+ * Key of the LLC-miss counter in lib/pmu.bpf.c (scx_event_idx[]); the agent
+ * opens PERF_COUNT_HW_CACHE_MISSES per CPU under it for -m.
+ */
+#define A1349_PMU_LLC_MISS      3ull    /* PERF_COUNT_HW_CACHE_MISSES */
+
+/*
+ * Capacity classes.  The agent clusters cpu_capacity into at most
+ * NR_CLASSES_MAX classes, strongest first: class 0 is what the model calls
+ * the P cluster, class nr_classes − 1 the most efficient one (E, or the
+ * low-power island on three-tier parts).  A power of two so BPF can bound a
+ * class index with a mask.
+ */
+#define NR_CLASSES_MAX          4u
+
+/*
+ * LLC domains, compacted by the agent to indices below LLC_MAX (ids that
+ * do not fit share a slot).  A power of two for the same reason.
+ */
+#define LLC_MAX                 16u
+
+/*
+ * CPUs the BPF side tracks in u64 masks and per-CPU arrays; the agent
+ * clamps its CPU loops and the -C CPU to the same bound.
+ */
+#define AUCTION_NCPU_MAX        64u
+
+/*
+ * Userspace-owned auction configuration (global_data, RO from BPF).
+ *
+ *   nr_classes         K ∈ [1, NR_CLASSES_MAX]; 1 on homogeneous machines
+ *   prefcore           1 when class 0 mixes capacities (favoured cores):
+ *                      rank idle class-0 CPUs by cpu_capacity and pull
+ *                      work up onto a faster core as it frees
+ *   pack_nr            consolidation: CPUs in the pack set (cpu_pack map);
+ *                      0 ⇒ spread as usual
+ *   nr_llcs            distinct last-level caches (cpu_llc map), ≤ LLC_MAX
+ *   class_capacity[k]  η_k, largest cpu_capacity in class k (η_0 = max)
+ *   class_cost[k]      c_k, per-quantum cost on class k
+ *   class_cpus[k]      n_k, CPUs in class k
+ */
+struct auction_ctx {
+	__u32 nr_classes;
+	__u32 prefcore;
+	__u32 pack_nr;
+	__u32 nr_llcs;
+	__u32 class_capacity[NR_CLASSES_MAX];
+	__u32 class_cost[NR_CLASSES_MAX];
+	__u32 class_cpus[NR_CLASSES_MAX];
+};
+
+/*
+ * Order within a class DSQ (agent -o, rodata order_mode).  The class a task
+ * queues on is the auction's either way; only who is served first inside
+ * the class changes.  The deadline orders price a winner against the best
+ * φ among the next losers, capped at its own bid, and exclude central
+ * mode, whose multi-unit clearing needs the queue in φ order.
+ *
+ *   PHI        encode_phi(φ); equal-φ tasks fall back to FIFO
+ *   DEADLINE   EEVDF virtual deadline against a per-class V(t)
+ *   HYBRID     the deadline, shifted earlier or later by a bounded φ term
+ */
+enum a1349_order {
+	A1349_ORDER_PHI         = 0,
+	A1349_ORDER_DEADLINE    = 1,
+	A1349_ORDER_HYBRID      = 2,
+};
+
+/*
+ * Operator placement rules (agent -r FILE).  Keyed by cgroup id
+ * (rule_cgroup), comm prefix (rule_comm, LPM trie) or uid (rule_uid); the
+ * first of the three that matches a task wins, most specific first.  A rule
+ * is soft: it sets defaults for the auction, spill and steal still apply.
+ *
+ *   cls        preferred capacity class on wake-up, A1349_RULE_CLASS_* or
+ *              an index (clamped to K − 1); app LAT_CRIT / BATCH hints win
+ *   value_pct  v_i multiplier in percent; 0 ⇒ 100
+ *   slice      A1349_RULE_SLICE_*
+ */
+#define A1349_RULE_MAX          256u
+#define A1349_RULE_COMM_LEN     16u     /* TASK_COMM_LEN */
+
+enum a1349_rule_class {
+	A1349_RULE_CLASS_LAST   = 0xfe, /* weakest class, whatever K is  */
+	A1349_RULE_CLASS_NONE   = 0xff,
+};
+
+enum a1349_rule_slice {
+	A1349_RULE_SLICE_DEFAULT = 0,   /* the class's own slice         */
+	A1349_RULE_SLICE_SHORT   = 1,   /* AUCTION_SLICE_P                */
+	A1349_RULE_SLICE_LONG    = 2,   /* AUCTION_SLICE_E                */
+	A1349_RULE_SLICE_BATCH   = 3,   /* AUCTION_SLICE_BATCH            */
+};
+
+struct a1349_rule {
+	__u8  cls;
+	__u8  slice;
+	__u16 value_pct;
+};
+
+/* rule_comm key; prefixlen in bits, 8 × strlen(prefix). */
+struct a1349_comm_key {
+	__u32 prefixlen;
+	char  comm[A1349_RULE_COMM_LEN];
+};
+
+/*
+ * Gang co-scheduling (opt-in per tgid).  Userspace owns gang_map
+ * (tgid → struct gang_cfg); BPF owns gang_runtime[slot].
+ *
+ *   slot          index into the per-gang DSQs and gang_runtime
+ *   min_members   queued members required before a launch; 0 ⇒ launch
+ *                 whatever is queued once GANG_WAIT_NS has elapsed
+ */
+#define GANG_MAX                16u
+
+struct gang_cfg {
+	__u32 slot;
+	__u32 min_members;
+};
+
+/*
+ * Per-gang launch statistics.
+ *   wait_since_ns     first enqueue into an empty gang DSQ (0 ⇒ empty)
+ *   launches          co-scheduled launches (≥ 1 member)
+ *   members_launched  Σ members placed across launches
+ *   paid              Σ aggregate VCG payments charged to the gang
+ */
+struct gang_runtime {
+	__u64 wait_since_ns;
+	__u64 launches;
+	__u64 members_launched;
+	__u64 paid;
+};
+
+/*
+ * Per-task record of the a1349_dump task iterator (agent -t / -T).
+ *   budget, budget_max  token bucket level and cap
+ *   len_est_ns          run-length estimate the bid is priced on
+ *   phi_enq, m_enq      φ and contract length at the last enqueue
+ *   starved_ns          total time waited in STARVED, current stay included
+ *   cls                 capacity class of the last enqueue
+ *   sticky, starved     queued on the CPU's sticky DSQ / in STARVED now
+ */
+struct a1349_task_dump {
+	__u64 budget;
+	__u64 budget_max;
+	__u64 len_est_ns;
+	__s64 phi_enq;
+	__u64 starved_ns;
+	__u32 pid;
+	__u32 tgid;
+	__u32 m_enq;
+	__u32 weight;
+	__u8  cls;
+	__u8  sticky;
+	__u8  starved;
+	__u8  _pad;
+	char  comm[A1349_RULE_COMM_LEN];
+};
+
+/*
+ * Per-CPU event counters (stats map).  Userspace sums across CPUs; names
+ * for the agent's report live next to it in scx_A1349.c.
+ */
+enum a1349_stat_idx {
+	STAT_FUTEX_BOOST        = 0,    /* woken waiter boosted as next holder */
+	STAT_FUTEX_BOOST_PI     = 1,    /* PI-futex owner boosted              */
+	STAT_FUTEX_THROTTLED    = 2,    /* boost refused by the cooldown       */
+	STAT_PREFCORE_KICK      = 3,    /* faster core asked a slower to yield */
+	STAT_PREFCORE_PULL      = 4,    /* task migrated up to a faster core   */
+	STAT_SYNC_LOCAL         = 5,    /* sync wakee queued on waker's CPU    */
+	STAT_SYNC_SKIP          = 6,    /* sync wake-up placed normally        */
+	STAT_MIG_HOLD           = 7,    /* move of a cache-hot task suppressed */
+	STAT_PACK_BACKOFF       = 8,    /* packing suspended on queueing delay */
+	STAT_UCLAMP_FLOOR       = 9,    /* routing raised to the uclamp.min floor */
+	STAT_SPAWN_SPREAD       = 10,   /* fork-burst child placed on idlest LLC */
+	STAT_SPAWN_EXEC         = 11,   /* exec'd burst child moved to idler LLC */
+	STAT_HERD_SPREAD        = 12,   /* herd member placed off the snapshot   */
+	STAT_HERD_COALESCED     = 13,   /* herd enqueue kick dropped (none idle) */
+	STAT_MEMBW_SPREAD       = 14,   /* memory-bound task sent to quieter LLC */
+	STAT_MEMBW_HOLD         = 15,   /* steal skipped a stream, LLC crowded   */
+	STAT_SLICE_INF          = 16,   /* lone runner granted SCX_SLICE_INF     */
+	STAT_SLICE_INF_REVOKE   = 17,   /* infinite slice revoked by a competitor */
+	STAT_CENTRAL_ROUND      = 18,   /* central CPU cleared an auction round  */
+	STAT_NR,
+};
+
+#endif /* __SCX_A1349_H */
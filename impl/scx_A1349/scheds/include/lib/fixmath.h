@@ -0,0 +1,199 @@
+#pragma once
+
+#ifdef __BPF__
+#include <scx/common.bpf.h>
+#endif /* __BPF__ */
+
+/*
+ * Fixed-point exp2 / log2 / pow for BPF programs, which have no floating
+ * point. Values are Q32.32: u64 for non-negative quantities, s64 for
+ * exponents and logarithms. Every function is loop-bounded and free of
+ * 128-bit arithmetic, so the verifier takes them inline from any context,
+ * and they are shared with userspace so the agent and the unit tests run
+ * the same code.
+ *
+ * Error bounds, on top of the final rounding to Q32.32:
+ *
+ *   scx_fix_exp2()   2^-29 relative, 64-entry table times a degree-4 series
+ *   scx_fix_log2()   2^-29 absolute, bit-by-bit through repeated squaring
+ *   scx_fix_pow()    2^-29 · (1 + |exp|) relative, from the two above
+ *
+ * Out-of-range results saturate: exp2() of 32 and beyond returns
+ * SCX_FIX_MAX, below -32 returns 0.
+ */
+#define SCX_FIX_SHIFT		32
+#define SCX_FIX_ONE		(1ULL << SCX_FIX_SHIFT)
+#define SCX_FIX_MAX		(~0ULL)
+#define SCX_FIX(n)		((u64)(n) << SCX_FIX_SHIFT)
+
+/* ln 2 in Q0.32. */
+#define SCX_FIX_LN2		0xb17217f8ULL
+
+#define SCX_FIX_EXP2_BITS	6
+#define SCX_FIX_EXP2_SIZE	(1U << SCX_FIX_EXP2_BITS)
+
+/* 2^(i / 64) in Q32.32. */
+static const u64 scx_fix_exp2_table[SCX_FIX_EXP2_SIZE] = {
+	0x100000000ULL, 0x102c9a3e7ULL, 0x1059b0d31ULL, 0x108745187ULL,
+	0x10b5586d0ULL, 0x10e3ec32dULL, 0x111301d01ULL, 0x11429aaebULL,
+	0x1172b83c8ULL, 0x11a35beb7ULL, 0x11d487317ULL, 0x12063b886ULL,
+	0x12387a6e7ULL, 0x126b4565eULL, 0x129e9df52ULL, 0x12d285a6eULL,
+	0x1306fe0a3ULL, 0x133c08b26ULL, 0x1371a7374ULL, 0x13a7db34eULL,
+	0x13dea64c1ULL, 0x14160a21fULL, 0x144e08606ULL, 0x1486a2b5cULL,
+	0x14bfdad53ULL, 0x14f9b276aULL, 0x15342b56aULL, 0x156f4736bULL,
+	0x15ab07dd5ULL, 0x15e76f15bULL, 0x16247eb04ULL, 0x166238825ULL,
+	0x16a09e668ULL, 0x16dfb23c6ULL, 0x171f75e8fULL, 0x175feb564ULL,
+	0x17a11473fULL, 0x17e2f336dULL, 0x182589995ULL, 0x1868d99b4ULL,
+	0x18ace5423ULL, 0x18f1ae991ULL, 0x193737b0dULL, 0x197d829feULL,
+	0x19c49182aULL, 0x1a0c667b6ULL, 0x1a5503b24ULL, 0x1a9e6b558ULL,
+	0x1ae89f996ULL, 0x1b33a2b85ULL, 0x1b7f76f30ULL, 0x1bcc1e905ULL,
+	0x1c199bdd8ULL, 0x1c67f12e5ULL, 0x1cb720dcfULL, 0x1d072d4a0ULL,
+	0x1d5818dd0ULL, 0x1da9e603eULL, 0x1dfc97338ULL, 0x1e502ee79ULL,
+	0x1ea4afa2aULL, 0x1efa1bee6ULL, 0x1f50765b7ULL, 0x1fa7c181aULL,
+};
+
+/* (a · b) >> 32 from 32-bit halves; SCX_FIX_MAX if it does not fit. */
+static inline u64 scx_fix_mul(u64 a, u64 b)
+{
+	u64 ah = a >> 32, al = (u32)a;
+	u64 bh = b >> 32, bl = (u32)b;
+	u64 hh = ah * bh, res, t;
+
+	if (hh >> 32)
+		return SCX_FIX_MAX;
+
+	res = hh << 32;
+
+	t = ah * bl;
+	if (res + t < res)
+		return SCX_FIX_MAX;
+	res += t;
+
+	t = al * bh;
+	if (res + t < res)
+		return SCX_FIX_MAX;
+	res += t;
+
+	t = (al * bl) >> 32;
+	if (res + t < res)
+		return SCX_FIX_MAX;
+
+	return res + t;
+}
+
+/* Index of the highest set bit of @x, which must be non-zero. */
+static inline u32 scx_fix_ilog2(u64 x)
+{
+	u32 r = 0;
+
+	if (x >> 32) { r += 32; x >>= 32; }
+	if (x >> 16) { r += 16; x >>= 16; }
+	if (x >> 8) { r += 8; x >>= 8; }
+	if (x >> 4) { r += 4; x >>= 4; }
+	if (x >> 2) { r += 2; x >>= 2; }
+	if (x >> 1) { r += 1; }
+
+	return r;
+}
+
+/*
+ * 2^@x. The integer part of @x is a shift; the fraction f splits into its
+ * top six bits, looked up, and a remainder r < 1/64, for which
+ * 2^r = e^(r ln 2) is a Taylor series whose fifth term is below 2^-39.
+ */
+static inline u64 scx_fix_exp2(s64 x)
+{
+	u64 frac, rem, y, p, res;
+	s64 n;
+
+	if (x >= (s64)SCX_FIX(32))
+		return SCX_FIX_MAX;
+	if (x < -(s64)SCX_FIX(32))
+		return 0;
+
+	/* Floor, also for negative @x: the fraction is always >= 0. */
+	n = x >> SCX_FIX_SHIFT;
+	frac = (u64)x & (SCX_FIX_ONE - 1);
+	rem = frac & ((1ULL << (SCX_FIX_SHIFT - SCX_FIX_EXP2_BITS)) - 1);
+
+	/* r < 2^26, so every product below stays under 2^60. */
+	y = (rem * SCX_FIX_LN2) >> SCX_FIX_SHIFT;
+
+	/* Horner: 1 + y (1 + y/2 (1 + y/3 (1 + y/4))). */
+	p = SCX_FIX_ONE + y / 4;
+	p = SCX_FIX_ONE + ((y * p) >> SCX_FIX_SHIFT) / 3;
+	p = SCX_FIX_ONE + ((y * p) >> SCX_FIX_SHIFT) / 2;
+	p = SCX_FIX_ONE + ((y * p) >> SCX_FIX_SHIFT);
+
+	res = scx_fix_mul(scx_fix_exp2_table[(frac >> (SCX_FIX_SHIFT - SCX_FIX_EXP2_BITS)) &
+					    (SCX_FIX_EXP2_SIZE - 1)], p);
+
+	if (n >= 0) {
+		if (res > (SCX_FIX_MAX >> n))
+			return SCX_FIX_MAX;
+		return res << n;
+	}
+
+	/* Round to nearest on the way down. */
+	n = -n;
+	return (res + (1ULL << (n - 1))) >> n;
+}
+
+/*
+ * log2(@x) for @x > 0; log2(0) returns the smallest representable value.
+ * The integer part is the position of the top bit. The mantissa m in
+ * [1, 2) yields one fraction bit per squaring: m² >= 2 means the bit is
+ * set, and m is halved back into range.
+ */
+static inline s64 scx_fix_log2(u64 x)
+{
+	u64 m, frac = 0;
+	s32 ilog;
+	int i;
+
+	if (!x)
+		return (s64)(1ULL << 63);
+
+	ilog = scx_fix_ilog2(x);
+	if (ilog >= SCX_FIX_SHIFT)
+		m = x >> (ilog - SCX_FIX_SHIFT);
+	else
+		m = x << (SCX_FIX_SHIFT - ilog);
+
+	for (i = SCX_FIX_SHIFT - 1; i >= 0; i--) {
+		/* m < 2^33: the square fits in scx_fix_mul(). */
+		m = scx_fix_mul(m, m);
+		if (m >= 2 * SCX_FIX_ONE) {
+			m >>= 1;
+			frac |= 1ULL << i;
+		}
+	}
+
+	return (s64)SCX_FIX(ilog - SCX_FIX_SHIFT) + (s64)frac;
+}
+
+/* @exp · @l in Q32.32, clamped far enough out that exp2() saturates. */
+static inline s64 scx_fix_mul_exp(s64 exp, s64 l)
+{
+	u64 mag = scx_fix_mul(exp < 0 ? -(u64)exp : (u64)exp,
+			      l < 0 ? -(u64)l : (u64)l);
+
+	if (mag > SCX_FIX(64))
+		mag = SCX_FIX(64);
+
+	return (exp < 0) != (l < 0) ? -(s64)mag : (s64)mag;
+}
+
+/*
+ * @base^@exp for @base > 0 and any real @exp, as 2^(@exp · log2 @base).
+ * A caller raising one base to many powers, such as a discount factor,
+ * should keep log2 of the base and call scx_fix_exp2(scx_fix_mul_exp())
+ * directly: exp2() is a few dozen instructions, log2() a few hundred.
+ */
+static inline u64 scx_fix_pow(u64 base, s64 exp)
+{
+	if (!base)
+		return exp > 0 ? 0 : exp < 0 ? SCX_FIX_MAX : SCX_FIX_ONE;
+
+	return scx_fix_exp2(scx_fix_mul_exp(exp, scx_fix_log2(base)));
+}
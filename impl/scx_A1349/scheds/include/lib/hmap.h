@@ -0,0 +1,136 @@
+#pragma once
+
+#ifdef __BPF__
+#include <scx/common.bpf.h>
+#include <bpf_arena_common.bpf.h>
+#endif /* __BPF__ */
+
+#include <bpf_arena_spin_lock.h>
+
+/*
+ * Arena hash map keyed by u64 (tgid, cgroup id, a packed (waker, wakee)
+ * pair, ...) with small values stored inline in the slot.
+ *
+ * The key space is split across SCX_HMAP_STRIPES independent open-addressing
+ * tables, each with its own lock, so writers on different stripes never
+ * contend. A stripe grows by doubling once three quarters of its slots are
+ * used; the move into the new table is spread over the writes that follow
+ * (SCX_HMAP_MIGRATE old slots per write), so no single call pays for a full
+ * rehash.
+ */
+#define SCX_HMAP_STRIPE_SHIFT	4
+#define SCX_HMAP_STRIPES	(1 << SCX_HMAP_STRIPE_SHIFT)
+#define SCX_HMAP_VAL_WORDS	4
+#define SCX_HMAP_MIN_ORDER	3
+#define SCX_HMAP_ORDERS		10	/* stripe tables of 8 .. 4096 slots */
+#define SCX_HMAP_MIGRATE	8
+#define SCX_HMAP_READ_RETRIES	4
+
+/* scx_hmap_update() flags, as for bpf_map_update_elem(). */
+enum scx_hmap_flags {
+	SCX_HMAP_ANY		= 0,
+	SCX_HMAP_NOEXIST	= 1,
+	SCX_HMAP_EXIST		= 2,
+};
+
+enum scx_hmap_slot_state {
+	SCX_HMAP_EMPTY		= 0,
+	SCX_HMAP_FULL		= 1,
+	SCX_HMAP_TOMB		= 2,	/* deleted or moved; keeps probe chains intact */
+};
+
+/* Value stored inline in each slot; callers use as many words as they need. */
+struct scx_hmap_val {
+	u64 w[SCX_HMAP_VAL_WORDS];
+};
+
+struct scx_hmap_slot {
+	u64 key;
+	u64 state;
+	struct scx_hmap_val val;
+};
+
+typedef struct scx_hmap_slot __arena scx_hmap_slot_t;
+
+/**
+ * scx_hmap_stripe - One independently locked open-addressing table
+ * @lock: Serialises writers on this stripe
+ * @seq: Odd while a writer is inside; lets scx_hmap_lookup_nolock() detect
+ *       and retry a torn read
+ * @cur: Table new keys go to
+ * @old: Table being drained into @cur after a resize, NULL otherwise
+ * @cur_order, @old_order: log2 of the slot count of @cur / @old
+ * @cur_side: Which of the two buffers of @cur_order @cur is
+ * @used: FULL + TOMB slots in @cur, the load the resize check looks at
+ * @nr: Live keys across @cur and @old
+ * @migrate: Next @old slot to move
+ * @buf: Tables by order, two per order so a stripe full of tombstones can
+ *       be rehashed at the same size; allocated on first use, never freed
+ */
+struct scx_hmap_stripe {
+	arena_spinlock_t lock;
+	volatile u64 seq;
+	scx_hmap_slot_t *cur;
+	scx_hmap_slot_t *old;
+	u32 cur_order;
+	u32 old_order;
+	u32 cur_side;
+	u32 __pad;
+	u64 used;
+	u64 nr;
+	u64 migrate;
+	scx_hmap_slot_t *buf[SCX_HMAP_ORDERS][2];
+};
+
+typedef struct scx_hmap_stripe __arena scx_hmap_stripe_t;
+
+struct scx_hmap {
+	struct scx_hmap_stripe stripe[SCX_HMAP_STRIPES];
+};
+
+typedef struct scx_hmap __arena scx_hmap_t;
+
+#ifdef __BPF__
+u64 scx_hmap_create_internal(void);
+#define scx_hmap_create() ((scx_hmap_t *)scx_hmap_create_internal())
+
+int scx_hmap_destroy(scx_hmap_t *hmap);
+
+/**
+ * scx_hmap_update - Insert or overwrite @key
+ * @hmap: Hash map
+ * @key: Any u64, 0 included
+ * @val: Value to copy into the slot
+ * @flags: SCX_HMAP_ANY, SCX_HMAP_NOEXIST or SCX_HMAP_EXIST
+ *
+ * Returns: 0, -EEXIST / -ENOENT when @flags is not met, -ENOSPC once the
+ * stripe is at its largest order, or the lock/allocation error.
+ */
+int scx_hmap_update(scx_hmap_t *hmap, u64 key, struct scx_hmap_val *val, u64 flags);
+
+/**
+ * scx_hmap_lookup - Copy the value of @key into @val under the stripe lock
+ *
+ * Returns: 0, -ENOENT, or the lock error.
+ */
+int scx_hmap_lookup(scx_hmap_t *hmap, u64 key, struct scx_hmap_val *val);
+
+/**
+ * scx_hmap_lookup_nolock - Lock-free scx_hmap_lookup()
+ *
+ * Reads the stripe under its sequence count and retries a read that raced
+ * a writer, falling back to the lock after SCX_HMAP_READ_RETRIES attempts.
+ * For read-mostly state looked up from hot paths.
+ */
+int scx_hmap_lookup_nolock(scx_hmap_t *hmap, u64 key, struct scx_hmap_val *val);
+
+/**
+ * scx_hmap_delete - Remove @key
+ *
+ * Returns: 0, -ENOENT, or the lock error.
+ */
+int scx_hmap_delete(scx_hmap_t *hmap, u64 key);
+
+/* Live keys; a snapshot, stripes are summed without their locks. */
+u64 scx_hmap_nr(scx_hmap_t *hmap);
+#endif /* __BPF__ */
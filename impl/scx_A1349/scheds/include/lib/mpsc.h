@@ -0,0 +1,136 @@
+#pragma once
+
+#ifdef __BPF__
+#include <scx/common.bpf.h>
+#include <bpf_arena_common.bpf.h>
+#include <bpf_atomic.h>
+#endif /* __BPF__ */
+
+/* For userspace programs, __arena is a no-op. */
+#if !defined(__arena) && !defined(__BPF__)
+#define __arena
+#endif
+
+/*
+ * Bounded multi-producer / single-consumer arena ring of u64 (a task
+ * context pointer, a pid, an encoded message).
+ *
+ * Producers claim a run of slots with one compare-and-swap on the tail and
+ * publish each slot by storing its position into the slot's sequence word;
+ * they never wait on each other or on the consumer. A producer that loses
+ * the race SCX_MPSC_RETRIES times in a row gets -EAGAIN, one that finds the
+ * ring full gets -ENOSPC, and it is up to the caller to fall back (a DSQ
+ * insert, a kick) rather than spin.
+ *
+ * The consumer owns the head and must be a single context at a time, e.g.
+ * the CPU the ring belongs to from ops.dispatch(). It stops at the first
+ * slot claimed but not yet published, so entries come out in claim order.
+ *
+ * The ring lives in the arena, so the agent can produce into it directly
+ * through the mapping with scx_mpsc_push_user().
+ */
+#define SCX_MPSC_BATCH		16
+#define SCX_MPSC_RETRIES	8
+#define SCX_MPSC_MAX_CAPACITY	(1ULL << 16)
+
+struct scx_mpsc_slot {
+	volatile u64 seq;	/* position + 1 once published */
+	u64 val;
+};
+
+typedef struct scx_mpsc_slot __arena scx_mpsc_slot_t;
+
+struct scx_mpsc {
+	volatile u64 tail;	/* next position to claim, producers */
+	u64 __pad0[7];
+	volatile u64 head;	/* next position to read, consumer */
+	u64 __pad1[7];
+	u64 capacity;		/* power of two */
+	scx_mpsc_slot_t *slots;
+};
+
+typedef struct scx_mpsc __arena scx_mpsc_t;
+
+/* A run of values for the batch calls; @nr in [0, SCX_MPSC_BATCH]. */
+struct scx_mpsc_batch {
+	u64 nr;
+	u64 val[SCX_MPSC_BATCH];
+};
+
+#ifdef __BPF__
+u64 scx_mpsc_create_internal(u64 capacity);
+#define scx_mpsc_create(capacity) ((scx_mpsc_t *)scx_mpsc_create_internal((capacity)))
+
+int scx_mpsc_destroy(scx_mpsc_t *mpsc);
+
+/**
+ * scx_mpsc_push - Append @val
+ *
+ * Returns: 0, -ENOSPC when full, -EAGAIN when the claim kept losing races.
+ */
+int scx_mpsc_push(scx_mpsc_t *mpsc, u64 val);
+
+/**
+ * scx_mpsc_push_batch - Append all of @batch contiguously, or nothing
+ *
+ * Returns: as scx_mpsc_push(), -EINVAL for an out of range @batch->nr.
+ */
+int scx_mpsc_push_batch(scx_mpsc_t *mpsc, struct scx_mpsc_batch *batch);
+
+/**
+ * scx_mpsc_pop - Take the oldest published value (consumer only)
+ *
+ * Returns: 0 or -ENOENT.
+ */
+int scx_mpsc_pop(scx_mpsc_t *mpsc, u64 *val);
+
+/**
+ * scx_mpsc_drain - Take up to SCX_MPSC_BATCH values into @batch (consumer only)
+ *
+ * Returns: the number of values taken, 0 when empty.
+ */
+int scx_mpsc_drain(scx_mpsc_t *mpsc, struct scx_mpsc_batch *batch);
+
+/* Published and in-flight entries; a snapshot. */
+u64 scx_mpsc_nr_queued(scx_mpsc_t *mpsc);
+
+#else /* __BPF__ */
+
+/*
+ * Producer side for the agent, on the arena mapping; same protocol as
+ * scx_mpsc_push_batch() with C11 atomics.
+ */
+static inline int scx_mpsc_push_user(scx_mpsc_t *mpsc, const u64 *vals, u64 nr)
+{
+	u64 head, tail, i;
+	int try;
+
+	if (!nr || nr > mpsc->capacity)
+		return -EINVAL;
+
+	for (try = 0; try < SCX_MPSC_RETRIES; try++) {
+		/* Head before tail on every try, as in mpsc_claim(). */
+		head = __atomic_load_n(&mpsc->head, __ATOMIC_ACQUIRE);
+		tail = __atomic_load_n(&mpsc->tail, __ATOMIC_RELAXED);
+		if (tail - head + nr > mpsc->capacity)
+			return -ENOSPC;
+
+		if (__atomic_compare_exchange_n(&mpsc->tail, &tail, tail + nr, false,
+						__ATOMIC_ACQ_REL, __ATOMIC_RELAXED))
+			break;
+	}
+
+	if (try == SCX_MPSC_RETRIES)
+		return -EAGAIN;
+
+	for (i = 0; i < nr; i++) {
+		scx_mpsc_slot_t *slot = &mpsc->slots[(tail + i) & (mpsc->capacity - 1)];
+
+		slot->val = vals[i];
+		__atomic_store_n(&slot->seq, tail + i + 1, __ATOMIC_RELEASE);
+	}
+
+	return 0;
+}
+
+#endif /* __BPF__ */
@@ -0,0 +1,261 @@
+#pragma once
+
+#ifdef __BPF__
+#include <scx/common.bpf.h>
+#include <bpf_arena_common.bpf.h>
+#endif /* __BPF__ */
+
+/* For userspace programs, __arena is a no-op. */
+#if !defined(__arena) && !defined(__BPF__)
+#define __arena
+#endif
+
+/*
+ * Bounded-memory streaming sketches for per-key telemetry (wake-up graph
+ * edges, per-comm counters, top latency offenders) when the key space is
+ * too large for a map:
+ *
+ *   scx_cms     count-min with conservative update: per-key counts, never
+ *               under-estimated, over by at most ~e/width of all increments
+ *   scx_topk    space-saving heavy hitters: the k keys with the largest
+ *               counts and a bound on each count's error
+ *   scx_hll     HyperLogLog: number of distinct keys, ~3% standard error
+ *
+ * Each sketch holds one instance per CPU; creation fails for nr_inst below
+ * nr_cpu_ids. An update writes only the instance of the CPU it runs on, so
+ * updates take no locks and no atomics. The one race left is a program nesting over
+ * another on the same CPU, such as a tracepoint firing inside an ops
+ * callback: one of the two updates may be lost. A lost count-min or top-K
+ * increment leaves that key under-counted by the increment, so the
+ * "never under-estimated" and upper-bound guarantees hold only for
+ * updates that do not nest; a lost HyperLogLog update can only miss a key.
+ * The instances merge without loss of guarantees: scx_cms_estimate() and
+ * scx_topk_count() merge on the fly from BPF, and the *_user() helpers
+ * below merge from the agent through the arena mapping.
+ */
+#define SCX_CMS_DEPTH		4
+#define SCX_CMS_MAX_WIDTH	(1U << 16)
+#define SCX_TOPK_MAX		64
+#define SCX_HLL_PRECISION	10
+#define SCX_HLL_REGS		(1U << SCX_HLL_PRECISION)
+
+struct scx_cms {
+	u32 width;		/* power of two */
+	u32 nr_inst;
+	u64 __arena *cnt;	/* [nr_inst][SCX_CMS_DEPTH][width] */
+};
+
+typedef struct scx_cms __arena scx_cms_t;
+
+/* A free entry has count 0. */
+struct scx_topk_entry {
+	u64 key;
+	u64 count;		/* upper bound on the key's count */
+	u64 err;		/* count - err is a lower bound */
+};
+
+struct scx_topk {
+	u32 k;
+	u32 nr_inst;
+	struct scx_topk_entry __arena *ent;	/* [nr_inst][k] */
+};
+
+typedef struct scx_topk __arena scx_topk_t;
+
+struct scx_hll {
+	u32 nr_inst;
+	u32 __pad;
+	u8 __arena *reg;	/* [nr_inst][SCX_HLL_REGS] */
+};
+
+typedef struct scx_hll __arena scx_hll_t;
+
+/* murmur3 fmix64; shared by both sides so the agent can query. */
+static inline u64 scx_sketch_hash(u64 key)
+{
+	key ^= key >> 33;
+	key *= 0xff51afd7ed558ccdULL;
+	key ^= key >> 33;
+	key *= 0xc4ceb9fe1a85ec53ULL;
+	key ^= key >> 33;
+
+	return key;
+}
+
+/* Counter of @key in @row, double hashing over one 64-bit hash. */
+static inline u64 scx_cms_col(u64 hash, u32 row, u32 width)
+{
+	u64 h2 = scx_sketch_hash(hash ^ 0x9e3779b97f4a7c15ULL) | 1;
+
+	return (hash + row * h2) & (width - 1);
+}
+
+/* Register index and rank (leading zeros + 1 of the rest) of @key. */
+static inline void scx_hll_pos(u64 key, u32 *idx, u8 *rank)
+{
+	u64 hash = scx_sketch_hash(key);
+	u64 w = hash << SCX_HLL_PRECISION;
+	u8 r = 1;
+
+	*idx = hash >> (64 - SCX_HLL_PRECISION);
+
+	if (!w) {
+		*rank = 64 - SCX_HLL_PRECISION + 1;
+		return;
+	}
+
+	if (!(w >> 32)) { r += 32; w <<= 32; }
+	if (!(w >> 48)) { r += 16; w <<= 16; }
+	if (!(w >> 56)) { r += 8; w <<= 8; }
+	if (!(w >> 60)) { r += 4; w <<= 4; }
+	if (!(w >> 62)) { r += 2; w <<= 2; }
+	if (!(w >> 63)) { r += 1; }
+
+	*rank = r;
+}
+
+#ifdef __BPF__
+u64 scx_cms_create_internal(u32 width, u32 nr_inst);
+#define scx_cms_create(width, nr_inst) ((scx_cms_t *)scx_cms_create_internal((width), (nr_inst)))
+
+/* Add @inc to @key on this CPU's instance. */
+int scx_cms_add(scx_cms_t *cms, u64 key, u64 inc);
+
+/* Count of @key across instances; never below the true count. */
+u64 scx_cms_estimate(scx_cms_t *cms, u64 key);
+
+u64 scx_topk_create_internal(u32 k, u32 nr_inst);
+#define scx_topk_create(k, nr_inst) ((scx_topk_t *)scx_topk_create_internal((k), (nr_inst)))
+
+/* Add @inc (> 0) to @key on this CPU's instance. */
+int scx_topk_add(scx_topk_t *topk, u64 key, u64 inc);
+
+/* Σ of @key's tracked counts across instances, 0 if tracked nowhere. */
+u64 scx_topk_count(scx_topk_t *topk, u64 key);
+
+u64 scx_hll_create_internal(u32 nr_inst);
+#define scx_hll_create(nr_inst) ((scx_hll_t *)scx_hll_create_internal((nr_inst)))
+
+int scx_hll_add(scx_hll_t *hll, u64 key);
+
+#else /* __BPF__ */
+
+#include <math.h>
+#include <stdlib.h>
+
+static inline u64 scx_cms_estimate_user(const scx_cms_t *cms, u64 key)
+{
+	u64 hash = scx_sketch_hash(key);
+	u64 est = ~0ULL, sum;
+	u32 row, inst;
+
+	for (row = 0; row < SCX_CMS_DEPTH; row++) {
+		u64 col = scx_cms_col(hash, row, cms->width);
+
+		sum = 0;
+		for (inst = 0; inst < cms->nr_inst; inst++)
+			sum += cms->cnt[((u64)inst * SCX_CMS_DEPTH + row) * cms->width + col];
+
+		if (sum < est)
+			est = sum;
+	}
+
+	return est;
+}
+
+static inline int scx_topk_entry_cmp(const void *a, const void *b)
+{
+	const struct scx_topk_entry *ea = a, *eb = b;
+
+	return ea->count < eb->count ? 1 : ea->count > eb->count ? -1 : 0;
+}
+
+/*
+ * Merge every instance into @out, which must hold k × nr_inst entries,
+ * largest count first. A key missing from a full instance is charged that
+ * instance's smallest count, the most it can have had there, so counts
+ * stay upper bounds. Returns the number of distinct keys in @out.
+ */
+static inline u32 scx_topk_merge_user(const scx_topk_t *topk, struct scx_topk_entry *out)
+{
+	const struct scx_topk_entry *ent;
+	u32 nr = 0, inst, i, j;
+	u64 min;
+	bool found;
+
+	for (inst = 0; inst < topk->nr_inst; inst++) {
+		ent = &topk->ent[(u64)inst * topk->k];
+		for (i = 0; i < topk->k; i++) {
+			if (!ent[i].count)
+				continue;
+
+			for (j = 0; j < nr && out[j].key != ent[i].key; j++)
+				;
+			if (j == nr)
+				out[nr++] = (struct scx_topk_entry) { .key = ent[i].key };
+			out[j].count += ent[i].count;
+			out[j].err += ent[i].err;
+		}
+	}
+
+	for (inst = 0; inst < topk->nr_inst; inst++) {
+		ent = &topk->ent[(u64)inst * topk->k];
+
+		min = ~0ULL;
+		for (i = 0; i < topk->k; i++) {
+			if (ent[i].count < min)
+				min = ent[i].count;
+		}
+
+		/* Room to spare: every key it saw is still tracked. */
+		if (!min)
+			continue;
+
+		for (j = 0; j < nr; j++) {
+			found = false;
+			for (i = 0; i < topk->k && !found; i++)
+				found = ent[i].key == out[j].key;
+
+			if (!found) {
+				out[j].count += min;
+				out[j].err += min;
+			}
+		}
+	}
+
+	qsort(out, nr, sizeof(*out), scx_topk_entry_cmp);
+
+	return nr;
+}
+
+/* Distinct keys seen across instances. */
+static inline double scx_hll_estimate_user(const scx_hll_t *hll)
+{
+	const double m = SCX_HLL_REGS;
+	const double alpha = 0.7213 / (1.0 + 1.079 / m);
+	u32 zeros = 0, inst, i;
+	double sum = 0.0, est;
+	u8 reg, r;
+
+	for (i = 0; i < SCX_HLL_REGS; i++) {
+		reg = 0;
+		for (inst = 0; inst < hll->nr_inst; inst++) {
+			r = hll->reg[(u64)inst * SCX_HLL_REGS + i];
+			if (r > reg)
+				reg = r;
+		}
+
+		sum += 1.0 / (double)(1ULL << reg);
+		zeros += !reg;
+	}
+
+	est = alpha * m * m / sum;
+
+	/* Small range: linear counting over the empty registers. */
+	if (est <= 2.5 * m && zeros)
+		est = m * log(m / zeros);
+
+	return est;
+}
+
+#endif /* __BPF__ */
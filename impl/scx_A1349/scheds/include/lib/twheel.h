@@ -0,0 +1,117 @@
+#pragma once
+
+#ifdef __BPF__
+#include <scx/common.bpf.h>
+#include <bpf_arena_common.bpf.h>
+#endif /* __BPF__ */
+
+#include <bpf_arena_spin_lock.h>
+
+/*
+ * Hierarchical timer wheel for many per-entity deadlines (STARVED aging,
+ * lag decay, boost expiry) behind a single clock source.
+ *
+ * Time is counted in ticks of tick_ns. Level l holds timers due between
+ * 64^l and 64^(l+1) ticks out, in 64 slots of 64^l ticks each; when level 0
+ * wraps, the next slot of level 1 is cascaded down, and so on up. Arming and
+ * cancelling are O(1) list operations; expiry costs one slot per elapsed
+ * tick plus one re-insert per cascaded timer.
+ *
+ * The wheel does not own a clock. Drive it from ops.tick() or from one
+ * bpf_timer per CPU, each owning a wheel:
+ *
+ *	timer = (scx_tw_timer_t *)scx_tw_advance(wheel, bpf_ktime_get_ns());
+ *	while (timer && can_loop) {
+ *		next = timer->link;
+ *		entity = container_of(timer, ...);
+ *		... may scx_tw_arm() timer again ...
+ *		timer = next;
+ *	}
+ *
+ * Any CPU may arm or cancel a timer while the driver walks the expired
+ * chain: the chain has its own link, which only scx_tw_advance() writes.
+ * A wheel must have a single driver, though; a second scx_tw_advance()
+ * could hand out a re-armed timer again and relink it under the first.
+ */
+#define SCX_TW_SLOT_SHIFT	6
+#define SCX_TW_SLOTS		(1 << SCX_TW_SLOT_SHIFT)
+#define SCX_TW_LEVELS		4
+/* Furthest a timer can be placed; later deadlines are re-filed as they near. */
+#define SCX_TW_MAX_TICKS	((1ULL << (SCX_TW_SLOT_SHIFT * SCX_TW_LEVELS)) - 1)
+
+enum scx_tw_state {
+	SCX_TW_IDLE		= 0,
+	SCX_TW_ARMED		= 1,
+};
+
+struct scx_tw_timer;
+typedef struct scx_tw_timer __arena scx_tw_timer_t;
+
+/*
+ * Embedded in the caller's arena entity. Zero-initialised is idle. @next
+ * and @prev link the timer into its slot while armed. After scx_tw_advance()
+ * hands a timer back, @link chains it to the next expired one until the
+ * wheel expires it again.
+ */
+struct scx_tw_timer {
+	scx_tw_timer_t *next;
+	scx_tw_timer_t *prev;
+	scx_tw_timer_t *link;
+	u64 expires;		/* in ticks */
+	u32 state;
+	u16 level;
+	u16 slot;
+};
+
+/**
+ * scx_twheel - Timer wheel
+ * @lock: Serialises all operations on the wheel
+ * @tick_ns: Tick length
+ * @now: Last tick processed by scx_tw_advance()
+ * @nr_armed: Timers on the wheel
+ * @occupied: Per-level bitmap of non-empty slots
+ * @slots: Per-slot doubly linked timer lists
+ */
+struct scx_twheel {
+	arena_spinlock_t lock;
+	u64 tick_ns;
+	u64 now;
+	u64 nr_armed;
+	u64 occupied[SCX_TW_LEVELS];
+	scx_tw_timer_t *slots[SCX_TW_LEVELS][SCX_TW_SLOTS];
+};
+
+typedef struct scx_twheel __arena scx_twheel_t;
+
+#ifdef __BPF__
+u64 scx_tw_create_internal(u64 tick_ns, u64 now_ns);
+#define scx_tw_create(tick_ns, now_ns) ((scx_twheel_t *)scx_tw_create_internal((tick_ns), (now_ns)))
+
+int scx_tw_destroy(scx_twheel_t *tw);
+
+/**
+ * scx_tw_arm - Arm @timer to expire at @expires_ns, re-arming it if pending
+ *
+ * The deadline is rounded up to a tick, so a timer never fires early and
+ * at most one tick late (plus however late the driver runs). Deadlines
+ * already past fire on the next tick.
+ *
+ * Returns: 0, or the lock error.
+ */
+int scx_tw_arm(scx_twheel_t *tw, scx_tw_timer_t *timer, u64 expires_ns);
+
+/**
+ * scx_tw_cancel - Take a pending @timer off the wheel
+ *
+ * Returns: 0, -ENOENT if it was not armed, or the lock error.
+ */
+int scx_tw_cancel(scx_twheel_t *tw, scx_tw_timer_t *timer);
+
+/**
+ * scx_tw_advance - Run the wheel up to @now_ns
+ *
+ * Returns: the timers that came due, oldest deadline first and chained
+ * through ->link, all idle again; 0 if none.
+ */
+u64 scx_tw_advance(scx_twheel_t *tw, u64 now_ns);
+#endif /* __BPF__ */